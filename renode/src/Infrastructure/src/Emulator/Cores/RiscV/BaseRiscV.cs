@@ -275,6 +275,16 @@ public CSRValidationLevel CSRValidation
             }
         }
 
+        public bool HostFpuEnabled
+        {
+            get => TlibGetHostFpuEnabled() != 0;
+
+            set
+            {
+                TlibSetHostFpuEnabled(value ? 1u : 0u);
+            }
+        }
+
         public uint HartId
         {
             get
@@ -732,6 +742,12 @@ private void HandlePostGprAccessHook(UInt32 registerIndex, UInt32 writeOrRead)
         [Import]
         private FuncUInt32 TlibGetCsrValidationLevel;
 
+        [Import]
+        private ActionUInt32 TlibSetHostFpuEnabled;
+
+        [Import]
+        private FuncUInt32 TlibGetHostFpuEnabled;
+
         [Import]
         private ActionInt32 TlibAllowUnalignedAccesses;
 
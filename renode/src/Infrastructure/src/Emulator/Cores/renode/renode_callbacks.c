@@ -45,6 +45,7 @@ EXTERNAL_AS(action_uint64_uint64, WriteDoubleWordToBus, tlib_write_double_word)
 EXTERNAL_AS(action_uint64_uint64, WriteQuadWordToBus, tlib_write_quad_word)
 
 EXTERNAL_AS(func_uint32_uint64_uint32, OnBlockBegin, tlib_on_block_begin)
+EXTERNAL_AS(action_intptr_uint32, OnBlockBeginBatch, tlib_on_block_begin_batch)
 
 EXTERNAL_AS(action_uint64_uint32, OnBlockFinished, tlib_on_block_finished)
 
@@ -72,9 +73,11 @@ EXTERNAL_AS(action_uint64_uint32_uint32, LogDisassembly, tlib_on_block_translati
 EXTERNAL_AS(action_uint64, OnInterruptBegin, tlib_on_interrupt_begin)
 EXTERNAL_AS(action_uint64, OnInterruptEnd, tlib_on_interrupt_end)
 EXTERNAL_AS(action_uint64_uint32_uint64, OnMemoryAccess, tlib_on_memory_access)
+EXTERNAL_AS(action, OnMemoryTraceReady, tlib_on_memory_trace_ready)
 EXTERNAL_AS(func_uint32, IsInDebugMode, tlib_is_in_debug_mode)
 EXTERNAL_AS(action_uint64_int32_int32, MmuFaultExternalHandler, tlib_mmu_fault_external_handler)
 EXTERNAL_AS(action_uint64_uint64_uint64_int32, OnStackChange, tlib_profiler_announce_stack_change)
 EXTERNAL_AS(action_uint64, OnContextChange, tlib_profiler_announce_context_change)
+EXTERNAL_AS(action_intptr_uint32, OnProfilerSamples, tlib_on_profiler_samples)
 EXTERNAL_AS(action_intptr_int32, OnMassBroadcastDirty, tlib_mass_broadcast_dirty)
 EXTERNAL_AS(func_intptr_intptr, GetDirty, tlib_get_dirty_addresses_list)
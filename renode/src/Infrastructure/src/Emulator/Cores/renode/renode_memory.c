@@ -70,7 +70,7 @@ static void move_to_head(list_node_t** head, list_node_t* node)
     *head = node;
 }
 
-void *tlib_guest_offset_to_host_ptr(uint64_t offset)
+static host_memory_block_t *find_host_block(uint64_t offset)
 {
   host_memory_block_lists_t *host_blocks_list_cached;
   list_node_t *current_block;
@@ -84,7 +84,7 @@ try_find_block:
       {
         if(offset >= current_block->element->start && offset <= (current_block->element->start + current_block->element->size - 1)) {
             move_to_head(&host_blocks_list_cached->guest_to_host_head, current_block);
-            return current_block->element->host_pointer + (offset - current_block->element->start);
+            return current_block->element;
         }
 
         current_block = current_block->next;
@@ -95,6 +95,20 @@ try_find_block:
   goto try_find_block;
 }
 
+void *tlib_guest_offset_to_host_ptr(uint64_t offset)
+{
+  host_memory_block_t *block = find_host_block(offset);
+  return block->host_pointer + (offset - block->start);
+}
+
+// Also returns the number of bytes from `offset` to the end of its host block
+void *tlib_guest_offset_to_host_span(uint64_t offset, uint64_t *size)
+{
+  host_memory_block_t *block = find_host_block(offset);
+  *size = block->start + block->size - offset;
+  return block->host_pointer + (offset - block->start);
+}
+
 uint64_t tlib_host_ptr_to_guest_offset(void *ptr)
 {
   host_memory_block_lists_t *host_blocks_list_cached;
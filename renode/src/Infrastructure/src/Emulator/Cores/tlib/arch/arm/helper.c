@@ -7,6 +7,7 @@
 #include "host-utils.h"
 #include "infrastructure.h"
 #include "arch_callbacks.h"
+#include "sampling_profiler.h"
 
 #define ARM_ARCHITECTURE_MASK (0xFF00FFF0)
 
@@ -659,6 +660,23 @@ static inline void arm_announce_stack_change()
     }
 }
 
+// Thumb code keeps the {r7, lr} frame record at r7, ARM code built by GCC points fp (r11) at the saved lr
+// with the previous fp right below it
+void cpu_get_frame_record_layout(CPUState *env, frame_record_layout_t *layout)
+{
+    if (env->thumb) {
+        layout->frame_pointer = env->regs[7];
+        layout->previous_frame_pointer_offset = 0;
+        layout->return_address_offset = 4;
+    } else {
+        layout->frame_pointer = env->regs[11];
+        layout->previous_frame_pointer_offset = -4;
+        layout->return_address_offset = 0;
+    }
+    layout->word_size = 4;
+    layout->return_address_mask = ~1u;
+}
+
 #ifdef TARGET_PROTO_ARM_M
 static int v7m_push(CPUState *env, uint32_t val)
 {
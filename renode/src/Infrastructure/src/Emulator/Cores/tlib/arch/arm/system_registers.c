@@ -114,7 +114,10 @@ void system_instructions_and_registers_reset(CPUState *env)
 void system_instructions_and_registers_init(CPUState *env)
 {
     uint32_t ttable_size = ARM_CP_ARRAY_COUNT(general_coprocessor_registers);
-    env->cp_regs = ttable_create(ttable_size, entry_remove_callback, ttable_compare_key_uint32);
+    env->cp_regs = ttable_create_hashed(ttable_size, entry_remove_callback, TTABLE_KEY_UINT32);
 
     cp_regs_add(env, general_coprocessor_registers, ARM_CP_ARRAY_COUNT(general_coprocessor_registers));
+
+    // The translator looks registers up for every coprocessor access, no more are added after init.
+    ttable_freeze(env->cp_regs);
 }
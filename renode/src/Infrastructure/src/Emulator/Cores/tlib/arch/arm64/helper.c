@@ -9,6 +9,7 @@
 #include "cpu.h"
 #include "helper.h"
 #include "mmu.h"
+#include "sampling_profiler.h"
 #include "syndrome.h"
 #include "system_registers.h"
 
@@ -707,6 +708,30 @@ void do_interrupt_a64(CPUState *env)
     }
 }
 
+// AArch64 frame records are {previous x29, x30} at x29, AArch32 code is unwound like on the arm target
+void cpu_get_frame_record_layout(CPUState *env, frame_record_layout_t *layout)
+{
+    if (is_a64(env)) {
+        layout->frame_pointer = env->xregs[29];
+        layout->previous_frame_pointer_offset = 0;
+        layout->return_address_offset = 8;
+        layout->word_size = 8;
+        layout->return_address_mask = UINT64_MAX;
+        return;
+    }
+    if (env->thumb) {
+        layout->frame_pointer = env->regs[7];
+        layout->previous_frame_pointer_offset = 0;
+        layout->return_address_offset = 4;
+    } else {
+        layout->frame_pointer = env->regs[11];
+        layout->previous_frame_pointer_offset = -4;
+        layout->return_address_offset = 0;
+    }
+    layout->word_size = 4;
+    layout->return_address_mask = ~1u;
+}
+
 bool check_scr_el3_mask(uint64_t scr_el3, int ns, int aw, int fw, int ea, int irq, int fiq)
 {
     bool result = 1;
@@ -2115,7 +2115,7 @@ void system_instructions_and_registers_init(CPUState *env, uint32_t cpu_model_id
     if (arm_feature(env, ARM_FEATURE_PMSA)) {
         ttable_size += ARM_CP_ARRAY_COUNT(mpu_registers);
     }
-    env->arm_core_config->cp_regs = ttable_create(ttable_size, entry_remove_callback, ttable_compare_key_uint32);
+    env->arm_core_config->cp_regs = ttable_create_hashed(ttable_size, entry_remove_callback, TTABLE_KEY_UINT32);
 
     cp_regs_add(env, instructions, instructions_count);
     cp_regs_add(env, registers, registers_count);
@@ -2124,6 +2124,9 @@ void system_instructions_and_registers_init(CPUState *env, uint32_t cpu_model_id
     if (arm_feature(env, ARM_FEATURE_PMSA)) {
         cp_regs_add(env, mpu_registers, ARM_CP_ARRAY_COUNT(mpu_registers));
     }
+
+    // The translator looks registers up for every MRS/MSR and system instruction, no more are added after init.
+    ttable_freeze(env->arm_core_config->cp_regs);
 }
 
 void system_instructions_and_registers_reset(CPUState *env)
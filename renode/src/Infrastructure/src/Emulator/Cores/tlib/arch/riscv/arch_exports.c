@@ -201,6 +201,20 @@ uint32_t tlib_get_csr_validation_level()
 
 EXC_INT_0(uint32_t, tlib_get_csr_validation_level)
 
+void tlib_set_host_fpu_enabled(uint32_t value)
+{
+    cpu->use_host_fpu = !!value;
+}
+
+EXC_VOID_1(tlib_set_host_fpu_enabled, uint32_t, value)
+
+uint32_t tlib_get_host_fpu_enabled()
+{
+    return cpu->use_host_fpu;
+}
+
+EXC_INT_0(uint32_t, tlib_get_host_fpu_enabled)
+
 void tlib_set_nmi_vector(uint64_t nmi_adress, uint32_t nmi_length)
 {
     if (nmi_adress > (TARGET_ULONG_MAX - nmi_length)) {
@@ -300,6 +314,8 @@ uint32_t tlib_set_vlen(uint32_t vlen)
         return 1;
     }
     cpu->vlenb = vlen / 8;
+    // Translated vector code depends on the register size
+    tb_flush(cpu);
     return 0;
 }
 
@@ -7,6 +7,7 @@
 #include "host-utils.h"
 
 #define SUPPORTS_GUEST_PROFILING
+#define SUPPORTS_SUPERBLOCKS
 
 #define TARGET_PAGE_BITS            12/* 4 KiB Pages */
 #if TARGET_LONG_BITS == 64
@@ -65,6 +66,10 @@ typedef struct DisasContext {
     struct DisasContextBase base;
     uint64_t opcode;
     target_ulong npc;
+    /* vector configuration known at translation time, see RISCV_TBFLAG_VSTATIC */
+    bool vstatic;
+    uint32_t vsew;
+    uint32_t vlmul;
 } DisasContext;
 
 typedef struct instruction_extensions_t {
@@ -221,6 +226,10 @@ struct CPUState {
      */
     int32_t interrupt_mode;
 
+    /* use the host FPU for F/D arithmetic when the result is known to match softfloat;
+       can be disabled for bit-exact validation runs against the softfloat implementation */
+    bool use_host_fpu;
+
     CPU_COMMON
 
     int8_t are_post_opcode_execution_hooks_enabled;
@@ -248,11 +257,39 @@ int riscv_cpu_hw_interrupts_pending(CPUState *env);
 #include "cpu-all.h"
 #include "exec-all.h"
 
+#define GET_VTYPE_VLMUL(inst)    extract32(inst, 0, 3)
+#define GET_VTYPE_VSEW(inst)     extract32(inst, 3, 3)
+#define GET_VTYPE_VTA(inst)      extract32(inst, 6, 1)
+#define GET_VTYPE_VMA(inst)      extract32(inst, 7, 1)
+
+/* Bit usage in the TB flags field: */
+#define RISCV_TBFLAG_VSTATIC_SHIFT 0
+#define RISCV_TBFLAG_VSTATIC_MASK  (1 << RISCV_TBFLAG_VSTATIC_SHIFT)
+#define RISCV_TBFLAG_VSEW_SHIFT    1
+#define RISCV_TBFLAG_VSEW_MASK     (0x3 << RISCV_TBFLAG_VSEW_SHIFT)
+#define RISCV_TBFLAG_VLMUL_SHIFT   3
+#define RISCV_TBFLAG_VLMUL_MASK    (0x7 << RISCV_TBFLAG_VLMUL_SHIFT)
+/* Bits 31..6 are currently unused. */
+
+/* some convenience accessor macros */
+#define RISCV_TBFLAG_VSTATIC(F) \
+    (((F) & RISCV_TBFLAG_VSTATIC_MASK) >> RISCV_TBFLAG_VSTATIC_SHIFT)
+#define RISCV_TBFLAG_VSEW(F) \
+    (((F) & RISCV_TBFLAG_VSEW_MASK) >> RISCV_TBFLAG_VSEW_SHIFT)
+#define RISCV_TBFLAG_VLMUL(F) \
+    (((F) & RISCV_TBFLAG_VLMUL_MASK) >> RISCV_TBFLAG_VLMUL_SHIFT)
+
 static inline void cpu_get_tb_cpu_state(CPUState *env, target_ulong *pc, target_ulong *cs_base, int *flags)
 {
     *pc = env->pc;
     *cs_base = 0;
-    *flags = 0; // necessary to avoid compiler warning
+    *flags = 0;
+    // When vtype is valid, vstart is 0 and vl covers the whole register group, vector
+    // instructions can be translated for this exact configuration
+    if (!env->vill && env->vstart == 0 && env->vl != 0 && env->vl == env->vlmax) {
+        *flags = RISCV_TBFLAG_VSTATIC_MASK | (GET_VTYPE_VSEW(env->vtype) << RISCV_TBFLAG_VSEW_SHIFT) |
+                 (GET_VTYPE_VLMUL(env->vtype) << RISCV_TBFLAG_VLMUL_SHIFT);
+    }
 }
 
 static inline bool cpu_has_work(CPUState *env)
@@ -377,11 +414,6 @@ static inline int supported_fpu_extensions_count(CPUState *env)
     return !!riscv_has_ext(env, RISCV_FEATURE_RVF) + !!riscv_has_ext(env, RISCV_FEATURE_RVD);
 }
 
-#define GET_VTYPE_VLMUL(inst)    extract32(inst, 0, 3)
-#define GET_VTYPE_VSEW(inst)     extract32(inst, 3, 3)
-#define GET_VTYPE_VTA(inst)      extract32(inst, 6, 1)
-#define GET_VTYPE_VMA(inst)      extract32(inst, 7, 1)
-
 // Vector registers are defined as contiguous segments of vlenb bytes.
 #define V(x) (env->vr + (x) * env->vlenb)
 #define V08(x,y) (env->vr[(x) * env->vlenb + y])
@@ -393,6 +425,43 @@ static inline int supported_fpu_extensions_count(CPUState *env)
 #define WR_V32(x,y,d) {V08(x,y) = (d >> 24) & 0xff;V08(x,y+1) = (d >> 16) & 0xff;V08(x,y+2) = (d >> 8) & 0xff; V08(x,y+3) = d & 0xff;}
 #define WR_V64(x,y,d) {V08(x,y) = (d >> 56) & 0xff;V08(x,y+1) = (d >> 48) & 0xff;V08(x,y+2) = (d >> 40) & 0xff;V08(x,y+3) = (d >> 32) & 0xff; \
                        V08(x,y+4) = (d >> 24) & 0xff;V08(x,y+5) = (d >> 16) & 0xff;V08(x,y+6) = (d >> 8) & 0xff;V08(x,y+7) = d & 0xff;}
+
+// Expands the statements once for every element width in a switch over eew, any other width is an illegal instruction.
+// In each case etype and stype are the unsigned and signed element types.
+#define EEW_CASE(bits, ...)                                         \
+    case bits: {                                                    \
+        typedef uint##bits##_t etype __attribute__((unused));       \
+        typedef int##bits##_t stype __attribute__((unused));        \
+        __VA_ARGS__                                                 \
+        break;                                                      \
+    }
+#define SWITCH_EEW(eew, ...)                                        \
+    switch (eew) {                                                  \
+    EEW_CASE(8, __VA_ARGS__)                                        \
+    EEW_CASE(16, __VA_ARGS__)                                       \
+    EEW_CASE(32, __VA_ARGS__)                                       \
+    EEW_CASE(64, __VA_ARGS__)                                       \
+    default:                                                        \
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);  \
+        break;                                                      \
+    }
+// Same for the widening and narrowing operations, which have no 64-bit variant; wtype and swtype are twice as wide
+#define NARROW_EEW_CASE(bits, wbits, ...)                                   \
+    EEW_CASE(bits,                                                          \
+        typedef uint##wbits##_t wtype __attribute__((unused));              \
+        typedef int##wbits##_t swtype __attribute__((unused));              \
+        __VA_ARGS__                                                         \
+    )
+#define SWITCH_NARROW_EEW(eew, ...)                                 \
+    switch (eew) {                                                  \
+    NARROW_EEW_CASE(8, 16, __VA_ARGS__)                             \
+    NARROW_EEW_CASE(16, 32, __VA_ARGS__)                            \
+    NARROW_EEW_CASE(32, 64, __VA_ARGS__)                            \
+    default:                                                        \
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);  \
+        break;                                                      \
+    }
+
 #define SEW() GET_VTYPE_VSEW(env->vtype)
 /* This returns the emul for the destination endcoded just as the vlmul field, the eew (for the destination) must be encoded just like the SEW field.
 // Effectively this just adjusts the emul to the resulting element width change in case of narrowing/widening instructions
@@ -57,6 +57,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 =============================================================================*/
 
+#include <float.h>
 #include "cpu.h"
 
 /* convert RISC-V rounding mode to IEEE library numbers */
@@ -124,6 +125,159 @@ unsigned int softfloat_flags_to_riscv(unsigned int flags)
     set_float_exception_flags(0, &env->fp_status); \
 } while (0)
 
+/* Host FPU fast path
+ *
+ * With round-to-nearest-even the host computes add/sub/mul/div/sqrt exactly as softfloat does
+ * as long as no NaN, infinity or subnormal is involved, so for normal or zero inputs the only
+ * difference is in the accrued flags. Instead of detecting inexact results the fast path is taken
+ * only when NX is already set, which is the usual state in FP-heavy code. Results that could have
+ * overflowed or underflowed are recomputed with softfloat to get the flags right.
+ * Hosts evaluating float expressions in extended precision (x87) would round twice, so they
+ * always use softfloat.
+ */
+static inline bool can_use_host_fpu(CPUState *env, uint64_t rm)
+{
+#if FLT_EVAL_METHOD == 0
+    return env->use_host_fpu && rm == riscv_float_round_nearest_even && (env->fflags & FPEXC_NX);
+#else
+    return false;
+#endif
+}
+
+static inline float host_float32(float32 a)
+{
+    float f;
+    memcpy(&f, &a, sizeof(f));
+    return f;
+}
+
+static inline double host_float64(float64 a)
+{
+    double d;
+    memcpy(&d, &a, sizeof(d));
+    return d;
+}
+
+/* zero_is_exact tells whether a zero result can only come from exact arithmetic */
+static inline bool host_float32_result(float r, bool zero_is_exact, float32 *result)
+{
+    if (unlikely(isinf(r) || (fabsf(r) <= FLT_MIN && !(r == 0 && zero_is_exact)))) {
+        return false;
+    }
+    memcpy(result, &r, sizeof(r));
+    return true;
+}
+
+static inline bool host_float64_result(double r, bool zero_is_exact, float64 *result)
+{
+    if (unlikely(isinf(r) || (fabs(r) <= DBL_MIN && !(r == 0 && zero_is_exact)))) {
+        return false;
+    }
+    memcpy(result, &r, sizeof(r));
+    return true;
+}
+
+/* Sums of normals that end up tiny are always exact, so a zero sum never raises flags */
+static float32 fast_float32_add(CPUState *env, uint64_t rm, float32 a, float32 b)
+{
+    float32 result;
+    if (can_use_host_fpu(env, rm) && float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b) &&
+        host_float32_result(host_float32(a) + host_float32(b), true, &result)) {
+        return result;
+    }
+    return float32_add(a, b, &env->fp_status);
+}
+
+static float32 fast_float32_sub(CPUState *env, uint64_t rm, float32 a, float32 b)
+{
+    float32 result;
+    if (can_use_host_fpu(env, rm) && float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b) &&
+        host_float32_result(host_float32(a) - host_float32(b), true, &result)) {
+        return result;
+    }
+    return float32_sub(a, b, &env->fp_status);
+}
+
+static float32 fast_float32_mul(CPUState *env, uint64_t rm, float32 a, float32 b)
+{
+    float32 result;
+    if (can_use_host_fpu(env, rm) && float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b) &&
+        host_float32_result(host_float32(a) * host_float32(b), float32_is_zero(a) || float32_is_zero(b), &result)) {
+        return result;
+    }
+    return float32_mul(a, b, &env->fp_status);
+}
+
+static float32 fast_float32_div(CPUState *env, uint64_t rm, float32 a, float32 b)
+{
+    float32 result;
+    if (can_use_host_fpu(env, rm) && float32_is_zero_or_normal(a) && float32_is_normal(b) &&
+        host_float32_result(host_float32(a) / host_float32(b), float32_is_zero(a), &result)) {
+        return result;
+    }
+    return float32_div(a, b, &env->fp_status);
+}
+
+static float32 fast_float32_sqrt(CPUState *env, uint64_t rm, float32 a)
+{
+    float32 result;
+    if (can_use_host_fpu(env, rm) && (float32_is_zero(a) || (float32_is_normal(a) && !float32_is_neg(a))) &&
+        host_float32_result(sqrtf(host_float32(a)), true, &result)) {
+        return result;
+    }
+    return float32_sqrt(a, &env->fp_status);
+}
+
+static float64 fast_float64_add(CPUState *env, uint64_t rm, float64 a, float64 b)
+{
+    float64 result;
+    if (can_use_host_fpu(env, rm) && float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b) &&
+        host_float64_result(host_float64(a) + host_float64(b), true, &result)) {
+        return result;
+    }
+    return float64_add(a, b, &env->fp_status);
+}
+
+static float64 fast_float64_sub(CPUState *env, uint64_t rm, float64 a, float64 b)
+{
+    float64 result;
+    if (can_use_host_fpu(env, rm) && float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b) &&
+        host_float64_result(host_float64(a) - host_float64(b), true, &result)) {
+        return result;
+    }
+    return float64_sub(a, b, &env->fp_status);
+}
+
+static float64 fast_float64_mul(CPUState *env, uint64_t rm, float64 a, float64 b)
+{
+    float64 result;
+    if (can_use_host_fpu(env, rm) && float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b) &&
+        host_float64_result(host_float64(a) * host_float64(b), float64_is_zero(a) || float64_is_zero(b), &result)) {
+        return result;
+    }
+    return float64_mul(a, b, &env->fp_status);
+}
+
+static float64 fast_float64_div(CPUState *env, uint64_t rm, float64 a, float64 b)
+{
+    float64 result;
+    if (can_use_host_fpu(env, rm) && float64_is_zero_or_normal(a) && float64_is_normal(b) &&
+        host_float64_result(host_float64(a) / host_float64(b), float64_is_zero(a), &result)) {
+        return result;
+    }
+    return float64_div(a, b, &env->fp_status);
+}
+
+static float64 fast_float64_sqrt(CPUState *env, uint64_t rm, float64 a)
+{
+    float64 result;
+    if (can_use_host_fpu(env, rm) && (float64_is_zero(a) || (float64_is_normal(a) && !float64_is_neg(a))) &&
+        host_float64_result(sqrt(host_float64(a)), true, &result)) {
+        return result;
+    }
+    return float64_sqrt(a, &env->fp_status);
+}
+
 uint64_t helper_fmadd_s(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t frs3, uint64_t rm)
 {
     require_fp;
@@ -208,7 +362,7 @@ uint64_t helper_fadd_s(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float32_add(frs1, frs2, &env->fp_status);
+    frs1 = fast_float32_add(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -218,7 +372,7 @@ uint64_t helper_fsub_s(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float32_sub(frs1, frs2, &env->fp_status);
+    frs1 = fast_float32_sub(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -228,7 +382,7 @@ uint64_t helper_fmul_s(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float32_mul(frs1, frs2, &env->fp_status);
+    frs1 = fast_float32_mul(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -238,7 +392,7 @@ uint64_t helper_fdiv_s(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float32_div(frs1, frs2, &env->fp_status);
+    frs1 = fast_float32_div(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -266,7 +420,7 @@ uint64_t helper_fsqrt_s(CPUState *env, uint64_t frs1, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float32_sqrt(frs1, &env->fp_status);
+    frs1 = fast_float32_sqrt(env, rm, frs1);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -530,7 +684,7 @@ uint64_t helper_fadd_d(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float64_add(frs1, frs2, &env->fp_status);
+    frs1 = fast_float64_add(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -540,7 +694,7 @@ uint64_t helper_fsub_d(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float64_sub(frs1, frs2, &env->fp_status);
+    frs1 = fast_float64_sub(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -550,7 +704,7 @@ uint64_t helper_fmul_d(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float64_mul(frs1, frs2, &env->fp_status);
+    frs1 = fast_float64_mul(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -560,7 +714,7 @@ uint64_t helper_fdiv_d(CPUState *env, uint64_t frs1, uint64_t frs2, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float64_div(frs1, frs2, &env->fp_status);
+    frs1 = fast_float64_div(env, rm, frs1, frs2);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
@@ -608,7 +762,7 @@ uint64_t helper_fsqrt_d(CPUState *env, uint64_t frs1, uint64_t rm)
 {
     require_fp;
     set_float_rounding_mode(RM, &env->fp_status);
-    frs1 = float64_sqrt(frs1, &env->fp_status);
+    frs1 = fast_float64_sqrt(env, rm, frs1);
     set_fp_exceptions();
     mark_fs_dirty();
     return frs1;
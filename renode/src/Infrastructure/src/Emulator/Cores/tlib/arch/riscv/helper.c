@@ -21,6 +21,7 @@
 #include "def-helper.h"
 #include "cpu-common.h"
 #include "arch_callbacks.h"
+#include "sampling_profiler.h"
 
 // This is used as a part of MISA register, indicating the architecture width.
 #if defined(TARGET_RISCV32)
@@ -33,6 +34,7 @@ void cpu_reset(CPUState *env)
 {
     int32_t interrupt_mode = env->interrupt_mode;
     int32_t csr_validation_level = env->csr_validation_level;
+    bool use_host_fpu = env->use_host_fpu;
     int privilege = env->privilege_architecture;
     target_ulong mhartid = env->mhartid;
     target_ulong misa_mask = env->misa_mask;
@@ -51,6 +53,7 @@ void cpu_reset(CPUState *env)
 
     env->interrupt_mode = interrupt_mode;
     env->csr_validation_level = csr_validation_level;
+    env->use_host_fpu = use_host_fpu;
     env->mhartid = mhartid;
     env->privilege_architecture = privilege;
     env->misa = misa_mask;
@@ -333,7 +336,6 @@ int cpu_handle_mmu_fault(CPUState *env, target_ulong address, int access_type, i
     int prot;
     int pmp_prot;
     int pmp_access_type = 1 << access_type;
-    int overlapping_region_id;
     int ret = TRANSLATE_FAIL;
     target_ulong page_size = TARGET_PAGE_SIZE;
 
@@ -343,24 +345,17 @@ int cpu_handle_mmu_fault(CPUState *env, target_ulong address, int access_type, i
         ret = TRANSLATE_FAIL;
     }
     if (ret == TRANSLATE_SUCCESS) {
-        overlapping_region_id = pmp_find_overlapping(env, pa & TARGET_PAGE_MASK, TARGET_PAGE_SIZE, 0);
-
-        // are there any PMP regions defined for this page?
-        if (overlapping_region_id != -1) {
-            // does the PMP region cover only a part of the page?
-            if (env->pmp_state.addr[overlapping_region_id].sa > (pa & TARGET_PAGE_MASK)
-                || env->pmp_state.addr[overlapping_region_id].ea < (pa & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE - 1)
-            {
-                // this effectively makes the tlb page entry one-shot:
-                // thanks to this every access to this page will be verified against PMP
-                page_size = access_width;
-            }
-            else
-            {
-                // PMP region covers the entire page, we can safely propagate restrictions
-                // to the page level (PAGE_xxxx follows the same notation as PMP_xxxx)
+        // is the whole page decided by one PMP rule?
+        if (pmp_is_range_covered(env, pa & TARGET_PAGE_MASK, TARGET_PAGE_SIZE)) {
+            // we can safely propagate restrictions to the page level (PAGE_xxxx follows the same notation as PMP_xxxx);
+            // accesses translated by the external MMU bypass PMP, so their pages keep the permissions they were given
+            if (!cpu->external_mmu_enabled) {
                 prot &= pmp_prot;
             }
+        } else if (!pmp_is_range_uniform(env, pa & TARGET_PAGE_MASK, TARGET_PAGE_SIZE)) {
+            // this effectively makes the tlb page entry one-shot:
+            // thanks to this every access to this page will be verified against PMP
+            page_size = access_width;
         }
 
         tlb_set_page(env, address & TARGET_PAGE_MASK, pa & TARGET_PAGE_MASK, prot, mmu_idx, page_size);
@@ -488,6 +483,16 @@ void do_interrupt(CPUState *env)
     env->exception_index = EXCP_NONE; /* mark as handled */
 }
 
+// Code built with frame pointers points `s0` right past the saved `ra` and the previous `s0`
+void cpu_get_frame_record_layout(CPUState *env, frame_record_layout_t *layout)
+{
+    layout->frame_pointer = env->gpr[8];
+    layout->previous_frame_pointer_offset = -2 * (int32_t)sizeof(target_ulong);
+    layout->return_address_offset = -(int32_t)sizeof(target_ulong);
+    layout->word_size = sizeof(target_ulong);
+    layout->return_address_mask = UINT64_MAX;
+}
+
 void do_nmi(CPUState *env)
 {
     if (env->nmi_pending == NMI_NONE) {
@@ -521,6 +526,7 @@ void tlib_arch_dispose()
 int cpu_init(const char *cpu_model)
 {
     cpu->csr_validation_level = CSR_VALIDATION_FULL;
+    cpu->use_host_fpu = true;
     cpu->misa_mask = cpu->misa = RVXLEN;
     pthread_mutex_init(&cpu->mip_lock, NULL);
 
@@ -76,6 +76,13 @@ DEF_HELPER_2(mret, tl, env, tl)
 DEF_HELPER_1(wfi, void, env)
 DEF_HELPER_1(fence_i, void, env)
 
+DEF_HELPER_4(amo_w, tl, env, tl, tl, i32)
+DEF_HELPER_3(sc_w, tl, env, tl, tl)
+#if defined(TARGET_RISCV64)
+DEF_HELPER_4(amo_d, tl, env, tl, tl, i32)
+DEF_HELPER_3(sc_d, tl, env, tl, tl)
+#endif
+
 // Vector helpers require 128-bit ints which aren't supported on 32-bit hosts.
 #if HOST_LONG_BITS != 32
 
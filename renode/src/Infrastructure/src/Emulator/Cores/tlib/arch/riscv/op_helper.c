@@ -17,6 +17,7 @@
  * License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
 #include "cpu.h"
+#include "instmap.h"
 #define ALIGNED_ONLY
 #include "softmmu_exec.h"
 
@@ -868,9 +869,7 @@ target_ulong helper_sret(CPUState *env, target_ulong cpu_pc_deb)
     riscv_set_mode(env, prev_priv);
     csr_write_helper(env, sstatus, CSR_SSTATUS);
 
-    acquire_global_memory_lock(env);
     cancel_reservation(env);
-    release_global_memory_lock(env);
     if(env->interrupt_end_callback_enabled)
     {
         tlib_on_interrupt_end(env->exception_index);
@@ -902,9 +901,7 @@ target_ulong helper_mret(CPUState *env, target_ulong cpu_pc_deb)
     riscv_set_mode(env, prev_priv);
     csr_write_helper(env, mstatus, CSR_MSTATUS);
 
-    acquire_global_memory_lock(env);
     cancel_reservation(env);
-    release_global_memory_lock(env);
     if(env->interrupt_end_callback_enabled)
     {
         tlib_on_interrupt_end(env->exception_index);
@@ -923,17 +920,120 @@ void helper_wfi(CPUState *env)
 void helper_fence_i(CPUState *env)
 {
     if (unlikely(env->tb_broadcast_dirty)) {
+        // code written by this hart must be visible to the other harts once they execute their fence.i,
+        // so the pages batched so far are broadcast now instead of waiting for the batch to fill up
+        flush_dirty_addresses_list();
+
         uint64_t size = 0;
         uint64_t *addresses = tlib_get_dirty_addresses_list(&size);
 
-        for (uint64_t i = 0; i < size; ++i) {
-            uint64_t start = addresses[i] & TARGET_PAGE_MASK;
-            uint64_t end = start | ~TARGET_PAGE_MASK;
-            tb_invalidate_phys_page_range_inner(start, end, false, false);
-        }
+        tb_invalidate_phys_pages(addresses, size);
+    }
+}
+
+// Returns the host address backing `address` if it's mapped in the TLB as plain RAM for both reading and writing.
+// Any flag set in the entries (MMIO, pages with translated code, one-shot pages) leaves the access to the softmmu,
+// as do misaligned accesses, so that they raise the proper exception.
+static inline void *amo_ram_host_pointer(CPUState *env, target_ulong address, int size)
+{
+    if ((address & (size - 1)) || env->tlib_is_on_memory_access_enabled) {
+        return NULL;
     }
+    int index = CPU_TLB_INDEX(env, address);
+    CPUTLBEntry *entry = &env->tlb_table[cpu_mmu_index(env)][index];
+    target_ulong page = address & TARGET_PAGE_MASK;
+    if (entry->addr_read != page || entry->addr_write != page) {
+        return NULL;
+    }
+    return (void *)(uintptr_t)(address + entry->addend);
 }
 
+#define AMO_COMPUTE(TYPE, STYPE, NAME, SUFFIX)                                      \
+static inline TYPE amo_compute_##NAME(uint32_t opc, TYPE old, TYPE value)       \
+{                                                                                   \
+    switch (opc) {                                                                  \
+    case OPC_RISC_AMOSWAP_##SUFFIX:                                                 \
+        return value;                                                               \
+    case OPC_RISC_AMOADD_##SUFFIX:                                                  \
+        return old + value;                                                         \
+    case OPC_RISC_AMOXOR_##SUFFIX:                                                  \
+        return old ^ value;                                                         \
+    case OPC_RISC_AMOAND_##SUFFIX:                                                  \
+        return old & value;                                                         \
+    case OPC_RISC_AMOOR_##SUFFIX:                                                   \
+        return old | value;                                                         \
+    case OPC_RISC_AMOMIN_##SUFFIX:                                                  \
+        return (STYPE)old < (STYPE)value ? old : value;                             \
+    case OPC_RISC_AMOMAX_##SUFFIX:                                                  \
+        return (STYPE)old > (STYPE)value ? old : value;                             \
+    case OPC_RISC_AMOMINU_##SUFFIX:                                                 \
+        return old < value ? old : value;                                           \
+    case OPC_RISC_AMOMAXU_##SUFFIX:                                                 \
+        return old > value ? old : value;                                           \
+    default:                                                                        \
+        tlib_abortf("Unexpected AMO opcode 0x%x", opc);                             \
+        return old;                                                                 \
+    }                                                                               \
+}
+
+// AMOs run under the memory lock of their address so that they can't interleave with SC.
+// On RAM the read-modify-write is done with a host atomic, which also keeps it atomic
+// with respect to plain stores of other cpus that don't take the lock.
+#define AMO_HELPER(TYPE, STYPE, SUFFIX, SIZE, LOAD, STORE)                          \
+target_ulong helper_amo_##SUFFIX(CPUState *env, target_ulong address, target_ulong value, uint32_t opc) \
+{                                                                                   \
+    TYPE old;                                                                       \
+    TYPE *host = amo_ram_host_pointer(env, address, SIZE);                          \
+                                                                                    \
+    acquire_memory_lock(env, address);                                              \
+    if (host != NULL) {                                                             \
+        register_address_access(env, address);                                      \
+        old = __atomic_load_n(host, __ATOMIC_RELAXED);                              \
+        while (!__atomic_compare_exchange_n(host, &old, amo_compute_##SUFFIX(opc, old, value), false, \
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {  \
+        }                                                                           \
+    } else {                                                                        \
+        old = LOAD(address);                                                        \
+        STORE(address, amo_compute_##SUFFIX(opc, old, value));                      \
+    }                                                                               \
+    release_memory_lock(env);                                                       \
+                                                                                    \
+    return (target_ulong)(target_long)(STYPE)old;                                   \
+}
+
+// SC checks and stores under the memory lock of its address. The inline fast path of a store doesn't invalidate
+// the reservations of other cpus, so a successful SC does it here; any SC drops the reservation of its own cpu.
+// Returns 0 on success.
+#define SC_HELPER(TYPE, SUFFIX, SIZE, STORE)                                        \
+target_ulong helper_sc_##SUFFIX(CPUState *env, target_ulong address, target_ulong value) \
+{                                                                                   \
+    TYPE *host = amo_ram_host_pointer(env, address, SIZE);                          \
+                                                                                    \
+    acquire_memory_lock(env, address);                                              \
+    target_ulong failed = check_address_reservation(env, address);                  \
+    if (!failed) {                                                                  \
+        if (host != NULL) {                                                         \
+            register_address_access(env, address);                                  \
+            __atomic_store_n(host, (TYPE)value, __ATOMIC_SEQ_CST);                  \
+        } else {                                                                    \
+            STORE(address, value);                                                  \
+        }                                                                           \
+    }                                                                               \
+    cancel_reservation(env);                                                        \
+    release_memory_lock(env);                                                       \
+                                                                                    \
+    return failed;                                                                  \
+}
+
+AMO_COMPUTE(uint32_t, int32_t, w, W)
+AMO_HELPER(uint32_t, int32_t, w, 4, ldl, stl)
+SC_HELPER(uint32_t, w, 4, stl)
+#if defined(TARGET_RISCV64)
+AMO_COMPUTE(uint64_t, int64_t, d, D)
+AMO_HELPER(uint64_t, int64_t, d, 8, ldq, stq)
+SC_HELPER(uint64_t, d, 8, stq)
+#endif
+
 void do_unaligned_access(target_ulong addr, int access_type, int mmu_idx, void *retaddr)
 {
     env->badaddr = addr;
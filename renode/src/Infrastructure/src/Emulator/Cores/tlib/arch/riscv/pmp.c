@@ -35,9 +35,10 @@ do { tlib_printf(LOG_LEVEL_DEBUG, "pmp: " fmt, ## __VA_ARGS__); } while (0)
 do {} while (0)
 #endif
 
-static void pmp_write_cfg(CPUState *env, uint32_t addr_index, uint8_t val);
+static bool pmp_write_cfg(CPUState *env, uint32_t addr_index, uint8_t val);
 static uint8_t pmp_read_cfg(CPUState *env, uint32_t addr_index);
 static void pmp_update_rule(CPUState *env, uint32_t pmp_index);
+static void pmp_update_regions(CPUState *env);
 
 /*
  * Accessor method to extract address matching type 'a field' from cfg reg
@@ -98,19 +99,22 @@ static inline uint8_t pmp_read_cfg(CPUState *env, uint32_t pmp_index)
 /*
  * Accessor to set the cfg reg for a specific PMP/HART
  * Bounds checks and relevant lock bit.
+ * Returns true if the rule was updated.
  */
-static void pmp_write_cfg(CPUState *env, uint32_t pmp_index, uint8_t val)
+static bool pmp_write_cfg(CPUState *env, uint32_t pmp_index, uint8_t val)
 {
     if (pmp_index < MAX_RISCV_PMPS) {
         if (!pmp_is_locked(env, pmp_index)) {
             env->pmp_state.pmp[pmp_index].cfg_reg = val;
             pmp_update_rule(env, pmp_index);
+            return true;
         } else {
             PMP_DEBUG("Ignoring pmpcfg write - locked");
         }
     } else {
         PMP_DEBUG("Ignoring pmpcfg write - out of bounds");
     }
+    return false;
 }
 
 static void pmp_decode_napot(target_ulong addr, int napot_grain, target_ulong *start_addr, target_ulong *end_addr)
@@ -144,13 +148,10 @@ static void pmp_decode_napot(target_ulong addr, int napot_grain, target_ulong *s
  *   end address values.
  *   This function is called relatively infrequently whereas the check that
  *   an address is within a pmp rule is called often, so optimise that one
+ *   (see `pmp_update_regions`)
  */
 static void pmp_update_rule(CPUState *env, uint32_t pmp_index)
 {
-    int i;
-
-    env->pmp_state.num_rules = 0;
-
     uint8_t this_cfg = env->pmp_state.pmp[pmp_index].cfg_reg;
     target_ulong this_addr = env->pmp_state.pmp[pmp_index].addr_reg;
     target_ulong prev_addr = 0u;
@@ -200,16 +201,6 @@ static void pmp_update_rule(CPUState *env, uint32_t pmp_index)
 
     env->pmp_state.addr[pmp_index].sa = sa;
     env->pmp_state.addr[pmp_index].ea = ea;
-
-    for (i = 0; i < MAX_RISCV_PMPS; i++) {
-        const uint8_t a_field =
-            pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
-        if (PMP_AMATCH_OFF != a_field) {
-            env->pmp_state.num_rules++;
-        }
-    }
-
-    tlb_flush(env, 1, true);
 }
 
 static int pmp_is_in_range(CPUState *env, int pmp_index, target_ulong addr)
@@ -226,35 +217,153 @@ static int pmp_is_in_range(CPUState *env, int pmp_index, target_ulong addr)
 }
 
 /*
- * Public Interface
+ * Return the first active rule matching the address or -1 if there is none
  */
-
-int pmp_find_overlapping(CPUState *env, target_ulong addr, target_ulong size, int starting_index)
+static int pmp_find_rule(CPUState *env, target_ulong addr)
 {
     int i;
-    target_ulong pmp_sa;
-    target_ulong pmp_ea;
 
-    for (i = starting_index; i < MAX_RISCV_PMPS; i++) {
-        pmp_sa = env->pmp_state.addr[i].sa;
-        pmp_ea = env->pmp_state.addr[i].ea;
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        if (pmp_is_in_range(env, i, addr) && pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg) != PMP_AMATCH_OFF) {
+            return i;
+        }
+    }
+    return -1;
+}
 
-        if (pmp_sa < addr) {
-            if (pmp_ea >= addr) {
-                return i;
-            }
-        } else if (pmp_sa <= addr + size - 1) {
+/*
+ * Return the first rule (also an inactive one) that starts or ends right before the address
+ */
+static int pmp_find_rule_bounded_at(CPUState *env, target_ulong addr)
+{
+    int i;
+    pmp_addr_t *range;
+
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        range = &env->pmp_state.addr[i];
+        if (range->sa <= range->ea && (range->sa == addr || range->ea + 1 == addr)) {
             return i;
         }
     }
+    return MAX_RISCV_PMPS;
+}
 
-    return -1;
+static void pmp_set_region_privs(CPUState *env, pmp_region_t *region, int rule)
+{
+    region->is_covered = rule != -1;
+    if (rule == -1) {
+        /* Privileged spec v1.10 states if no PMP entry matches an M-Mode access, the access succeeds */
+        region->m_mode_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
+        region->privs = 0;
+        return;
+    }
+    region->privs = (PMP_READ | PMP_WRITE | PMP_EXEC) & env->pmp_state.pmp[rule].cfg_reg;
+    region->m_mode_privs = pmp_is_locked(env, rule) ? region->privs : PMP_READ | PMP_WRITE | PMP_EXEC;
 }
 
 /*
- * Find and return PMP configuration matching memory address
+ * Split the address space at the boundaries of all rules and note the permissions granted in each part,
+ * so that `pmp_get_access` can find them by a binary search instead of checking every rule.
+ *
+ * Neighbouring parts are merged only if they are decided by the same rule and every rule
+ * with a boundary between them comes after it. An access crossing the boundary of an earlier
+ * rule is partially inside it and gets no permissions, which the merged region would not show.
  */
-int pmp_get_access(CPUState *env, target_ulong addr, target_ulong size)
+static void pmp_update_regions(CPUState *env)
+{
+    int i, j;
+    int rule, last_rule = -1;
+    target_ulong bounds[PMP_MAX_REGIONS];
+    target_ulong bound;
+    uint32_t bounds_count = 0;
+    pmp_table_t *state = &env->pmp_state;
+
+    state->num_rules = 0;
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        const uint8_t a_field =
+            pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
+        if (PMP_AMATCH_OFF != a_field) {
+            env->pmp_state.num_rules++;
+        }
+    }
+
+    bounds[bounds_count++] = 0;
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        /* a range with the start after the end matches no address */
+        if (state->addr[i].sa > state->addr[i].ea) {
+            continue;
+        }
+        bounds[bounds_count++] = state->addr[i].sa;
+        if (state->addr[i].ea != (target_ulong)-1) {
+            bounds[bounds_count++] = state->addr[i].ea + 1;
+        }
+    }
+
+    /* insertion sort, there are just a few bounds */
+    for (i = 1; i < bounds_count; i++) {
+        bound = bounds[i];
+        for (j = i; j > 0 && bounds[j - 1] > bound; j--) {
+            bounds[j] = bounds[j - 1];
+        }
+        bounds[j] = bound;
+    }
+
+    state->num_regions = 0;
+    for (i = 0; i < bounds_count; i++) {
+        if (i > 0 && bounds[i] == bounds[i - 1]) {
+            continue;
+        }
+        rule = pmp_find_rule(env, bounds[i]);
+        if (state->num_regions > 0 && rule != -1 && rule == last_rule && pmp_find_rule_bounded_at(env, bounds[i]) > rule) {
+            continue;
+        }
+        state->regions[state->num_regions].sa = bounds[i];
+        pmp_set_region_privs(env, &state->regions[state->num_regions], rule);
+        state->num_regions++;
+        last_rule = rule;
+    }
+
+    tlb_flush(env, 1, true);
+}
+
+/*
+ * Return the index of the region containing the address
+ */
+static inline int pmp_find_region(pmp_table_t *state, target_ulong addr)
+{
+    /* the first region always starts at 0 */
+    int low = 0;
+    int high = state->num_regions - 1;
+    int middle;
+
+    while (low < high) {
+        middle = (low + high + 1) / 2;
+        if (state->regions[middle].sa <= addr) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+/*
+ * Check whether the [addr, addr + size - 1] range lies within one region
+ */
+static inline bool pmp_region_contains(pmp_table_t *state, int region, target_ulong addr, target_ulong size)
+{
+    target_ulong end = addr + size - 1;
+
+    if (end < addr) {
+        return false;
+    }
+    return (region + 1 == state->num_regions) || (end < state->regions[region + 1].sa);
+}
+
+/*
+ * Check the access against each rule, used for accesses crossing the boundary of a region
+ */
+static int pmp_get_access_by_rules(CPUState *env, target_ulong addr, target_ulong size)
 {
     int i = 0;
     int ret = -1;
@@ -262,11 +371,6 @@ int pmp_get_access(CPUState *env, target_ulong addr, target_ulong size)
     target_ulong e = 0;
     pmp_priv_t allowed_privs = 0;
 
-    /* Short cut if no rules */
-    if (0 == pmp_get_num_rules(env)) {
-        return PMP_READ | PMP_WRITE | PMP_EXEC;
-    }
-
     /* 1.10 draft priv spec states there is an implicit order
          from low to high */
     for (i = 0; i < MAX_RISCV_PMPS; i++) {
@@ -308,6 +412,59 @@ int pmp_get_access(CPUState *env, target_ulong addr, target_ulong size)
     return ret;
 }
 
+/*
+ * Public Interface
+ */
+
+/*
+ * Find and return PMP configuration matching memory address
+ */
+int pmp_get_access(CPUState *env, target_ulong addr, target_ulong size)
+{
+    pmp_table_t *state = &env->pmp_state;
+    int region;
+
+    /* Short cut if no rules */
+    if (0 == pmp_get_num_rules(env)) {
+        return PMP_READ | PMP_WRITE | PMP_EXEC;
+    }
+
+    region = pmp_find_region(state, addr);
+    if (!pmp_region_contains(state, region, addr, size)) {
+        return pmp_get_access_by_rules(env, addr, size);
+    }
+    return env->priv == PRV_M ? state->regions[region].m_mode_privs : state->regions[region].privs;
+}
+
+/*
+ * Check whether every access within the range gets the same permissions,
+ * so that they can be cached at the page level
+ */
+bool pmp_is_range_uniform(CPUState *env, target_ulong addr, target_ulong size)
+{
+    pmp_table_t *state = &env->pmp_state;
+
+    if (0 == pmp_get_num_rules(env)) {
+        return true;
+    }
+    return pmp_region_contains(state, pmp_find_region(state, addr), addr, size);
+}
+
+/*
+ * Check whether a single active rule decides every access within the range
+ */
+bool pmp_is_range_covered(CPUState *env, target_ulong addr, target_ulong size)
+{
+    pmp_table_t *state = &env->pmp_state;
+    int region;
+
+    if (0 == pmp_get_num_rules(env)) {
+        return false;
+    }
+    region = pmp_find_region(state, addr);
+    return state->regions[region].is_covered && pmp_region_contains(state, region, addr, size);
+}
+
 /*
  * Handle a write to a pmpcfg CSP
  */
@@ -332,9 +489,13 @@ void pmpcfg_csr_write(CPUState *env, uint32_t reg_index, target_ulong val)
     base_offset /= 2;
 #endif
 
+    bool updated = false;
     for (i = 0; i < sizeof(target_ulong); i++) {
         cfg_val = (val >> 8 * i) & 0xff;
-        pmp_write_cfg(env, base_offset + i, cfg_val);
+        updated |= pmp_write_cfg(env, base_offset + i, cfg_val);
+    }
+    if (updated) {
+        pmp_update_regions(env);
     }
 }
 
@@ -375,6 +536,7 @@ void pmpaddr_csr_write(CPUState *env, uint32_t addr_index, target_ulong val)
         if (!pmp_is_locked(env, addr_index)) {
             env->pmp_state.pmp[addr_index].addr_reg = val;
             pmp_update_rule(env, addr_index);
+            pmp_update_regions(env);
         } else {
             PMP_DEBUG("ignoring pmpaddr write - locked");
         }
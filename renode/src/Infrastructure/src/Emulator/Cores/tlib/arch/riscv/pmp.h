@@ -52,10 +52,24 @@ typedef struct {
     target_ulong ea;
 } pmp_addr_t;
 
+/* Each rule adds at most two region boundaries: its start and the address after its end */
+#define PMP_MAX_REGIONS (2 * MAX_RISCV_PMPS + 1)
+
+/* Region of addresses decided by the same rule, it ends where the next one starts */
+typedef struct {
+    target_ulong sa;
+    uint8_t m_mode_privs;
+    uint8_t privs;
+    /* false if no active rule matches the region and it gets the default permissions */
+    bool is_covered;
+} pmp_region_t;
+
 typedef struct {
     pmp_entry_t pmp[MAX_RISCV_PMPS];
     pmp_addr_t addr[MAX_RISCV_PMPS];
     uint32_t num_rules;
+    pmp_region_t regions[PMP_MAX_REGIONS];
+    uint32_t num_regions;
 } pmp_table_t;
 
 void pmpcfg_csr_write(CPUState *env, uint32_t reg_index, target_ulong val);
@@ -63,6 +77,7 @@ target_ulong pmpcfg_csr_read(CPUState *env, uint32_t reg_index);
 void pmpaddr_csr_write(CPUState *env, uint32_t addr_index, target_ulong val);
 target_ulong pmpaddr_csr_read(CPUState *env, uint32_t addr_index);
 int pmp_get_access(CPUState *env, target_ulong addr, target_ulong size);
-int pmp_find_overlapping(CPUState *env, target_ulong addr, target_ulong size, int starting_index);
+bool pmp_is_range_uniform(CPUState *env, target_ulong addr, target_ulong size);
+bool pmp_is_range_covered(CPUState *env, target_ulong addr, target_ulong size);
 
 #endif
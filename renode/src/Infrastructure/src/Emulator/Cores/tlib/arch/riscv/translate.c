@@ -22,6 +22,8 @@
 #include "debug.h"
 #include "arch_callbacks.h"
 #include "cpu_registers.h"
+#include "tcg-gvec-desc.h"
+#include "tcg-op-gvec.h"
 
 /* global register indices */
 static TCGv cpu_gpr[32], cpu_pc, cpu_opcode;
@@ -214,7 +216,10 @@ static inline bool use_goto_tb(DisasContext *dc, target_ulong dest)
 
 static inline void gen_goto_tb(DisasContext *dc, int n, target_ulong dest)
 {
-    if (use_goto_tb(dc, dest)) {
+    if (gen_superblock_continue(&dc->base, dest)) {
+        return;
+    }
+    if (use_goto_tb(dc, dest) && superblock_can_chain(&dc->base)) {
         /* chaining is only allowed when the jump is to the same page */
         tcg_gen_goto_tb(n);
         tcg_gen_movi_tl(cpu_pc, dest);
@@ -1539,6 +1544,11 @@ static void gen_v_load(DisasContext *dc, uint32_t opc, uint32_t rest, uint32_t v
                 }
                 break;
             }
+            /* end tb since the load can shrink vl, which is a part of the TB flags;
+               a chained jump would skip checking them */
+            tcg_gen_movi_tl(cpu_pc, dc->npc);
+            gen_exit_tb_no_chaining(dc->base.tb);
+            dc->base.is_jmp = DISAS_BRANCH;
             break;
         }
         break;
@@ -1827,136 +1837,60 @@ static void gen_atomic(CPUState *env, DisasContext *dc, uint32_t opc, int rd, in
     /* TODO: handle aq, rl bits? - for now just get rid of them: */
     opc = MASK_OP_ATOMIC_NO_AQ_RL(opc);
     TCGv source1, source2, dat;
-    int done;
-    int finish_label;
+    TCGv_i32 amo_opc;
     source1 = tcg_temp_local_new();
     source2 = tcg_temp_local_new();
-    done = gen_new_label();
     dat = tcg_temp_local_new();
     gen_get_gpr(source1, rs1);
     gen_get_gpr(source2, rs2);
 
     gen_sync_pc(dc);
 
-    gen_helper_acquire_global_memory_lock(cpu_env);
-
     switch (opc) {
     case OPC_RISC_LR_W:
+        gen_helper_acquire_memory_lock(cpu_env, source1);
         gen_helper_reserve_address(cpu_env, source1);
         tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
+        gen_helper_release_memory_lock(cpu_env);
         break;
     case OPC_RISC_SC_W:
-        finish_label = gen_new_label();
-        gen_helper_check_address_reservation(dat, cpu_env, source1);
-        tcg_gen_brcondi_tl(TCG_COND_NE, dat, 0, finish_label);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        gen_set_label(finish_label);
+        gen_helper_sc_w(dat, cpu_env, source1, source2);
         break;
     case OPC_RISC_AMOSWAP_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOADD_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_add_tl(source2, dat, source2);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOXOR_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_xor_tl(source2, dat, source2);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOAND_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_and_tl(source2, dat, source2);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOOR_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_or_tl(source2, dat, source2);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOMIN_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_i32(TCG_COND_LT, dat, source2, done);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMAX_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_i32(TCG_COND_GT, dat, source2, done);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMINU_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_i32(TCG_COND_LTU, dat, source2, done);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMAXU_W:
-        tcg_gen_qemu_ld32s(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_i32(TCG_COND_GTU, dat, source2, done);
-        tcg_gen_qemu_st32(source2, source1, dc->base.mem_idx);
+        amo_opc = tcg_const_i32(opc);
+        gen_helper_amo_w(dat, cpu_env, source1, source2, amo_opc);
+        tcg_temp_free_i32(amo_opc);
         break;
 #if defined(TARGET_RISCV64)
     case OPC_RISC_LR_D:
+        gen_helper_acquire_memory_lock(cpu_env, source1);
+        gen_helper_reserve_address(cpu_env, source1);
         tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
+        gen_helper_release_memory_lock(cpu_env);
         break;
     case OPC_RISC_SC_D:
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_movi_tl(dat, 0); // assume always success
+        gen_helper_sc_d(dat, cpu_env, source1, source2);
         break;
     case OPC_RISC_AMOSWAP_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOADD_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_add_tl(source2, dat, source2);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOXOR_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_xor_tl(source2, dat, source2);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOAND_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_and_tl(source2, dat, source2);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOOR_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_or_tl(source2, dat, source2);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        tcg_gen_mov_tl(source1, dat);
-        break;
     case OPC_RISC_AMOMIN_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_tl(TCG_COND_LT, dat, source2, done);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMAX_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_tl(TCG_COND_GT, dat, source2, done);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMINU_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_tl(TCG_COND_LTU, dat, source2, done);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
-        break;
     case OPC_RISC_AMOMAXU_D:
-        tcg_gen_qemu_ld64(dat, source1, dc->base.mem_idx);
-        tcg_gen_brcond_tl(TCG_COND_GTU, dat, source2, done);
-        tcg_gen_qemu_st64(source2, source1, dc->base.mem_idx);
+        amo_opc = tcg_const_i32(opc);
+        gen_helper_amo_d(dat, cpu_env, source1, source2, amo_opc);
+        tcg_temp_free_i32(amo_opc);
         break;
 #endif
     default:
@@ -1964,9 +1898,6 @@ static void gen_atomic(CPUState *env, DisasContext *dc, uint32_t opc, int rd, in
         break;
     }
 
-    gen_helper_release_global_memory_lock(cpu_env);
-
-    gen_set_label(done);
     gen_set_gpr(rd, dat);
     tcg_temp_free(source1);
     tcg_temp_free(source2);
@@ -2565,6 +2496,11 @@ static void gen_v_cfg(DisasContext *dc, uint32_t opc, int rd, int rs1, int rs2,
     }
     gen_set_gpr(rd, returned_vl);
 
+    /* end tb since the vector configuration is a part of the TB flags */
+    tcg_gen_movi_tl(cpu_pc, dc->npc);
+    gen_exit_tb_no_chaining(dc->base.tb);
+    dc->base.is_jmp = DISAS_BRANCH;
+
     tcg_temp_free(rs1_value);
     tcg_temp_free(rs2_value);
     tcg_temp_free(returned_vl);
@@ -2572,8 +2508,248 @@ static void gen_v_cfg(DisasContext *dc, uint32_t opc, int rd, int rs1, int rs2,
     tcg_temp_free(rs1_is_uimm);
 }
 
+typedef void GVecGen3Fn(unsigned, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+typedef void GVecGen2iFn(unsigned, uint32_t, uint32_t, int64_t, uint32_t, uint32_t);
+typedef void GVecGen2sFn(unsigned, uint32_t, uint32_t, TCGv_i64, uint32_t, uint32_t);
+typedef void GVecGen2shFn(unsigned, uint32_t, uint32_t, TCGv_i32, uint32_t, uint32_t);
+
+static inline uint32_t vreg_ofs(int reg)
+{
+    return offsetof(CPUState, vr) + reg * env->vlenb;
+}
+
+/* Returns the size of the register group if an unmasked instruction on vd, vs2 and vs1 can be
+ * expanded inline with gvec for the vector configuration the TB was translated for, 0 otherwise.
+ * Only LMUL >= 1 with vl == VLMAX is handled, so there are no tail elements to preserve.
+ * Misaligned register numbers are left to the helpers, which raise the illegal instruction exception. */
+static uint32_t gen_v_gvec_oprsz(DisasContext *dc, uint8_t vm, int vd, int vs2, int vs1)
+{
+    if (!dc->vstatic || !vm || dc->vlmul >= RESERVED_EMUL) {
+        return 0;
+    }
+    if (V_IDX_INVALID_EMUL(vd, dc->vlmul) || V_IDX_INVALID_EMUL(vs2, dc->vlmul) || V_IDX_INVALID_EMUL(vs1, dc->vlmul)) {
+        return 0;
+    }
+    uint32_t oprsz = env->vlenb << dc->vlmul;
+    if (oprsz < 8 || oprsz > (8 << SIMD_MAXSZ_BITS) || (offsetof(CPUState, vr) & 15) != 0) {
+        return 0;
+    }
+    return oprsz;
+}
+
+static bool gen_v_gvec_opivv(DisasContext *dc, uint8_t funct6, int vd, int vs1, int vs2, uint8_t vm)
+{
+    GVecGen3Fn *fn;
+    uint32_t oprsz = gen_v_gvec_oprsz(dc, vm, vd, vs2, vs1);
+    if (!oprsz) {
+        return false;
+    }
+
+    switch (funct6) {
+    case RISC_V_FUNCT_ADD:
+        fn = tcg_gen_gvec_add;
+        break;
+    case RISC_V_FUNCT_SUB:
+        fn = tcg_gen_gvec_sub;
+        break;
+    case RISC_V_FUNCT_MINU:
+        fn = tcg_gen_gvec_umin;
+        break;
+    case RISC_V_FUNCT_MIN:
+        fn = tcg_gen_gvec_smin;
+        break;
+    case RISC_V_FUNCT_MAXU:
+        fn = tcg_gen_gvec_umax;
+        break;
+    case RISC_V_FUNCT_MAX:
+        fn = tcg_gen_gvec_smax;
+        break;
+    case RISC_V_FUNCT_AND:
+        fn = tcg_gen_gvec_and;
+        break;
+    case RISC_V_FUNCT_OR:
+        fn = tcg_gen_gvec_or;
+        break;
+    case RISC_V_FUNCT_XOR:
+        fn = tcg_gen_gvec_xor;
+        break;
+    // gvec variable shifts take the shift amount modulo the element width, just like RVV
+    case RISC_V_FUNCT_SLL:
+        fn = tcg_gen_gvec_shlv;
+        break;
+    case RISC_V_FUNCT_SRL:
+        fn = tcg_gen_gvec_shrv;
+        break;
+    case RISC_V_FUNCT_SRA:
+        fn = tcg_gen_gvec_sarv;
+        break;
+    case RISC_V_FUNCT_MERGE_MV:
+        // vmv.v.v, other values of vs2 are reserved
+        if (vs2) {
+            return false;
+        }
+        tcg_gen_gvec_mov(dc->vsew, vreg_ofs(vd), vreg_ofs(vs1), oprsz, oprsz);
+        return true;
+    default:
+        return false;
+    }
+    fn(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), vreg_ofs(vs1), oprsz, oprsz);
+    return true;
+}
+
+static bool gen_v_gvec_opivi(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
+{
+    GVecGen2iFn *fn;
+    int64_t imm;
+    uint32_t oprsz = gen_v_gvec_oprsz(dc, vm, vd, vs2, 0);
+    if (!oprsz) {
+        return false;
+    }
+
+    switch (funct6) {
+    case RISC_V_FUNCT_ADD:
+        fn = tcg_gen_gvec_addi;
+        imm = sextract32(rs1, 0, 5);
+        break;
+    case RISC_V_FUNCT_AND:
+        fn = tcg_gen_gvec_andi;
+        imm = sextract32(rs1, 0, 5);
+        break;
+    case RISC_V_FUNCT_OR:
+        fn = tcg_gen_gvec_ori;
+        imm = sextract32(rs1, 0, 5);
+        break;
+    case RISC_V_FUNCT_XOR:
+        fn = tcg_gen_gvec_xori;
+        imm = sextract32(rs1, 0, 5);
+        break;
+    case RISC_V_FUNCT_SLL:
+        fn = tcg_gen_gvec_shli;
+        imm = rs1 & ((8 << dc->vsew) - 1);
+        break;
+    case RISC_V_FUNCT_SRL:
+        fn = tcg_gen_gvec_shri;
+        imm = rs1 & ((8 << dc->vsew) - 1);
+        break;
+    case RISC_V_FUNCT_SRA:
+        fn = tcg_gen_gvec_sari;
+        imm = rs1 & ((8 << dc->vsew) - 1);
+        break;
+    case RISC_V_FUNCT_MERGE_MV:
+        // vmv.v.i, other values of vs2 are reserved
+        if (vs2) {
+            return false;
+        }
+        tcg_gen_gvec_dup_imm(dc->vsew, vreg_ofs(vd), oprsz, oprsz, sextract32(rs1, 0, 5));
+        return true;
+    default:
+        return false;
+    }
+    fn(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), imm, oprsz, oprsz);
+    return true;
+}
+
+static bool gen_v_gvec_opivx(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
+{
+    GVecGen2sFn *fn = NULL;
+    GVecGen2shFn *shift_fn = NULL;
+    uint32_t oprsz = gen_v_gvec_oprsz(dc, vm, vd, vs2, 0);
+    if (!oprsz) {
+        return false;
+    }
+
+    switch (funct6) {
+    case RISC_V_FUNCT_ADD:
+        fn = tcg_gen_gvec_adds;
+        break;
+    case RISC_V_FUNCT_SUB:
+        fn = tcg_gen_gvec_subs;
+        break;
+    case RISC_V_FUNCT_AND:
+        fn = tcg_gen_gvec_ands;
+        break;
+    case RISC_V_FUNCT_OR:
+        fn = tcg_gen_gvec_ors;
+        break;
+    case RISC_V_FUNCT_XOR:
+        fn = tcg_gen_gvec_xors;
+        break;
+    case RISC_V_FUNCT_SLL:
+        shift_fn = tcg_gen_gvec_shls;
+        break;
+    case RISC_V_FUNCT_SRL:
+        shift_fn = tcg_gen_gvec_shrs;
+        break;
+    case RISC_V_FUNCT_SRA:
+        shift_fn = tcg_gen_gvec_sars;
+        break;
+    case RISC_V_FUNCT_MERGE_MV:
+        // vmv.v.x, other values of vs2 are reserved
+        if (vs2) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    TCGv t_tl = tcg_temp_new();
+    gen_get_gpr(t_tl, rs1);
+    if (shift_fn) {
+        // Only the low log2(SEW) bits of the scalar are used as the shift amount
+        TCGv_i32 t_shift = tcg_temp_new_i32();
+        tcg_gen_trunc_tl_i32(t_shift, t_tl);
+        tcg_gen_andi_i32(t_shift, t_shift, (8 << dc->vsew) - 1);
+        shift_fn(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), t_shift, oprsz, oprsz);
+        tcg_temp_free_i32(t_shift);
+    } else {
+        // The scalar is sign-extended to SEW, gvec truncates it to the element size
+        TCGv_i64 t_scalar = tcg_temp_new_i64();
+        tcg_gen_ext_tl_i64(t_scalar, t_tl);
+        if (fn) {
+            fn(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), t_scalar, oprsz, oprsz);
+        } else {
+            tcg_gen_gvec_dup_i64(dc->vsew, vreg_ofs(vd), oprsz, oprsz, t_scalar);
+        }
+        tcg_temp_free_i64(t_scalar);
+    }
+    tcg_temp_free(t_tl);
+    return true;
+}
+
+static bool gen_v_gvec_opmvv(DisasContext *dc, uint8_t funct6, int vd, int vs1, int vs2, uint8_t vm)
+{
+    uint32_t oprsz = gen_v_gvec_oprsz(dc, vm, vd, vs2, vs1);
+    if (!oprsz || funct6 != RISC_V_FUNCT_MUL) {
+        return false;
+    }
+    tcg_gen_gvec_mul(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), vreg_ofs(vs1), oprsz, oprsz);
+    return true;
+}
+
+static bool gen_v_gvec_opmvx(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
+{
+    TCGv t_tl;
+    TCGv_i64 t_scalar;
+    uint32_t oprsz = gen_v_gvec_oprsz(dc, vm, vd, vs2, 0);
+    if (!oprsz || funct6 != RISC_V_FUNCT_MUL) {
+        return false;
+    }
+    t_tl = tcg_temp_new();
+    t_scalar = tcg_temp_new_i64();
+    gen_get_gpr(t_tl, rs1);
+    tcg_gen_ext_tl_i64(t_scalar, t_tl);
+    tcg_gen_gvec_muls(dc->vsew, vreg_ofs(vd), vreg_ofs(vs2), t_scalar, oprsz, oprsz);
+    tcg_temp_free_i64(t_scalar);
+    tcg_temp_free(t_tl);
+    return true;
+}
+
 static void gen_v_opivv(DisasContext *dc, uint8_t funct6, int vd, int vs1, int vs2, uint8_t vm)
 {
+    if (gen_v_gvec_opivv(dc, funct6, vd, vs1, vs2, vm)) {
+        return;
+    }
     generate_vill_check(dc);
     TCGv_i32 t_vd, t_vs1, t_vs2;
     t_vd = tcg_temp_new_i32();
@@ -3180,6 +3356,9 @@ static void gen_v_opivt(DisasContext *dc, uint8_t funct6, int vd, int vs2, TCGv
 
 static void gen_v_opivi(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
 {
+    if (gen_v_gvec_opivi(dc, funct6, vd, rs1, vs2, vm)) {
+        return;
+    }
     if (funct6 != RISC_V_FUNCT_MV_NF_R) {
         generate_vill_check(dc);
     }
@@ -3264,6 +3443,9 @@ static void gen_v_opivi(DisasContext *dc, uint8_t funct6, int vd, int rs1, int v
 
 static void gen_v_opivx(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
 {
+    if (gen_v_gvec_opivx(dc, funct6, vd, rs1, vs2, vm)) {
+        return;
+    }
     generate_vill_check(dc);
     TCGv_i32 t_vd, t_vs2;
     TCGv t_tl;
@@ -3337,6 +3519,9 @@ static void gen_v_opivx(DisasContext *dc, uint8_t funct6, int vd, int rs1, int v
 
 static void gen_v_opmvv(DisasContext *dc, uint8_t funct6, int vd, int vs1, int vs2, uint8_t vm)
 {
+    if (gen_v_gvec_opmvv(dc, funct6, vd, vs1, vs2, vm)) {
+        return;
+    }
     generate_vill_check(dc);
     TCGv_i32 t_vd, t_vs1, t_vs2;
     TCGv t_tl;
@@ -3814,6 +3999,9 @@ static void gen_v_opmvv(DisasContext *dc, uint8_t funct6, int vd, int vs1, int v
 
 static void gen_v_opmvx(DisasContext *dc, uint8_t funct6, int vd, int rs1, int vs2, uint8_t vm)
 {
+    if (gen_v_gvec_opmvx(dc, funct6, vd, rs1, vs2, vm)) {
+        return;
+    }
     generate_vill_check(dc);
     TCGv_i32 t_vd, t_vs2;
     TCGv t_tl;
@@ -5337,9 +5525,13 @@ static int disas_insn(CPUState *env, DisasContext *dc)
     return instruction_length;
 }
 
-void setup_disas_context(DisasContextBase *dc, CPUState *env)
+void setup_disas_context(DisasContextBase *base, CPUState *env)
 {
-    dc->mem_idx = cpu_mmu_index(env);
+    DisasContext *dc = (DisasContext *)base;
+    dc->base.mem_idx = cpu_mmu_index(env);
+    dc->vstatic = RISCV_TBFLAG_VSTATIC(dc->base.tb->flags);
+    dc->vsew = RISCV_TBFLAG_VSEW(dc->base.tb->flags);
+    dc->vlmul = RISCV_TBFLAG_VLMUL(dc->base.tb->flags);
 }
 
 int gen_breakpoint(DisasContextBase *base, CPUBreakpoint *bp)
@@ -81,25 +81,13 @@ void helper_vmv_ivi(CPUState *env, uint32_t vd, target_long imm)
     if (V_IDX_INVALID(vd)) {
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = imm;
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = imm;
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = imm;
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = imm;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int ei = env->vstart; ei < vl; ++ei) {
+            ((stype *)vd_base)[ei] = imm;
         }
-    }
+    )
 }
 
 void helper_vmv_ivv(CPUState *env, uint32_t vd, int32_t vs1)
@@ -108,25 +96,14 @@ void helper_vmv_ivv(CPUState *env, uint32_t vd, int32_t vs1)
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs1)) {
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
-    for (int i = env->vstart; i < env->vl; ++i) {
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[i] = ((uint8_t *)V(vs1))[i];
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[i] = ((uint16_t *)V(vs1))[i];
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[i] = ((uint32_t *)V(vs1))[i];
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[i] = ((uint64_t *)V(vs1))[i];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs1_base = V(vs1);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int i = env->vstart; i < vl; ++i) {
+            ((etype *)vd_base)[i] = ((etype *)vs1_base)[i];
         }
-    }
+    )
 }
 
 void helper_vmerge_ivv(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -135,26 +112,17 @@ void helper_vmerge_ivv(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        uint8_t mask = !(V(0)[ei >> 3] & (1 << (ei & 0x7)));
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = mask ? ((int8_t *)V(vs2))[ei] : ((int8_t *)V(vs1))[ei];
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = mask ? ((int16_t *)V(vs2))[ei] : ((int16_t *)V(vs1))[ei];
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = mask ? ((int32_t *)V(vs2))[ei] : ((int32_t *)V(vs1))[ei];
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = mask ? ((int64_t *)V(vs2))[ei] : ((int64_t *)V(vs1))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int ei = env->vstart; ei < vl; ++ei) {
+            uint8_t mask = !(v0_base[ei >> 3] & (1 << (ei & 0x7)));
+            ((stype *)vd_base)[ei] = mask ? ((stype *)vs2_base)[ei] : ((stype *)vs1_base)[ei];
         }
-    }
+    )
 }
 
 void helper_vmerge_ivi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -163,26 +131,16 @@ void helper_vmerge_ivi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        uint8_t mask = !(V(0)[ei >> 3] & (1 << (ei & 0x7)));
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = mask ? ((int8_t *)V(vs2))[ei] : rs1;
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = mask ? ((int16_t *)V(vs2))[ei] : rs1;
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = mask ? ((int32_t *)V(vs2))[ei] : rs1;
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = mask ? ((int64_t *)V(vs2))[ei] : rs1;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int ei = env->vstart; ei < vl; ++ei) {
+            uint8_t mask = !(v0_base[ei >> 3] & (1 << (ei & 0x7)));
+            ((stype *)vd_base)[ei] = mask ? ((stype *)vs2_base)[ei] : rs1;
         }
-    }
+    )
 }
 
 void helper_vfmerge_vfm(CPUState *env, uint32_t vd, uint32_t vs2, uint64_t f1)
@@ -208,17 +166,16 @@ void helper_vfmerge_vfm(CPUState *env, uint32_t vd, uint32_t vs2, uint64_t f1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
         return;
     }
-    for (int ei = 0; ei < env->vl; ++ei) {
-        uint8_t mask = !(V(0)[ei >> 3] & (1 << (ei & 0x7)));
-        switch (eew) {
-        case 32:
-            ((uint32_t *)V(vd))[ei] = mask ? ((uint32_t *)V(vs2))[ei] : f1;
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = mask ? ((uint64_t *)V(vs2))[ei] : f1;
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int ei = 0; ei < vl; ++ei) {
+            uint8_t mask = !(v0_base[ei >> 3] & (1 << (ei & 0x7)));
+            ((etype *)vd_base)[ei] = mask ? ((etype *)vs2_base)[ei] : f1;
         }
-    }
+    )
 }
 
 void helper_vcompress_mvv(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -259,26 +216,17 @@ void helper_vadc_vvm(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int i = 0; i < env->vl; ++i) {
-        uint8_t carry = !!(V(0)[i >> 3] & (1 << (i & 0x7)));
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[i] = ((uint8_t *)V(vs2))[i] + ((uint8_t *)V(vs1))[i] + carry;
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[i] = ((uint16_t *)V(vs2))[i] + ((uint16_t *)V(vs1))[i] + carry;
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[i] = ((uint32_t *)V(vs2))[i] + ((uint32_t *)V(vs1))[i] + carry;
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[i] = ((uint64_t *)V(vs2))[i] + ((uint64_t *)V(vs1))[i] + carry;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int i = 0; i < vl; ++i) {
+            uint8_t carry = !!(v0_base[i >> 3] & (1 << (i & 0x7)));
+            ((etype *)vd_base)[i] = ((etype *)vs2_base)[i] + ((etype *)vs1_base)[i] + carry;
         }
-    }
+    )
 }
 
 void helper_vmadc_vv(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -376,26 +324,17 @@ void helper_vsbc_vvm(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int i = 0; i < env->vl; ++i) {
-        uint8_t borrow = !!(V(0)[i >> 3] & (1 << (i & 0x7)));
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[i] = ((uint8_t *)V(vs2))[i] - ((uint8_t *)V(vs1))[i] - borrow;
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[i] = ((uint16_t *)V(vs2))[i] - ((uint16_t *)V(vs1))[i] - borrow;
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[i] = ((uint32_t *)V(vs2))[i] - ((uint32_t *)V(vs1))[i] - borrow;
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[i] = ((uint64_t *)V(vs2))[i] - ((uint64_t *)V(vs1))[i] - borrow;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int i = 0; i < vl; ++i) {
+            uint8_t borrow = !!(v0_base[i >> 3] & (1 << (i & 0x7)));
+            ((etype *)vd_base)[i] = ((etype *)vs2_base)[i] - ((etype *)vs1_base)[i] - borrow;
         }
-    }
+    )
 }
 
 void helper_vmsbc_vv(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -485,26 +424,16 @@ void helper_vadc_vi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int i = 0; i < env->vl; ++i) {
-        uint8_t carry = !!(V(0)[i >> 3] & (1 << (i & 0x7)));
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[i] = ((uint8_t *)V(vs2))[i] + (int8_t)rs1 + carry;
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[i] = ((uint16_t *)V(vs2))[i] + (int16_t)rs1 + carry;
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[i] = ((uint32_t *)V(vs2))[i] + (int32_t)rs1 + carry;
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[i] = ((uint64_t *)V(vs2))[i] + (int64_t)rs1 + carry;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int i = 0; i < vl; ++i) {
+            uint8_t carry = !!(v0_base[i >> 3] & (1 << (i & 0x7)));
+            ((etype *)vd_base)[i] = ((etype *)vs2_base)[i] + (stype)rs1 + carry;
         }
-    }
+    )
 }
 
 void helper_vmadc_vi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -602,26 +531,16 @@ void helper_vsbc_vi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int i = 0; i < env->vl; ++i) {
-        uint8_t borrow = !!(V(0)[i >> 3] & (1 << (i & 0x7)));
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[i] = ((uint8_t *)V(vs2))[i] - (int8_t)rs1 - borrow;
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[i] = ((uint16_t *)V(vs2))[i] - (int16_t)rs1 - borrow;
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[i] = ((uint32_t *)V(vs2))[i] - (int32_t)rs1 - borrow;
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[i] = ((uint64_t *)V(vs2))[i] - (int64_t)rs1 - borrow;
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const v0_base = V(0);
+    const int vl = env->vl;
+    SWITCH_EEW(eew,
+        for (int i = 0; i < vl; ++i) {
+            uint8_t borrow = !!(v0_base[i >> 3] & (1 << (i & 0x7)));
+            ((etype *)vd_base)[i] = ((etype *)vs2_base)[i] - (stype)rs1 - borrow;
         }
-    }
+    )
 }
 
 void helper_vmsbc_vi(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
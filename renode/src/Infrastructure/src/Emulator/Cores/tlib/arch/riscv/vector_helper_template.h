@@ -24,9 +24,42 @@
 if (!(V(0)[(ei) >> 3] & (1 << ((ei) & 0x7)))) {     \
     continue;                                       \
 }
+// Runs the statements for each active element between vstart and vl.
+// Whole mask bytes are tested first, so runs of 8 active (or 8 inactive) elements don't branch per element.
+#define FOR_EACH_ELEMENT(ei, ...)                                                               \
+{                                                                                               \
+    const uint8_t *const ei##_mask = V(0);                                                      \
+    const int ei##_vl = env->vl;                                                                \
+    int ei = env->vstart;                                                                       \
+    while (ei < ei##_vl) {                                                                      \
+        const uint8_t ei##_byte = ei##_mask[ei >> 3];                                           \
+        if ((ei & 0x7) == 0 && ei + 8 <= ei##_vl && (ei##_byte == 0 || ei##_byte == 0xff)) {    \
+            const int ei##_end = ei + 8;                                                        \
+            if (ei##_byte == 0) {                                                               \
+                ei = ei##_end;                                                                  \
+            }                                                                                   \
+            for (; ei < ei##_end; ++ei) {                                                       \
+                __VA_ARGS__                                                                     \
+            }                                                                                   \
+            continue;                                                                           \
+        }                                                                                       \
+        if (ei##_byte & (1 << (ei & 0x7))) {                                                    \
+            __VA_ARGS__                                                                         \
+        }                                                                                       \
+        ++ei;                                                                                   \
+    }                                                                                           \
+}
 #else
 #define POSTFIX
 #define TEST_MASK(ei)
+// Runs the statements for each element between vstart and vl.
+#define FOR_EACH_ELEMENT(ei, ...)                                                               \
+{                                                                                               \
+    const int ei##_vl = env->vl;                                                                \
+    for (int ei = env->vstart; ei < ei##_vl; ++ei) {                                            \
+        __VA_ARGS__                                                                             \
+    }                                                                                           \
+}
 #endif
 
 #if DATA_SIZE == 8
@@ -232,7 +265,7 @@ void glue(glue(glue(helper_vle, BITS), ff), POSTFIX)(CPUState *env, uint32_t vd,
         DATA_TYPE value = glue(glue(ld, USUFFIX), _graceful)(src_addr + ei * DATA_SIZE, &memory_access_fail);
         if (memory_access_fail) {
             env->vl = ei;
-            env->exception_index = 0;
+            env->exception_index = EXCP_NONE;
             break;
         }
         for (int fi = 0; fi <= nf; ++fi) {
@@ -463,33 +496,26 @@ void helper_vsm(CPUState *env, uint32_t vd, uint32_t rs1)
 
 #if SHIFT == 3
 
-#define VOP_UNSIGNED_VVX(NAME, OP)                                                                      \
+// The NAME helper generated above for the width of TYPE, used in the cases of SWITCH_EEW
+#define EEW_HELPER(NAME, TYPE)                                  \
+    __builtin_choose_expr(sizeof(TYPE) == 1, glue(NAME, 8),     \
+    __builtin_choose_expr(sizeof(TYPE) == 2, glue(NAME, 16),    \
+    __builtin_choose_expr(sizeof(TYPE) == 4, glue(NAME, 32), glue(NAME, 64))))
+
+#define VOP_UNSIGNED_VVX(NAME, OP)                                                                    \
 void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2, target_long imm)      \
 {                                                                                                       \
     const target_ulong eew = env->vsew;                                                                 \
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2)) {                                                      \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((uint8_t *)V(vd))[ei] = OP(((uint8_t *)V(vs2))[ei], ((uint8_t)(int8_t)imm));               \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], ((uint16_t)(int16_t)imm));           \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], ((uint32_t)(int32_t)imm));           \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], ((uint64_t)(int64_t)imm));           \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((etype *)vd_base)[ei] = OP(((etype *)vs2_base)[ei], ((etype)(stype)imm));                  \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_VVX(NAME, OP)                                                                        \
@@ -499,26 +525,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2)) {                                                      \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vs2))[ei], ((int8_t)imm));                          \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], ((int16_t)imm));                       \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], ((int32_t)imm));                       \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], ((int64_t)imm));                       \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((stype *)vs2_base)[ei], ((stype)imm));                         \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_UNSIGNED_VVX(NAME, OP)                                                               \
@@ -528,26 +541,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2)) {                                                      \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vs2))[ei], ((uint8_t)(int8_t)imm));                 \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], ((uint16_t)(int16_t)imm));             \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], ((uint32_t)(int32_t)imm));             \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], ((uint64_t)(int64_t)imm));             \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((stype *)vs2_base)[ei], ((etype)(stype)imm));                  \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_UNSIGNED_VVV(NAME, OP)                                                                      \
@@ -557,26 +557,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((uint8_t *)V(vd))[ei] = OP(((uint8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei]);              \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei]);           \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei]);           \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei]);           \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((etype *)vd_base)[ei] = OP(((etype *)vs2_base)[ei], ((etype *)vs1_base)[ei]);              \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_VVV(NAME, OP)                                                                        \
@@ -586,26 +574,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei]);                 \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei]);              \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei]);              \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei]);              \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei]);              \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_UNSIGNED_VVV(NAME, OP)                                                               \
@@ -615,26 +591,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei]);                \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei]);             \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei]);             \
-            break;                                                                                      \
-        case 64:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei]);             \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((stype *)vs2_base)[ei], ((etype *)vs1_base)[ei]);              \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_UNSIGNED_WVX(NAME, OP)                                                                                  \
@@ -644,23 +608,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                    \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                       \
     }                                                                                                               \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                \
-        TEST_MASK(ei)                                                                                               \
-        switch (eew) {                                                                                              \
-        case 8:                                                                                                     \
-            ((uint16_t *)V(vd))[ei] = OP((uint16_t)((uint8_t *)V(vs2))[ei], (uint16_t)((uint8_t)(int8_t)imm));      \
-            break;                                                                                                  \
-        case 16:                                                                                                    \
-            ((uint32_t *)V(vd))[ei] = OP((uint32_t)((uint16_t *)V(vs2))[ei], (uint32_t)((uint16_t)(int16_t)imm));   \
-            break;                                                                                                  \
-        case 32:                                                                                                    \
-            ((uint64_t *)V(vd))[ei] = OP((uint64_t)((uint32_t *)V(vs2))[ei], (uint64_t)((uint32_t)(int32_t)imm));   \
-            break;                                                                                                  \
-        default:                                                                                                    \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
-            break;                                                                                                  \
-        }                                                                                                           \
-    }                                                                                                               \
+    uint8_t *const vd_base = V(vd);                                                                                 \
+    uint8_t *const vs2_base = V(vs2);                                                                               \
+    SWITCH_NARROW_EEW(eew,                                                                                        \
+        FOR_EACH_ELEMENT(ei,                                                                                        \
+            ((wtype *)vd_base)[ei] = OP((wtype)((etype *)vs2_base)[ei], (wtype)((etype)(stype)imm));                \
+        )                                                                                                           \
+    )                                                                                                               \
 }
 
 #define VOP_SIGNED_WVX(NAME, OP)                                                                        \
@@ -670,23 +624,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                        \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int16_t *)V(vd))[ei] = OP((int16_t)((int8_t *)V(vs2))[ei], (int16_t)((int8_t)imm));       \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP((int32_t)((int16_t *)V(vs2))[ei], (int32_t)((int16_t)imm));     \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP((int64_t)((int32_t *)V(vs2))[ei], (int64_t)((int32_t)imm));     \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((swtype *)vd_base)[ei] = OP((swtype)((stype *)vs2_base)[ei], (swtype)((stype)imm));        \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_UNSIGNED_WVX(NAME, OP)                                                                       \
@@ -696,23 +640,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
     }                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                            \
-        TEST_MASK(ei)                                                                                           \
-        switch (eew) {                                                                                          \
-        case 8:                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP((int16_t)((int8_t *)V(vs2))[ei], (uint16_t)((uint8_t)(int8_t)imm));     \
-            break;                                                                                              \
-        case 16:                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP((int32_t)((int16_t *)V(vs2))[ei], (uint32_t)((uint16_t)(int16_t)imm));  \
-            break;                                                                                              \
-        case 32:                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP((int64_t)((int32_t *)V(vs2))[ei], (uint64_t)((uint32_t)(int32_t)imm));  \
-            break;                                                                                              \
-        default:                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                               \
-            break;                                                                                              \
-        }                                                                                                       \
-    }                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                    \
+            ((swtype *)vd_base)[ei] = OP((swtype)((stype *)vs2_base)[ei], (wtype)((etype)(stype)imm));          \
+        )                                                                                                       \
+    )                                                                                                           \
 }
 
 #define VOP_UNSIGNED_WVV(NAME, OP)                                                                                  \
@@ -722,23 +656,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                              \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                       \
     }                                                                                                               \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                \
-        TEST_MASK(ei)                                                                                               \
-        switch (eew) {                                                                                              \
-        case 8:                                                                                                     \
-            ((uint16_t *)V(vd))[ei] = OP((uint16_t)((uint8_t *)V(vs2))[ei], (uint16_t)((uint8_t *)V(vs1))[ei]);     \
-            break;                                                                                                  \
-        case 16:                                                                                                    \
-            ((uint32_t *)V(vd))[ei] = OP((uint32_t)((uint16_t *)V(vs2))[ei], (uint32_t)((uint16_t *)V(vs1))[ei]);   \
-            break;                                                                                                  \
-        case 32:                                                                                                    \
-            ((uint64_t *)V(vd))[ei] = OP((uint64_t)((uint32_t *)V(vs2))[ei], (uint64_t)((uint32_t *)V(vs1))[ei]);   \
-            break;                                                                                                  \
-        default:                                                                                                    \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
-            break;                                                                                                  \
-        }                                                                                                           \
-    }                                                                                                               \
+    uint8_t *const vd_base = V(vd);                                                                                 \
+    uint8_t *const vs2_base = V(vs2);                                                                               \
+    uint8_t *const vs1_base = V(vs1);                                                                               \
+    SWITCH_NARROW_EEW(eew,                                                                                        \
+        FOR_EACH_ELEMENT(ei,                                                                                        \
+            ((wtype *)vd_base)[ei] = OP((wtype)((etype *)vs2_base)[ei], (wtype)((etype *)vs1_base)[ei]);            \
+        )                                                                                                           \
+    )                                                                                                               \
 }
 
 #define VOP_SIGNED_WVV(NAME, OP)                                                                                \
@@ -748,23 +673,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                          \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
     }                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                            \
-        TEST_MASK(ei)                                                                                           \
-        switch (eew) {                                                                                          \
-        case 8:                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP((int16_t)((int8_t *)V(vs2))[ei], (int16_t)((int8_t *)V(vs1))[ei]);      \
-            break;                                                                                              \
-        case 16:                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP((int32_t)((int16_t *)V(vs2))[ei], (int32_t)((int16_t *)V(vs1))[ei]);    \
-            break;                                                                                              \
-        case 32:                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP((int64_t)((int32_t *)V(vs2))[ei], (int64_t)((int32_t *)V(vs1))[ei]);    \
-            break;                                                                                              \
-        default:                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                               \
-            break;                                                                                              \
-        }                                                                                                       \
-    }                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                           \
+    uint8_t *const vs1_base = V(vs1);                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                    \
+            ((swtype *)vd_base)[ei] = OP((swtype)((stype *)vs2_base)[ei], (swtype)((stype *)vs1_base)[ei]);     \
+        )                                                                                                       \
+    )                                                                                                           \
 }
 
 #define VOP_SIGNED_UNSIGNED_WVV(NAME, OP)                                                                       \
@@ -774,23 +690,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                          \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
     }                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                            \
-        TEST_MASK(ei)                                                                                           \
-        switch (eew) {                                                                                          \
-        case 8:                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP((int16_t)((int8_t *)V(vs2))[ei], (uint16_t)((uint8_t *)V(vs1))[ei]);    \
-            break;                                                                                              \
-        case 16:                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP((int32_t)((int16_t *)V(vs2))[ei], (uint32_t)((uint16_t *)V(vs1))[ei]);  \
-            break;                                                                                              \
-        case 32:                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP((int64_t)((int32_t *)V(vs2))[ei], (uint64_t)((uint32_t *)V(vs1))[ei]);  \
-            break;                                                                                              \
-        default:                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                               \
-            break;                                                                                              \
-        }                                                                                                       \
-    }                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                           \
+    uint8_t *const vs1_base = V(vs1);                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                    \
+            ((swtype *)vd_base)[ei] = OP((swtype)((stype *)vs2_base)[ei], (wtype)((etype *)vs1_base)[ei]);      \
+        )                                                                                                       \
+    )                                                                                                           \
 }
 
 #define VOP_UNSIGNED_WWX(NAME, OP)                                                                      \
@@ -800,23 +707,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID_EEW(vs2, eew << 1)) {                          \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], (uint8_t)((int8_t)imm));             \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], (uint16_t)((int16_t)imm));           \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], (uint32_t)((int32_t)imm));           \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((wtype *)vd_base)[ei] = OP(((wtype *)vs2_base)[ei], (etype)((stype)imm));                  \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_WWX(NAME, OP)                                                                        \
@@ -826,23 +723,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID_EEW(vs2, eew << 1)) {                          \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], (int8_t)(imm));                        \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], (int16_t)(imm));                       \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], (int32_t)(imm));                       \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vs2_base)[ei], (stype)(imm));                       \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_UNSIGNED_WWV(NAME, OP)                                                                          \
@@ -852,23 +739,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID_EEW(vs2, eew << 1) || V_IDX_INVALID(vs1)) {        \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                               \
     }                                                                                                       \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                        \
-        TEST_MASK(ei)                                                                                       \
-        switch (eew) {                                                                                      \
-        case 8:                                                                                             \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], (uint16_t)((uint8_t *)V(vs1))[ei]);      \
-            break;                                                                                          \
-        case 16:                                                                                            \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], (uint32_t)((uint16_t *)V(vs1))[ei]);     \
-            break;                                                                                          \
-        case 32:                                                                                            \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], (uint64_t)((uint32_t *)V(vs1))[ei]);     \
-            break;                                                                                          \
-        default:                                                                                            \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
-            break;                                                                                          \
-        }                                                                                                   \
-    }                                                                                                       \
+    uint8_t *const vd_base = V(vd);                                                                         \
+    uint8_t *const vs2_base = V(vs2);                                                                       \
+    uint8_t *const vs1_base = V(vs1);                                                                       \
+    SWITCH_NARROW_EEW(eew,                                                                                \
+        FOR_EACH_ELEMENT(ei,                                                                                \
+            ((wtype *)vd_base)[ei] = OP(((wtype *)vs2_base)[ei], (wtype)((etype *)vs1_base)[ei]);           \
+        )                                                                                                   \
+    )                                                                                                       \
 }
 
 #define VOP_SIGNED_WWV(NAME, OP)                                                                        \
@@ -878,23 +756,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID_EEW(vs2, eew << 1) || V_IDX_INVALID(vs1)) {    \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], (int16_t)((int8_t *)V(vs1))[ei]);      \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], (int32_t)((int16_t *)V(vs1))[ei]);     \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], (int64_t)((int32_t *)V(vs1))[ei]);     \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vs2_base)[ei], (swtype)((stype *)vs1_base)[ei]);    \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_UNSIGNED_VWX(NAME, OP)                                                                      \
@@ -904,23 +773,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID_EEW(vs2, eew << 1)) {                                        \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((uint8_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], (uint16_t)((uint8_t)(int8_t)imm));    \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((uint16_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], (uint32_t)((uint16_t)(int16_t)imm)); \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((uint32_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], (uint64_t)((uint32_t)(int32_t)imm)); \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((etype *)vd_base)[ei] = OP(((wtype *)vs2_base)[ei], (wtype)((etype)(stype)imm));           \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_VWX(NAME, OP)                                                                        \
@@ -930,23 +789,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID_EEW(vs2, eew << 1)) {                                        \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], (int16_t)(imm));                        \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], (int32_t)(imm));                       \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], (int64_t)(imm));                       \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((swtype *)vs2_base)[ei], (swtype)(imm));                       \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_UNSIGNED_VWV(NAME, OP)                                                                      \
@@ -956,23 +805,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID_EEW(vs2, eew << 1) || V_IDX_INVALID(vs1)) {                  \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((uint8_t *)V(vd))[ei] = OP(((uint16_t *)V(vs2))[ei], (uint16_t)((uint8_t *)V(vs1))[ei]);   \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((uint16_t *)V(vd))[ei] = OP(((uint32_t *)V(vs2))[ei], (uint32_t)((uint16_t *)V(vs1))[ei]); \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((uint32_t *)V(vd))[ei] = OP(((uint64_t *)V(vs2))[ei], (uint64_t)((uint32_t *)V(vs1))[ei]); \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((etype *)vd_base)[ei] = OP(((wtype *)vs2_base)[ei], (wtype)((etype *)vs1_base)[ei]);       \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VOP_SIGNED_VWV(NAME, OP)                                                                        \
@@ -982,44 +822,48 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID_EEW(vs2, eew << 1) || V_IDX_INVALID(vs1)) {                  \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                    \
-        TEST_MASK(ei)                                                                                   \
-        switch (eew) {                                                                                  \
-        case 8:                                                                                         \
-            ((int8_t *)V(vd))[ei] = OP(((int16_t *)V(vs2))[ei], (int16_t)((int8_t *)V(vs1))[ei]);       \
-            break;                                                                                      \
-        case 16:                                                                                        \
-            ((int16_t *)V(vd))[ei] = OP(((int32_t *)V(vs2))[ei], (int32_t)((int16_t *)V(vs1))[ei]);     \
-            break;                                                                                      \
-        case 32:                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int64_t *)V(vs2))[ei], (int64_t)((int32_t *)V(vs1))[ei]);     \
-            break;                                                                                      \
-        default:                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                       \
-            break;                                                                                      \
-        }                                                                                               \
-    }                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                            \
+            ((stype *)vd_base)[ei] = OP(((swtype *)vs2_base)[ei], (swtype)((stype *)vs1_base)[ei]);     \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
-#define MS_VL_MASK ((env->vl - ei > 0x7) ? 0 : (0xff << (env->vl & 0x7)))
 #ifdef MASKED
-#define MS_MASK() (MS_VL_MASK | ~V(0)[(ei >> 3)])
-#define MS_TEST_MASK() (~mask & (1 << (ei & 0x7)))
+#define VMOP_ACTIVE_ELEMENTS(byte) (V(0)[(byte)])
 #else
-#define MS_MASK() MS_VL_MASK
-#define MS_TEST_MASK() (true)
+#define VMOP_ACTIVE_ELEMENTS(byte) (0xff)
 #endif
 
-#define VMOP_LOOP_PREFIX()  \
-    if (!(ei & 0x7)) {      \
-        mask = MS_MASK();   \
-    }
-#define VMOP_LOOP_SUFFIX()                              \
-    if (!((ei + 1) & 0x7) || (ei + 1) >= env->vl) {     \
-        V(vd)[(ei >> 3)] &= mask;                       \
-        V(vd)[(ei >> 3)] |= value;                      \
-        value = 0;                                      \
-    }
+// Computes the mask bit of every active element and merges the results into vd one byte at a time.
+// Like in FOR_EACH_ELEMENT, the mask is tested per v0 byte: inactive bytes skip their 8 elements
+// and fully active bytes run them without a per-element mask branch.
+#define VMOP_FOR_EACH_ELEMENT(ei, ...)                                                          \
+{                                                                                               \
+    const int ei##_vl = env->vl;                                                                \
+    for (int ei##_start = 0; ei##_start < ei##_vl; ei##_start += 8) {                           \
+        const int ei##_end = ei##_vl - ei##_start > 8 ? ei##_start + 8 : ei##_vl;               \
+        /* the bits of the elements past vl are kept */                                         \
+        const uint8_t ei##_active = VMOP_ACTIVE_ELEMENTS(ei##_start >> 3) &                     \
+                                    (uint8_t)~(0xff << (ei##_end - ei##_start));                \
+        uint8_t value = 0;                                                                      \
+        if (ei##_active == 0xff) {                                                              \
+            for (int ei = ei##_start; ei < ei##_end; ++ei) {                                    \
+                __VA_ARGS__                                                                     \
+            }                                                                                   \
+        } else if (ei##_active != 0) {                                                          \
+            for (int ei = ei##_start; ei < ei##_end; ++ei) {                                    \
+                if (ei##_active & (1 << (ei & 0x7))) {                                          \
+                    __VA_ARGS__                                                                 \
+                }                                                                               \
+            }                                                                                   \
+        }                                                                                       \
+        V(vd)[ei##_start >> 3] = (V(vd)[ei##_start >> 3] & ~ei##_active) | value;               \
+    }                                                                                           \
+}
 
 
 #define VMOP_UNSIGNED_VX(NAME, OP)                                                                      \
@@ -1029,30 +873,12 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, 8) || V_IDX_INVALID(vs2)) {                                               \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    uint8_t mask = 0, value = 0;                                                                        \
-    for (int ei = 0; ei < env->vl; ++ei) {                                                              \
-        VMOP_LOOP_PREFIX();                                                                             \
-        if(MS_TEST_MASK()) {                                                                            \
-          switch (eew) {                                                                                \
-            case 8:                                                                                     \
-                value |= OP(((uint8_t *)V(vs2))[ei], ((uint8_t)imm)) << (ei & 0x7);                     \
-                break;                                                                                  \
-            case 16:                                                                                    \
-                value |= OP(((uint16_t *)V(vs2))[ei], ((uint16_t)imm)) << (ei & 0x7);                   \
-                break;                                                                                  \
-            case 32:                                                                                    \
-                value |= OP(((uint32_t *)V(vs2))[ei], ((uint32_t)imm)) << (ei & 0x7);                   \
-                break;                                                                                  \
-            case 64:                                                                                    \
-                value |= OP(((uint64_t *)V(vs2))[ei], ((uint64_t)imm)) << (ei & 0x7);                   \
-                break;                                                                                  \
-            default:                                                                                    \
-                raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                   \
-                break;                                                                                  \
-            }                                                                                           \
-        }                                                                                               \
-        VMOP_LOOP_SUFFIX();                                                                             \
-    }                                                                                                   \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        VMOP_FOR_EACH_ELEMENT(ei,                                                                       \
+            value |= OP(((etype *)vs2_base)[ei], ((etype)imm)) << (ei & 0x7);                           \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VMOP_SIGNED_VX(NAME, OP)                                                                        \
@@ -1062,30 +888,12 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, 8) || V_IDX_INVALID(vs2)) {                                               \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    uint8_t mask = 0, value = 0;                                                                        \
-    for (int ei = 0; ei < env->vl; ++ei) {                                                              \
-        VMOP_LOOP_PREFIX();                                                                             \
-        if(MS_TEST_MASK()) {                                                                            \
-            switch (eew) {                                                                              \
-            case 8:                                                                                     \
-                value |= OP(((int8_t *)V(vs2))[ei], ((int8_t)imm)) << (ei & 0x7);                       \
-                break;                                                                                  \
-            case 16:                                                                                    \
-                value |= OP(((int16_t *)V(vs2))[ei], ((int16_t)imm)) << (ei & 0x7);                     \
-                break;                                                                                  \
-            case 32:                                                                                    \
-                value |= OP(((int32_t *)V(vs2))[ei], ((int32_t)imm)) << (ei & 0x7);                     \
-                break;                                                                                  \
-            case 64:                                                                                    \
-                value |= OP(((int64_t *)V(vs2))[ei], ((int64_t)imm)) << (ei & 0x7);                     \
-                break;                                                                                  \
-            default:                                                                                    \
-                raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                   \
-                break;                                                                                  \
-            }                                                                                           \
-        }                                                                                               \
-        VMOP_LOOP_SUFFIX();                                                                             \
-    }                                                                                                   \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        VMOP_FOR_EACH_ELEMENT(ei,                                                                       \
+            value |= OP(((stype *)vs2_base)[ei], ((stype)imm)) << (ei & 0x7);                           \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VMOP_UNSIGNED_VV(NAME, OP)                                                                      \
@@ -1095,30 +903,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, 8) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                         \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    uint8_t mask = 0, value = 0;                                                                        \
-    for (int ei = 0; ei < env->vl; ++ei) {                                                              \
-        VMOP_LOOP_PREFIX();                                                                             \
-        if(MS_TEST_MASK()) {                                                                            \
-            switch (eew) {                                                                              \
-            case 8:                                                                                     \
-                value |= OP(((uint8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei]) << (ei & 0x7);            \
-                break;                                                                                  \
-            case 16:                                                                                    \
-                value |= OP(((uint16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei]) << (ei & 0x7);          \
-                break;                                                                                  \
-            case 32:                                                                                    \
-                value |= OP(((uint32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei]) << (ei & 0x7);          \
-                break;                                                                                  \
-            case 64:                                                                                    \
-                value |= OP(((uint64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei]) << (ei & 0x7);          \
-                break;                                                                                  \
-            default:                                                                                    \
-                raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                   \
-                break;                                                                                  \
-            }                                                                                           \
-        }                                                                                               \
-        VMOP_LOOP_SUFFIX();                                                                             \
-    }                                                                                                   \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        VMOP_FOR_EACH_ELEMENT(ei,                                                                       \
+            value |= OP(((etype *)vs2_base)[ei], ((etype *)vs1_base)[ei]) << (ei & 0x7);                \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define VMOP_SIGNED_VV(NAME, OP)                                                                        \
@@ -1128,30 +919,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, 8) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                         \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
     }                                                                                                   \
-    uint8_t mask = 0, value = 0;                                                                        \
-    for (int ei = 0; ei < env->vl; ++ei) {                                                              \
-        VMOP_LOOP_PREFIX();                                                                             \
-        if(MS_TEST_MASK()) {                                                                            \
-            switch (eew) {                                                                              \
-            case 8:                                                                                     \
-                value |= OP(((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei]) << (ei & 0x7);              \
-                break;                                                                                  \
-            case 16:                                                                                    \
-                value |= OP(((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei]) << (ei & 0x7);            \
-                break;                                                                                  \
-            case 32:                                                                                    \
-                value |= OP(((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei]) << (ei & 0x7);            \
-                break;                                                                                  \
-            case 64:                                                                                    \
-                value |= OP(((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei]) << (ei & 0x7);            \
-                break;                                                                                  \
-            default:                                                                                    \
-                raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                   \
-                break;                                                                                  \
-            }                                                                                           \
-        }                                                                                               \
-        VMOP_LOOP_SUFFIX();                                                                             \
-    }                                                                                                   \
+    uint8_t *const vs2_base = V(vs2);                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                   \
+    SWITCH_EEW(eew,                                                                                   \
+        VMOP_FOR_EACH_ELEMENT(ei,                                                                       \
+            value |= OP(((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei]) << (ei & 0x7);                \
+        )                                                                                               \
+    )                                                                                                   \
 }
 
 #define V3OP_SIGNED_VVX(NAME, OP)                                                                           \
@@ -1161,26 +935,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2)) {                                                          \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                               \
     }                                                                                                       \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                        \
-        TEST_MASK(ei)                                                                                       \
-        switch (eew) {                                                                                      \
-        case 8:                                                                                             \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vd))[ei], ((int8_t *)V(vs2))[ei], ((int8_t)imm));       \
-            break;                                                                                          \
-        case 16:                                                                                            \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], ((int16_t *)V(vs2))[ei], ((int16_t)imm));   \
-            break;                                                                                          \
-        case 32:                                                                                            \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], ((int32_t *)V(vs2))[ei], ((int32_t)imm));   \
-            break;                                                                                          \
-        case 64:                                                                                            \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], ((int64_t *)V(vs2))[ei], ((int64_t)imm));   \
-            break;                                                                                          \
-        default:                                                                                            \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                           \
-            break;                                                                                          \
-        }                                                                                                   \
-    }                                                                                                       \
+    uint8_t *const vd_base = V(vd);                                                                         \
+    uint8_t *const vs2_base = V(vs2);                                                                       \
+    SWITCH_EEW(eew,                                                                                       \
+        FOR_EACH_ELEMENT(ei,                                                                                \
+            ((stype *)vd_base)[ei] = OP(((stype *)vd_base)[ei], ((stype *)vs2_base)[ei], ((stype)imm));     \
+        )                                                                                                   \
+    )                                                                                                       \
 }
 
 #define V3OP_SIGNED_VVV(NAME, OP)                                                                                   \
@@ -1190,26 +951,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID(vd) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                            \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                       \
     }                                                                                                               \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                \
-        TEST_MASK(ei)                                                                                               \
-        switch (eew) {                                                                                              \
-        case 8:                                                                                                     \
-            ((int8_t *)V(vd))[ei] = OP(((int8_t *)V(vd))[ei], ((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei]);      \
-            break;                                                                                                  \
-        case 16:                                                                                                    \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], ((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei]);  \
-            break;                                                                                                  \
-        case 32:                                                                                                    \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], ((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei]);  \
-            break;                                                                                                  \
-        case 64:                                                                                                    \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], ((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei]);  \
-            break;                                                                                                  \
-        default:                                                                                                    \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                   \
-            break;                                                                                                  \
-        }                                                                                                           \
-    }                                                                                                               \
+    uint8_t *const vd_base = V(vd);                                                                                 \
+    uint8_t *const vs2_base = V(vs2);                                                                               \
+    uint8_t *const vs1_base = V(vs1);                                                                               \
+    SWITCH_EEW(eew,                                                                                               \
+        FOR_EACH_ELEMENT(ei,                                                                                        \
+            ((stype *)vd_base)[ei] = OP(((stype *)vd_base)[ei], ((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei]);  \
+        )                                                                                                           \
+    )                                                                                                               \
 }
 
 #define V3OP_UNSIGNED_WVX(NAME, OP)                                                                                                 \
@@ -1219,23 +968,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                                    \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                       \
     }                                                                                                                               \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                                \
-        TEST_MASK(ei)                                                                                                               \
-        switch (eew) {                                                                                                              \
-        case 8:                                                                                                                     \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vd))[ei], (uint16_t)((uint8_t *)V(vs2))[ei], (uint16_t)((uint8_t)imm));     \
-            break;                                                                                                                  \
-        case 16:                                                                                                                    \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vd))[ei], (uint32_t)((uint16_t *)V(vs2))[ei], (uint32_t)((uint16_t)imm));   \
-            break;                                                                                                                  \
-        case 32:                                                                                                                    \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vd))[ei], (uint64_t)((uint32_t *)V(vs2))[ei], (uint64_t)((uint32_t)imm));   \
-            break;                                                                                                                  \
-        default:                                                                                                                    \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                   \
-            break;                                                                                                                  \
-        }                                                                                                                           \
-    }                                                                                                                               \
+    uint8_t *const vd_base = V(vd);                                                                                                 \
+    uint8_t *const vs2_base = V(vs2);                                                                                               \
+    SWITCH_NARROW_EEW(eew,                                                                                                        \
+        FOR_EACH_ELEMENT(ei,                                                                                                        \
+            ((wtype *)vd_base)[ei] = OP(((wtype *)vd_base)[ei], (wtype)((etype *)vs2_base)[ei], (wtype)((etype)imm));               \
+        )                                                                                                                           \
+    )                                                                                                                               \
 }
 
 #define V3OP_SIGNED_WVX(NAME, OP)                                                                                               \
@@ -1245,23 +984,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                   \
     }                                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                            \
-        TEST_MASK(ei)                                                                                                           \
-        switch (eew) {                                                                                                          \
-        case 8:                                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], (int16_t)((int8_t *)V(vs2))[ei], (int16_t)((int8_t)imm));       \
-            break;                                                                                                              \
-        case 16:                                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], (int32_t)((int16_t *)V(vs2))[ei], (int32_t)((int16_t)imm));     \
-            break;                                                                                                              \
-        case 32:                                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], (int64_t)((int32_t *)V(vs2))[ei], (int64_t)((int32_t)imm));     \
-            break;                                                                                                              \
-        default:                                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                               \
-            break;                                                                                                              \
-        }                                                                                                                       \
-    }                                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                                    \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vd_base)[ei], (swtype)((stype *)vs2_base)[ei], (swtype)((stype)imm));       \
+        )                                                                                                                       \
+    )                                                                                                                           \
 }
 
 #define V3OP_UNSIGNED_SIGNED_WVX(NAME, OP)                                                                                      \
@@ -1271,23 +1000,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                   \
     }                                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                            \
-        TEST_MASK(ei)                                                                                                           \
-        switch (eew) {                                                                                                          \
-        case 8:                                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], (uint16_t)((uint8_t *)V(vs2))[ei], (int16_t)((int8_t)imm));     \
-            break;                                                                                                              \
-        case 16:                                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], (uint32_t)((uint16_t *)V(vs2))[ei], (int32_t)((int16_t)imm));   \
-            break;                                                                                                              \
-        case 32:                                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], (uint64_t)((uint32_t *)V(vs2))[ei], (int64_t)((int32_t)imm));   \
-            break;                                                                                                              \
-        default:                                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                               \
-            break;                                                                                                              \
-        }                                                                                                                       \
-    }                                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                                    \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vd_base)[ei], (wtype)((etype *)vs2_base)[ei], (swtype)((stype)imm));        \
+        )                                                                                                                       \
+    )                                                                                                                           \
 }
 
 #define V3OP_SIGNED_UNSIGNED_WVX(NAME, OP)                                                                                      \
@@ -1297,23 +1016,13 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2)) {                                                                \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                   \
     }                                                                                                                           \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                            \
-        TEST_MASK(ei)                                                                                                           \
-        switch (eew) {                                                                                                          \
-        case 8:                                                                                                                 \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], (int16_t)((int8_t *)V(vs2))[ei], (uint16_t)((uint8_t)imm));     \
-            break;                                                                                                              \
-        case 16:                                                                                                                \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], (int32_t)((int16_t *)V(vs2))[ei], (uint32_t)((uint16_t)imm));   \
-            break;                                                                                                              \
-        case 32:                                                                                                                \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], (int64_t)((int32_t *)V(vs2))[ei], (uint64_t)((uint32_t)imm));   \
-            break;                                                                                                              \
-        default:                                                                                                                \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                               \
-            break;                                                                                                              \
-        }                                                                                                                       \
-    }                                                                                                                           \
+    uint8_t *const vd_base = V(vd);                                                                                             \
+    uint8_t *const vs2_base = V(vs2);                                                                                           \
+    SWITCH_NARROW_EEW(eew,                                                                                                    \
+        FOR_EACH_ELEMENT(ei,                                                                                                    \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vd_base)[ei], (swtype)((stype *)vs2_base)[ei], (wtype)((etype)imm));        \
+        )                                                                                                                       \
+    )                                                                                                                           \
 }
 
 #define V3OP_UNSIGNED_WVV(NAME, OP)                                                                                                         \
@@ -1323,23 +1032,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                                      \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                               \
     }                                                                                                                                       \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                                        \
-        TEST_MASK(ei)                                                                                                                       \
-        switch (eew) {                                                                                                                      \
-        case 8:                                                                                                                             \
-            ((uint16_t *)V(vd))[ei] = OP(((uint16_t *)V(vd))[ei], (uint16_t)((uint8_t *)V(vs2))[ei], (uint16_t)((uint8_t *)V(vs1))[ei]);    \
-            break;                                                                                                                          \
-        case 16:                                                                                                                            \
-            ((uint32_t *)V(vd))[ei] = OP(((uint32_t *)V(vd))[ei], (uint32_t)((uint16_t *)V(vs2))[ei], (uint32_t)((uint16_t *)V(vs1))[ei]);  \
-            break;                                                                                                                          \
-        case 32:                                                                                                                            \
-            ((uint64_t *)V(vd))[ei] = OP(((uint64_t *)V(vd))[ei], (uint64_t)((uint32_t *)V(vs2))[ei], (uint64_t)((uint32_t *)V(vs1))[ei]);  \
-            break;                                                                                                                          \
-        default:                                                                                                                            \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                           \
-            break;                                                                                                                          \
-        }                                                                                                                                   \
-    }                                                                                                                                       \
+    uint8_t *const vd_base = V(vd);                                                                                                         \
+    uint8_t *const vs2_base = V(vs2);                                                                                                       \
+    uint8_t *const vs1_base = V(vs1);                                                                                                       \
+    SWITCH_NARROW_EEW(eew,                                                                                                                \
+        FOR_EACH_ELEMENT(ei,                                                                                                                \
+            ((wtype *)vd_base)[ei] = OP(((wtype *)vd_base)[ei], (wtype)((etype *)vs2_base)[ei], (wtype)((etype *)vs1_base)[ei]);            \
+        )                                                                                                                                   \
+    )                                                                                                                                       \
 }
 
 #define V3OP_SIGNED_WVV(NAME, OP)                                                                                                       \
@@ -1349,23 +1049,14 @@ void glue(glue(helper_, NAME), POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
     if (V_IDX_INVALID_EEW(vd, eew << 1) || V_IDX_INVALID(vs2) || V_IDX_INVALID(vs1)) {                                                  \
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                           \
     }                                                                                                                                   \
-    for (int ei = env->vstart; ei < env->vl; ++ei) {                                                                                    \
-        TEST_MASK(ei)                                                                                                                   \
-        switch (eew) {                                                                                                                  \
-        case 8:                                                                                                                         \
-            ((int16_t *)V(vd))[ei] = OP(((int16_t *)V(vd))[ei], (int16_t)((int8_t *)V(vs2))[ei], (int16_t)((int8_t *)V(vs1))[ei]);      \
-            break;                                                                                                                      \
-        case 16:                                                                                                                        \
-            ((int32_t *)V(vd))[ei] = OP(((int32_t *)V(vd))[ei], (int32_t)((int16_t *)V(vs2))[ei], (int32_t)((int16_t *)V(vs1))[ei]);    \
-            break;                                                                                                                      \
-        case 32:                                                                                                                        \
-            ((int64_t *)V(vd))[ei] = OP(((int64_t *)V(vd))[ei], (int64_t)((int32_t *)V(vs2))[ei], (int64_t)((int32_t *)V(vs1))[ei]);    \
-            break;                                                                                                                      \
-        default:                                                                                                                        \
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);                                                                       \
-            break;                                                                                                                      \
-        }                                                                                                                               \
-    }                                                                                                                                   \
+    uint8_t *const vd_base = V(vd);                                                                                                     \
+    uint8_t *const vs2_base = V(vs2);                                                                                                   \
+    uint8_t *const vs1_base = V(vs1);                                                                                                   \
+    SWITCH_NARROW_EEW(eew,                                                                                                            \
+        FOR_EACH_ELEMENT(ei,                                                                                                            \
+            ((swtype *)vd_base)[ei] = OP(((swtype *)vd_base)[ei], (swtype)((stype *)vs2_base)[ei], (swtype)((stype *)vs1_base)[ei]);    \
+        )                                                                                                                               \
+    )                                                                                                                                   \
 }
 
 #define V3OP_UNSIGNED_SIGNED_WVV(NAME, OP)                                                                                              \
@@ -1793,23 +1484,12 @@ void glue(helper_vwredsumu_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2
         return;
     }
     uint64_t acc = 0;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            acc += ((uint8_t *)V(vs2))[ei];
-            break;
-        case 16:
-            acc += ((uint16_t *)V(vs2))[ei];
-            break;
-        case 32:
-            acc += ((uint32_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            acc += ((etype *)vs2_base)[ei];
+        )
+    )
     switch (eew) {
     case 8:
         WR_V16(vd, 0, (acc + V16(vs1,0)));
@@ -1837,23 +1517,12 @@ void glue(helper_vwredsum_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2,
         return;
     }
     int64_t acc = 0;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            acc += ((int8_t *)V(vs2))[ei];
-            break;
-        case 16:
-            acc += ((int16_t *)V(vs2))[ei];
-            break;
-        case 32:
-            acc += ((int32_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            acc += ((stype *)vs2_base)[ei];
+        )
+    )
     switch (eew) {
      case 8:
         WR_V16(vd, 0, (acc + V16(vs1,0)));
@@ -1878,23 +1547,14 @@ void glue(helper_vnclipu_ivv, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2,
     }
     const uint16_t v1_mask = (eew << 1) - 1;
     const uint8_t rm = env->vxrm & 0b11;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = clipto_u8(roundoff_u16(((uint16_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = clipto_u16(roundoff_u32(((uint32_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = clipto_u32(roundoff_u64(((uint64_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(clipto_u, etype)(EEW_HELPER(roundoff_u, wtype)(((wtype *)vs2_base)[ei], ((etype *)vs1_base)[ei] & v1_mask, rm));
+        )
+    )
 }
 
 void glue(helper_vnclipu_ivi, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2, target_ulong rs1)
@@ -1905,23 +1565,13 @@ void glue(helper_vnclipu_ivi, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2,
     }
     const uint16_t shift = rs1 & ((eew << 1) - 1);
     const uint8_t rm = env->vxrm & 0b11;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = clipto_u8(roundoff_u16(((uint16_t *)V(vs2))[ei], shift, rm));
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = clipto_u16(roundoff_u32(((uint32_t *)V(vs2))[ei], shift, rm));
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = clipto_u32(roundoff_u64(((uint64_t *)V(vs2))[ei], shift, rm));
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(clipto_u, etype)(EEW_HELPER(roundoff_u, wtype)(((wtype *)vs2_base)[ei], shift, rm));
+        )
+    )
 }
 
 void glue(helper_vnclip_ivv, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2, uint32_t vs1)
@@ -1932,23 +1582,14 @@ void glue(helper_vnclip_ivv, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2,
     }
     const uint16_t v1_mask = (eew << 1) - 1;
     const uint8_t rm = env->vxrm & 0b11;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = clipto_i8(roundoff_i16(((int16_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = clipto_i16(roundoff_i32(((int32_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = clipto_i32(roundoff_i64(((int64_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei] & v1_mask, rm));
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(clipto_i, etype)(EEW_HELPER(roundoff_i, wtype)(((swtype *)vs2_base)[ei], ((etype *)vs1_base)[ei] & v1_mask, rm));
+        )
+    )
 }
 
 void glue(helper_vnclip_ivi, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2, target_ulong rs1)
@@ -1959,23 +1600,13 @@ void glue(helper_vnclip_ivi, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2,
     }
     const uint16_t shift = rs1 & ((eew << 1) - 1);
     const uint8_t rm = env->vxrm & 0b11;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = clipto_i8(roundoff_i16(((int16_t *)V(vs2))[ei], shift, rm));
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = clipto_i16(roundoff_i32(((int32_t *)V(vs2))[ei], shift, rm));
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = clipto_i32(roundoff_i64(((int64_t *)V(vs2))[ei], shift, rm));
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(clipto_i, etype)(EEW_HELPER(roundoff_i, wtype)(((swtype *)vs2_base)[ei], shift, rm));
+        )
+    )
 }
 
 void glue(helper_vslideup_ivi, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_ulong rs1)
@@ -2174,26 +1805,13 @@ void glue(helper_vrgather_ivi, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = imm >= env->vlmax ? 0 : ((int8_t *)V(vs2))[imm];
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = imm >= env->vlmax ? 0 : ((int16_t *)V(vs2))[imm];
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = imm >= env->vlmax ? 0 : ((int32_t *)V(vs2))[imm];
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = imm >= env->vlmax ? 0 : ((int64_t *)V(vs2))[imm];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = imm >= env->vlmax ? 0 : ((stype *)vs2_base)[imm];
+        )
+    )
 }
 
 void glue(helper_vrgatherei16_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -2233,23 +1851,13 @@ void glue(helper_vzext_vf2, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 16:
-            ((uint16_t *)V(vd))[ei] = ((uint8_t *)V(vs2))[ei];
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = ((uint16_t *)V(vs2))[ei];
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = ((uint32_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew >> 1,
+        FOR_EACH_ELEMENT(ei,
+            ((wtype *)vd_base)[ei] = ((etype *)vs2_base)[ei];
+        )
+    )
 }
 
 void glue(helper_vsext_vf2, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
@@ -2259,23 +1867,13 @@ void glue(helper_vsext_vf2, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 16:
-            ((int16_t *)V(vd))[ei] = ((int8_t *)V(vs2))[ei];
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = ((int16_t *)V(vs2))[ei];
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = ((int32_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_NARROW_EEW(eew >> 1,
+        FOR_EACH_ELEMENT(ei,
+            ((swtype *)vd_base)[ei] = ((stype *)vs2_base)[ei];
+        )
+    )
 }
 
 void glue(helper_vzext_vf4, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
@@ -2285,19 +1883,22 @@ void glue(helper_vzext_vf4, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 32:
-            ((uint32_t *)V(vd))[ei] = ((uint8_t *)V(vs2))[ei];
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = ((uint16_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    switch (eew) {
+    case 32:
+        FOR_EACH_ELEMENT(ei,
+            ((uint32_t *)vd_base)[ei] = ((uint8_t *)vs2_base)[ei];
+        )
+        break;
+    case 64:
+        FOR_EACH_ELEMENT(ei,
+            ((uint64_t *)vd_base)[ei] = ((uint16_t *)vs2_base)[ei];
+        )
+        break;
+    default:
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
+        break;
     }
 }
 
@@ -2308,19 +1909,22 @@ void glue(helper_vsext_vf4, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 32:
-            ((int32_t *)V(vd))[ei] = ((int8_t *)V(vs2))[ei];
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = ((int16_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    switch (eew) {
+    case 32:
+        FOR_EACH_ELEMENT(ei,
+            ((int32_t *)vd_base)[ei] = ((int8_t *)vs2_base)[ei];
+        )
+        break;
+    case 64:
+        FOR_EACH_ELEMENT(ei,
+            ((int64_t *)vd_base)[ei] = ((int16_t *)vs2_base)[ei];
+        )
+        break;
+    default:
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
+        break;
     }
 }
 
@@ -2331,16 +1935,17 @@ void glue(helper_vzext_vf8, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 64:
-            ((uint64_t *)V(vd))[ei] = ((uint8_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    switch (eew) {
+    case 64:
+        FOR_EACH_ELEMENT(ei,
+            ((uint64_t *)vd_base)[ei] = ((uint8_t *)vs2_base)[ei];
+        )
+        break;
+    default:
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
+        break;
     }
 }
 
@@ -2351,16 +1956,17 @@ void glue(helper_vsext_vf8, POSTFIX)(CPUState *env, uint32_t vd, uint32_t vs2)
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
 
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 64:
-            ((int64_t *)V(vd))[ei] = ((int8_t *)V(vs2))[ei];
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    switch (eew) {
+    case 64:
+        FOR_EACH_ELEMENT(ei,
+            ((int64_t *)vd_base)[ei] = ((int8_t *)vs2_base)[ei];
+        )
+        break;
+    default:
+        raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
+        break;
     }
 }
 
@@ -2370,26 +1976,14 @@ void glue(helper_vdivu_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, in
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = divu_8(((uint8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei]);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = divu_16(((uint16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei]);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = divu_32(((uint32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei]);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = divu_64(((uint64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei]);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(divu_, etype)(((etype *)vs2_base)[ei], ((etype *)vs1_base)[ei]);
+        )
+    )
 }
 
 void glue(helper_vdiv_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -2398,26 +1992,14 @@ void glue(helper_vdiv_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = div_8(((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei]);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = div_16(((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei]);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = div_32(((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei]);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = div_64(((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei]);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(div_, etype)(((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei]);
+        )
+    )
 }
 
 void glue(helper_vremu_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -2426,26 +2008,14 @@ void glue(helper_vremu_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, in
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = remu_8(((uint8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei]);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = remu_16(((uint16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei]);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = remu_32(((uint32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei]);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = remu_64(((uint64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei]);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(remu_, etype)(((etype *)vs2_base)[ei], ((etype *)vs1_base)[ei]);
+        )
+    )
 }
 
 void glue(helper_vrem_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -2454,26 +2024,14 @@ void glue(helper_vrem_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = rem_8(((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei]);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = rem_16(((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei]);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = rem_32(((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei]);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = rem_64(((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei]);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(rem_, etype)(((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei]);
+        )
+    )
 }
 
 void glue(helper_vdivu_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -2482,26 +2040,13 @@ void glue(helper_vdivu_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, ta
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = divu_8(((uint8_t *)V(vs2))[ei], (int8_t)rs1);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = divu_16(((uint16_t *)V(vs2))[ei], (int16_t)rs1);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = divu_32(((uint32_t *)V(vs2))[ei], (int32_t)rs1);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = divu_64(((uint64_t *)V(vs2))[ei], (int64_t)rs1);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(divu_, etype)(((etype *)vs2_base)[ei], (stype)rs1);
+        )
+    )
 }
 
 void glue(helper_vdiv_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -2510,26 +2055,13 @@ void glue(helper_vdiv_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, tar
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = div_8(((int8_t *)V(vs2))[ei], rs1);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = div_16(((int16_t *)V(vs2))[ei], rs1);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = div_32(((int32_t *)V(vs2))[ei], rs1);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = div_64(((int64_t *)V(vs2))[ei], rs1);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(div_, etype)(((stype *)vs2_base)[ei], rs1);
+        )
+    )
 }
 
 void glue(helper_vremu_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -2538,26 +2070,13 @@ void glue(helper_vremu_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, ta
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = remu_8(((uint8_t *)V(vs2))[ei], (int8_t)rs1);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = remu_16(((uint16_t *)V(vs2))[ei], (int16_t)rs1);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = remu_32(((uint32_t *)V(vs2))[ei], (int32_t)rs1);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = remu_64(((uint64_t *)V(vs2))[ei], (int64_t)rs1);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(remu_, etype)(((etype *)vs2_base)[ei], (stype)rs1);
+        )
+    )
 }
 
 void glue(helper_vrem_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_long rs1)
@@ -2566,26 +2085,13 @@ void glue(helper_vrem_mvx, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, tar
         raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
     }
     const target_ulong eew = env->vsew;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = rem_8(((int8_t *)V(vs2))[ei], rs1);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = rem_16(((int16_t *)V(vs2))[ei], rs1);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = rem_32(((int32_t *)V(vs2))[ei], rs1);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = rem_64(((int64_t *)V(vs2))[ei], rs1);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(rem_, etype)(((stype *)vs2_base)[ei], rs1);
+        )
+    )
 }
 
 void glue(helper_vaadd_mvv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -2988,26 +2494,14 @@ void glue(helper_vssrl_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, in
     const target_ulong eew = env->vsew;
     const uint8_t rm = env->vxrm & 0b11;
     const uint16_t mask = eew - 1;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = roundoff_u8(((uint8_t *)V(vs2))[ei], ((uint8_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = roundoff_u16(((uint16_t *)V(vs2))[ei], ((uint16_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = roundoff_u32(((uint32_t *)V(vs2))[ei], ((uint32_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = roundoff_u64(((uint64_t *)V(vs2))[ei], ((uint64_t *)V(vs1))[ei] & mask, rm);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(roundoff_u, etype)(((etype *)vs2_base)[ei], ((etype *)vs1_base)[ei] & mask, rm);
+        )
+    )
 }
 
 void glue(helper_vssrl_ivi, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_ulong rs1)
@@ -3018,26 +2512,13 @@ void glue(helper_vssrl_ivi, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, ta
     const target_ulong eew = env->vsew;
     const uint8_t rm = env->vxrm & 0b11;
     const uint16_t shift = rs1 & (eew - 1);
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((uint8_t *)V(vd))[ei] = roundoff_u8(((uint8_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 16:
-            ((uint16_t *)V(vd))[ei] = roundoff_u16(((uint16_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 32:
-            ((uint32_t *)V(vd))[ei] = roundoff_u32(((uint32_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 64:
-            ((uint64_t *)V(vd))[ei] = roundoff_u64(((uint64_t *)V(vs2))[ei], shift, rm);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((etype *)vd_base)[ei] = EEW_HELPER(roundoff_u, etype)(((etype *)vs2_base)[ei], shift, rm);
+        )
+    )
 }
 
 void glue(helper_vssra_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, int32_t vs1)
@@ -3048,26 +2529,14 @@ void glue(helper_vssra_ivv, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, in
     const target_ulong eew = env->vsew;
     const uint8_t rm = env->vxrm & 0b11;
     const uint16_t mask = eew - 1;
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = roundoff_i8(((int8_t *)V(vs2))[ei], ((int8_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = roundoff_i16(((int16_t *)V(vs2))[ei], ((int16_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = roundoff_i32(((int32_t *)V(vs2))[ei], ((int32_t *)V(vs1))[ei] & mask, rm);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = roundoff_i64(((int64_t *)V(vs2))[ei], ((int64_t *)V(vs1))[ei] & mask, rm);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    uint8_t *const vs1_base = V(vs1);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(roundoff_i, etype)(((stype *)vs2_base)[ei], ((stype *)vs1_base)[ei] & mask, rm);
+        )
+    )
 }
 
 void glue(helper_vssra_ivi, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, target_ulong rs1)
@@ -3078,26 +2547,13 @@ void glue(helper_vssra_ivi, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2, ta
     const target_ulong eew = env->vsew;
     const uint8_t rm = env->vxrm & 0b11;
     const uint16_t shift = rs1 & (eew - 1);
-    for (int ei = env->vstart; ei < env->vl; ++ei) {
-        TEST_MASK(ei)
-        switch (eew) {
-        case 8:
-            ((int8_t *)V(vd))[ei] = roundoff_i8(((int8_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 16:
-            ((int16_t *)V(vd))[ei] = roundoff_i16(((int16_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 32:
-            ((int32_t *)V(vd))[ei] = roundoff_i32(((int32_t *)V(vs2))[ei], shift, rm);
-            break;
-        case 64:
-            ((int64_t *)V(vd))[ei] = roundoff_i64(((int64_t *)V(vs2))[ei], shift, rm);
-            break;
-        default:
-            raise_exception_and_sync_pc(env, RISCV_EXCP_ILLEGAL_INST);
-            break;
-        }
-    }
+    uint8_t *const vd_base = V(vd);
+    uint8_t *const vs2_base = V(vs2);
+    SWITCH_EEW(eew,
+        FOR_EACH_ELEMENT(ei,
+            ((stype *)vd_base)[ei] = EEW_HELPER(roundoff_i, etype)(((stype *)vs2_base)[ei], shift, rm);
+        )
+    )
 }
 
 
@@ -3163,9 +2619,9 @@ void glue(helper_vid, POSTFIX)(CPUState *env, uint32_t vd, int32_t vs2)
 
 
 #undef TEST_MASK
-#undef MS_MASK
-#undef MS_TEST_MASK
-#undef VMOP_LOOP_PREFIX
+#undef FOR_EACH_ELEMENT
+#undef VMOP_ACTIVE_ELEMENTS
+#undef VMOP_FOR_EACH_ELEMENT
 
 #undef SHIFT
 #undef DATA_TYPE
@@ -61,7 +61,7 @@ target_ulong HELPER(ldstub)(uint32_t addr)
     uint8_t value = 0xFF;
 
     retaddr = GETPC();
-    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    page_index = CPU_TLB_INDEX(env, addr);
     mmu_idx = env->psrs;
     if (unlikely(env->tlb_table[mmu_idx][page_index].addr_write != (addr & (TARGET_PAGE_MASK)))) {
         /* the page is not in the TLB : fill it */
@@ -89,7 +89,7 @@ target_ulong HELPER(swap)(target_ulong value, uint32_t addr)
     uint32_t ret;
 
     retaddr = GETPC();
-    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    page_index = CPU_TLB_INDEX(env, addr);
     mmu_idx = env->psrs;
     if (unlikely(env->tlb_table[mmu_idx][page_index].addr_write != (addr & (TARGET_PAGE_MASK)))) {
         /* the page is not in the TLB : fill it */
@@ -38,6 +38,14 @@ extern CPUState *cpu;
 
 static int exit_no_hook_label;
 static int block_header_interrupted_label;
+static int block_header_slow_path_label;
+static int block_header_done_label;
+
+// `tb->icount` is known only once the whole block is translated, so the header uses constants
+// that are patched by `gen_block_footer`
+#define BLOCK_HEADER_ICOUNT_ARGS 3
+static TCGArg *block_header_icount_args[BLOCK_HEADER_ICOUNT_ARGS];
+static int block_header_icount_args_count;
 
 CPUBreakpoint *process_breakpoints(CPUState *env, target_ulong pc)
 {
@@ -50,16 +58,23 @@ CPUBreakpoint *process_breakpoints(CPUState *env, target_ulong pc)
     return NULL;
 }
 
-static inline void gen_update_instructions_count(TranslationBlock *tb)
+static inline TCGv_i32 gen_block_icount(void)
+{
+    TCGv_i32 icount = tcg_temp_new_i32();
+    tcg_gen_movi_i32(icount, 0);
+    block_header_icount_args[block_header_icount_args_count++] = gen_opparam_ptr - 1;
+    return icount;
+}
+
+static inline void gen_update_instructions_count(void)
 {
-    // Assumption: tb == cpu->current_tb when this block is executed
-    // This is ensured by the prepare_block_for_execution helper
     TCGv_i64 tmp = tcg_temp_new_i64();
     TCGv_i64 icount = tcg_temp_new_i64();
-    TCGv_ptr tb_pointer = tcg_const_ptr((tcg_target_long)tb);
+    TCGv_i32 icount_i32 = gen_block_icount();
 
     // (uint32_t) tb->icount
-    tcg_gen_ld32u_i64(icount, tb_pointer, offsetof(TranslationBlock, icount));
+    tcg_gen_extu_i32_i64(icount, icount_i32);
+    tcg_temp_free_i32(icount_i32);
 
     // (uint32_t) cpu->instructions_count_value += tb->icount
     tcg_gen_ld32u_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_value));
@@ -71,25 +86,146 @@ static inline void gen_update_instructions_count(TranslationBlock *tb)
     tcg_gen_add_i64(tmp, tmp, icount);
     tcg_gen_st_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_total_value));
 
-    // (uint32_t) tb->instructions_count_dirty = 1
-    tcg_gen_movi_i64(tmp, 1);
-    tcg_gen_st32_i64(tmp, tb_pointer, offsetof(TranslationBlock, instructions_count_dirty));
+    tcg_temp_free_i64(icount);
+    tcg_temp_free_i64(tmp);
+}
+
+// Superblock side exits: the header has accounted for the whole superblock,
+// so give back the instructions of the segments that are skipped
+static void gen_superblock_side_exit(TranslationBlock *tb, uint32_t executed_instructions)
+{
+    TCGv_i64 tmp = tcg_temp_new_i64();
+    TCGv_i64 skipped = tcg_temp_new_i64();
+    TCGv_ptr tb_pointer = tcg_const_ptr((tcg_target_long)tb);
+
+    // the final size of the superblock is not known yet, so it is read back from tb->icount
+    tcg_gen_ld32u_i64(skipped, tb_pointer, offsetof(TranslationBlock, icount));
+    tcg_gen_subi_i64(skipped, skipped, executed_instructions);
+
+    tcg_gen_ld32u_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_value));
+    tcg_gen_sub_i64(tmp, tmp, skipped);
+    tcg_gen_st32_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_value));
+
+    tcg_gen_ld_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_total_value));
+    tcg_gen_sub_i64(tmp, tmp, skipped);
+    tcg_gen_st_i64(tmp, cpu_env, offsetof(CPUState, instructions_count_total_value));
 
     tcg_temp_free_ptr(tb_pointer);
-    tcg_temp_free_i64(icount);
+    tcg_temp_free_i64(skipped);
     tcg_temp_free_i64(tmp);
 }
 
-static inline void gen_block_header(TranslationBlock *tb)
+static inline void gen_prepare_block_for_execution(TranslationBlock *tb)
 {
-    TCGv_i32 flag;
-    exit_no_hook_label = gen_new_label();
     TCGv_ptr tb_pointer = tcg_const_ptr((tcg_target_long)tb);
-    flag = tcg_temp_local_new_i32();
+    TCGv_i32 flag = tcg_temp_new_i32();
     gen_helper_prepare_block_for_execution(flag, tb_pointer);
-    tcg_temp_free_ptr(tb_pointer);
     tcg_gen_brcondi_i32(TCG_COND_NE, flag, 0, exit_no_hook_label);
     tcg_temp_free_i32(flag);
+    tcg_temp_free_ptr(tb_pointer);
+}
+
+// The common case of the `prepare_block_for_execution` checks is done inline; the helper is only called
+// (from the code generated by `gen_block_footer`) while the block is profiled or when it has to be trimmed
+static inline void gen_block_prologue_checks(TranslationBlock *tb)
+{
+    TCGv_ptr tb_pointer;
+    TCGv_ptr ptr;
+    TCGv_i32 tmp;
+    TCGv_i32 tmp2;
+    TCGv_i32 icount;
+
+    block_header_slow_path_label = gen_new_label();
+    block_header_done_label = gen_new_label();
+
+    // cpu->current_tb = tb
+    tb_pointer = tcg_const_ptr((tcg_target_long)tb);
+    tcg_gen_st_ptr(tb_pointer, cpu_env, offsetof(CPUState, current_tb));
+
+    // tb->exec_count <= block_profiling_limit
+    tmp = tcg_temp_new_i32();
+    tmp2 = tcg_temp_new_i32();
+    ptr = tcg_const_ptr((tcg_target_long)&block_profiling_limit);
+    tcg_gen_ld_i32(tmp, tb_pointer, offsetof(TranslationBlock, exec_count));
+    tcg_gen_ld_i32(tmp2, ptr, 0);
+    tcg_gen_brcond_i32(TCG_COND_LEU, tmp, tmp2, block_header_slow_path_label);
+    tcg_temp_free_ptr(ptr);
+    tcg_temp_free_ptr(tb_pointer);
+
+#ifdef SUPPORTS_SUPERBLOCKS
+    // cpu->previous_tb != NULL, the edge from a profiled block
+    ptr = tcg_temp_new_ptr();
+    tcg_gen_ld_ptr(ptr, cpu_env, offsetof(CPUState, previous_tb));
+    tcg_gen_brcondi_ptr(TCG_COND_NE, ptr, 0, block_header_slow_path_label);
+    tcg_temp_free_ptr(ptr);
+#endif
+
+    // cpu->exit_request != 0
+    tcg_gen_ld_i32(tmp, cpu_env, offsetof(CPUState, exit_request));
+    tcg_gen_brcondi_i32(TCG_COND_NE, tmp, 0, block_header_slow_path_label);
+
+    // cpu->instructions_count_limit - cpu->instructions_count_value < tb->icount
+    tcg_gen_ld_i32(tmp, cpu_env, offsetof(CPUState, instructions_count_limit));
+    tcg_gen_ld_i32(tmp2, cpu_env, offsetof(CPUState, instructions_count_value));
+    tcg_gen_sub_i32(tmp, tmp, tmp2);
+    icount = gen_block_icount();
+    tcg_gen_brcond_i32(TCG_COND_LTU, tmp, icount, block_header_slow_path_label);
+    tcg_temp_free_i32(icount);
+    tcg_temp_free_i32(tmp2);
+    tcg_temp_free_i32(tmp);
+
+    gen_set_label(block_header_done_label);
+}
+
+// Appends the block to `cpu->block_batch`, delivering the batch if this fills the buffer up
+static void gen_block_batch_append(TranslationBlock *tb)
+{
+    int no_flush_label = gen_new_label();
+    TCGv_ptr next = tcg_temp_new_ptr();
+    TCGv_ptr end = tcg_temp_new_ptr();
+    TCGv_i64 pc = tcg_const_i64(tb->pc);
+    TCGv_i32 icount = gen_block_icount();
+
+    tcg_gen_ld_ptr(next, cpu_env, offsetof(CPUState, block_batch_next));
+    tcg_gen_st_i64(pc, next, offsetof(ExecutedBlock, pc));
+    tcg_gen_st_i32(icount, next, offsetof(ExecutedBlock, instructions_count));
+    tcg_gen_addi_ptr(next, next, sizeof(ExecutedBlock));
+    tcg_gen_st_ptr(next, cpu_env, offsetof(CPUState, block_batch_next));
+    tcg_gen_ld_ptr(end, cpu_env, offsetof(CPUState, block_batch_end));
+    tcg_gen_brcond_ptr(TCG_COND_NE, next, end, no_flush_label);
+    tcg_temp_free_i32(icount);
+    tcg_temp_free_i64(pc);
+    tcg_temp_free_ptr(end);
+    tcg_temp_free_ptr(next);
+    gen_helper_flush_block_batch();
+    gen_set_label(no_flush_label);
+}
+
+// Bumps the execution counter of the statistics record, which is not read by the generated code
+static void gen_tb_stats_count_execution(TranslationBlock *tb)
+{
+    TCGv_ptr record = tcg_const_ptr((tcg_target_long)tb->stats);
+    TCGv_i64 count = tcg_temp_new_i64();
+
+    tcg_gen_ld_i64(count, record, offsetof(tb_stats_record_t, exec_count));
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, record, offsetof(tb_stats_record_t, exec_count));
+    tcg_temp_free_i64(count);
+    tcg_temp_free_ptr(record);
+}
+
+static inline void gen_block_header(TranslationBlock *tb)
+{
+    exit_no_hook_label = gen_new_label();
+    block_header_icount_args_count = 0;
+
+    // blocks translated without the optimizer are still profiled and mostly run just a few times,
+    // so the helper call, which is shorter to translate, is used in them right away
+    if (tb->optimized) {
+        gen_block_prologue_checks(tb);
+    } else {
+        gen_prepare_block_for_execution(tb);
+    }
 
     if (cpu->block_begin_hook_present) {
         TCGv_i32 result = tcg_temp_new_i32();
@@ -99,7 +235,15 @@ static inline void gen_block_header(TranslationBlock *tb)
         tcg_temp_free_i32(result);
     }
 
-    gen_update_instructions_count(tb);
+    if (cpu->block_batch != NULL) {
+        gen_block_batch_append(tb);
+    }
+
+    if (tb->stats != NULL) {
+        gen_tb_stats_count_execution(tb);
+    }
+
+    gen_update_instructions_count();
 }
 
 static void gen_block_finished_hook(TranslationBlock *tb, uint32_t instructions_count)
@@ -127,15 +271,59 @@ static void gen_interrupt_tb(TranslationBlock *tb, int n)
 
 void gen_exit_tb(TranslationBlock *tb, int n)
 {
+    if (tb->superblock) {
+        gen_superblock_side_exit(tb, tb->icount);
+    }
     gen_exit_tb_inner(tb, n, tb->icount);
 }
 
 void gen_exit_tb_no_chaining(TranslationBlock *tb)
 {
+    if (tb->superblock) {
+        gen_superblock_side_exit(tb, tb->icount);
+    }
     gen_block_finished_hook(tb, tb->icount);
     tcg_gen_exit_tb(0);
 }
 
+// Called by the architectures when generating a direct jump to `dest`.
+// Returns true if `dest` is the next segment of the superblock being translated; the jump is then
+// generated as a branch to the code of that segment and the caller must not generate an exit.
+bool gen_superblock_continue(DisasContextBase *dc, target_ulong dest)
+{
+    if (dc->trace_next_label < 0 || dc->trace_segment + 1 >= dc->trace->segments_count ||
+        dest != dc->trace->segment_pc[dc->trace_segment + 1]) {
+        return false;
+    }
+    tcg_gen_br(dc->trace_next_label);
+    dc->trace_continued = true;
+    return true;
+}
+
+// Each goto_tb slot can be patched only once, so in superblocks only the exits of the last segment are chained.
+// Side exits of the earlier segments always return to the main loop, as a chained jump would skip their icount correction.
+bool superblock_can_chain(DisasContextBase *dc)
+{
+    return dc->trace == NULL || dc->trace_next_label < 0 || dc->trace_segment + 1 >= dc->trace->segments_count;
+}
+
+static void gen_superblock_next_segment(DisasContextBase *dc)
+{
+    gen_set_label(dc->trace_next_label);
+    dc->trace_segment++;
+    dc->trace_next_label = gen_new_label();
+    dc->trace_continued = false;
+    dc->pc = dc->trace->segment_pc[dc->trace_segment];
+    dc->is_jmp = DISAS_NEXT;
+}
+
+static inline void superblock_extend_range(target_ulong *trace_end, target_ulong segment_pc, uint16_t segment_size)
+{
+    if (segment_pc + segment_size > *trace_end) {
+        *trace_end = segment_pc + segment_size;
+    }
+}
+
 static inline void gen_block_footer(TranslationBlock *tb)
 {
     if (tlib_is_on_block_translation_enabled) {
@@ -153,11 +341,21 @@ static inline void gen_block_footer(TranslationBlock *tb)
         tcg_gen_br(finish_label);
     }
 
+    if (tb->optimized) {
+        gen_set_label(block_header_slow_path_label);
+        gen_prepare_block_for_execution(tb);
+        tcg_gen_br(block_header_done_label);
+    }
+
     gen_set_label(exit_no_hook_label);
     tcg_gen_exit_tb((uintptr_t)tb | EXIT_TB_FORCE);
 
     gen_set_label(finish_label);
     *gen_opc_ptr = INDEX_op_end;
+
+    for (int i = 0; i < block_header_icount_args_count; i++) {
+        *block_header_icount_args[i] = tb->icount;
+    }
 }
 
 static inline uint32_t get_max_tb_instruction_count(CPUState *env)
@@ -166,13 +364,17 @@ static inline uint32_t get_max_tb_instruction_count(CPUState *env)
     return maximum_block_size > current_instructions_count_limit ? current_instructions_count_limit : maximum_block_size;
 }
 
-static void cpu_gen_code_inner(CPUState *env, TranslationBlock *tb)
+static void cpu_gen_code_inner(CPUState *env, TranslationBlock *tb, const SuperblockTrace *trace)
 {
     DisasContext dcc;
     CPUBreakpoint *bp;
     DisasContextBase *dc = (DisasContextBase *)&dcc;
 
     uint32_t max_tb_icount = get_max_tb_instruction_count(env);
+    // the superblock covers [tb->pc, trace_end); each segment is contiguous and starts at or after tb->pc
+    target_ulong trace_end = tb->pc;
+    target_ulong segment_pc = tb->pc;
+    uint16_t segment_size_base = 0;
 
     tb->icount = 0;
     tb->was_cut = false;
@@ -183,6 +385,10 @@ static void cpu_gen_code_inner(CPUState *env, TranslationBlock *tb)
     dc->guest_profile = env->guest_profiler_enabled;
 
     gen_block_header(tb);
+    dc->trace = trace;
+    dc->trace_segment = 0;
+    dc->trace_next_label = trace != NULL ? gen_new_label() : -1;
+    dc->trace_continued = false;
     setup_disas_context(dc, env);
     tcg_clear_temp_count();
     UNLOCK_TB(tb);
@@ -204,11 +410,18 @@ static void cpu_gen_code_inner(CPUState *env, TranslationBlock *tb)
         if (tcg_check_temp_count()) {
             tlib_abortf("TCG temps leak detected at PC %08X", dc->pc);
         }
-        if (do_break) {
-            break;
-        }
-        if (dc->is_jmp != DISAS_NEXT) {
-            break;
+        if (do_break || dc->is_jmp != DISAS_NEXT) {
+            if (!dc->trace_continued) {
+                break;
+            }
+            // the segment jumped to the next one; its code must follow even if translation stops right after
+            superblock_extend_range(&trace_end, segment_pc, tb->size - segment_size_base);
+            gen_superblock_next_segment(dc);
+            segment_pc = dc->pc;
+            segment_size_base = tb->size;
+            if (do_break) {
+                break;
+            }
         }
         if ((gen_opc_ptr - tcg->gen_opc_buf) >= OPC_MAX_SIZE) {
             break;
@@ -218,6 +431,12 @@ static void cpu_gen_code_inner(CPUState *env, TranslationBlock *tb)
             break;
         }
     }
+    if (trace != NULL) {
+        superblock_extend_range(&trace_end, segment_pc, tb->size - segment_size_base);
+        tb->size = trace_end - tb->pc;
+        // the epilogue exit is the last one, so it may chain and must not continue the trace
+        dc->trace_next_label = -1;
+    }
     tb->disas_flags = gen_intermediate_code_epilogue(env, dc);
     gen_block_footer(tb);
 }
@@ -312,14 +531,17 @@ static int encode_search(TranslationBlock *tb, uint8_t *block)
 /* '*gen_code_size_ptr' contains the size of the generated code (host
    code), '*search_size_ptr' contains the size of the search data.
  */
-void cpu_gen_code(CPUState *env, TranslationBlock *tb, int *gen_code_size_ptr, int *search_size_ptr)
+void cpu_gen_code(CPUState *env, TranslationBlock *tb, const SuperblockTrace *trace, int *gen_code_size_ptr,
+                  int *search_size_ptr)
 {
     TCGContext *s = tcg->ctx;
     uint8_t *gen_code_buf;
     int gen_code_size, search_size;
 
+    tb->superblock = trace != NULL;
+    s->optimize = tb->optimized;
     tcg_func_start(s);
-    cpu_gen_code_inner(env, tb);
+    cpu_gen_code_inner(env, tb, trace);
 
     /* generate machine code */
     gen_code_buf = tb->tc_ptr;
@@ -372,10 +594,13 @@ int cpu_restore_state_from_tb(CPUState *env, TranslationBlock *tb, uintptr_t sea
 int cpu_restore_state_and_restore_instructions_count(CPUState *env, TranslationBlock *tb, uintptr_t searched_pc)
 {
     int executed_instructions = cpu_restore_state_from_tb(env, tb, searched_pc);
-    if (executed_instructions != -1 && tb->instructions_count_dirty) {
+    // the header added `icount` of this block to the counters; give back the rest of it only once per execution
+    if (executed_instructions != -1 &&
+        (env->instructions_count_restored_tb != tb || env->instructions_count_restored_total != cpu->instructions_count_total_value)) {
         cpu->instructions_count_value -= (tb->icount - executed_instructions);
         cpu->instructions_count_total_value -= (tb->icount - executed_instructions);
-        tb->instructions_count_dirty = 0;
+        env->instructions_count_restored_tb = tb;
+        env->instructions_count_restored_total = cpu->instructions_count_total_value;
     }
     return executed_instructions;
 }
@@ -395,19 +620,110 @@ void cpu_restore_state(CPUState *env, void *retaddr) {
   }
 }
 
-void generate_opcode_count_increment(CPUState *env, uint64_t opcode)
+/* Opcode counters are grouped by mask and indexed by (mask group, masked opcode),
+   so matching an instruction costs one hash probe per distinct mask. */
+#define OPCODE_COUNTERS_HASH_BITS 12
+#define OPCODE_COUNTERS_HASH_SIZE (1 << OPCODE_COUNTERS_HASH_BITS)
+
+typedef struct opcode_counters_hash_entry {
+    uint64_t opcode;
+    int16_t group;
+    int16_t counter;
+} opcode_counters_hash_entry;
+
+static uint64_t opcode_counters_masks[MAX_OPCODE_COUNTERS];
+static uint32_t opcode_counters_masks_count;
+static opcode_counters_hash_entry opcode_counters_hash[OPCODE_COUNTERS_HASH_SIZE];
+
+void opcode_counters_invalidate_index(void)
+{
+    cpu->opcode_counters_index_valid = false;
+}
+
+static inline uint32_t opcode_counters_hash_func(uint64_t opcode, uint32_t group)
+{
+    return ((opcode ^ ((uint64_t)group << 48)) * 0x9E3779B97F4A7C15ull) >> (64 - OPCODE_COUNTERS_HASH_BITS);
+}
+
+static void rebuild_opcode_counters_index(CPUState *env)
 {
-    uint64_t masked_opcode;
+    memset(opcode_counters_hash, -1, sizeof(opcode_counters_hash));
+    opcode_counters_masks_count = 0;
+
     for (uint32_t i = 0; i < env->opcode_counters_size; i++) {
+        opcode_counter_descriptor *descriptor = &env->opcode_counters[i];
+        if (descriptor->opcode & ~descriptor->mask) {
+            // such a pattern can never match
+            continue;
+        }
+
+        uint32_t group = 0;
+        while (group < opcode_counters_masks_count && opcode_counters_masks[group] != descriptor->mask) {
+            group++;
+        }
+        if (group == opcode_counters_masks_count) {
+            opcode_counters_masks[opcode_counters_masks_count++] = descriptor->mask;
+        }
+
+        // The table holds at least twice as many slots as there are counters, so probing always terminates
+        uint32_t slot = opcode_counters_hash_func(descriptor->opcode, group);
+        while (opcode_counters_hash[slot].counter != -1) {
+            if (opcode_counters_hash[slot].group == group && opcode_counters_hash[slot].opcode == descriptor->opcode) {
+                // an earlier counter with the same pattern takes precedence
+                break;
+            }
+            slot = (slot + 1) & (OPCODE_COUNTERS_HASH_SIZE - 1);
+        }
+        if (opcode_counters_hash[slot].counter == -1) {
+            opcode_counters_hash[slot].opcode = descriptor->opcode;
+            opcode_counters_hash[slot].group = group;
+            opcode_counters_hash[slot].counter = i;
+        }
+    }
+
+    env->opcode_counters_index_valid = true;
+}
+
+static int find_opcode_counter(CPUState *env, uint64_t opcode)
+{
+    int result = -1;
+
+    if (unlikely(!env->opcode_counters_index_valid)) {
+        rebuild_opcode_counters_index(env);
+    }
+
+    for (uint32_t group = 0; group < opcode_counters_masks_count; group++) {
         // mask out non-opcode fields
-        masked_opcode = opcode & env->opcode_counters[i].mask;
-        if (env->opcode_counters[i].opcode == masked_opcode) {
-            TCGv_i32 p = tcg_const_i32(i);
-            gen_helper_count_opcode_inner(p);
-            tcg_temp_free_i32(p);
-            break;
+        uint64_t masked_opcode = opcode & opcode_counters_masks[group];
+        uint32_t slot = opcode_counters_hash_func(masked_opcode, group);
+        while (opcode_counters_hash[slot].counter != -1) {
+            if (opcode_counters_hash[slot].group == group && opcode_counters_hash[slot].opcode == masked_opcode) {
+                // the counter installed first wins, as in a linear scan
+                if (result == -1 || opcode_counters_hash[slot].counter < result) {
+                    result = opcode_counters_hash[slot].counter;
+                }
+                break;
+            }
+            slot = (slot + 1) & (OPCODE_COUNTERS_HASH_SIZE - 1);
         }
     }
+    return result;
+}
+
+void generate_opcode_count_increment(CPUState *env, uint64_t opcode)
+{
+    int counter_index = find_opcode_counter(env, opcode);
+    if (counter_index == -1) {
+        return;
+    }
+
+    intptr_t offset = offsetof(CPUState, opcode_counters) + counter_index * sizeof(opcode_counter_descriptor) +
+                      offsetof(opcode_counter_descriptor, counter);
+    TCGv_i64 counter = tcg_temp_new_i64();
+    tcg_gen_ld_i64(counter, cpu_env, offset);
+    tcg_gen_addi_i64(counter, counter, 1);
+    tcg_gen_st_i64(counter, cpu_env, offset);
+    tcg_temp_free_i64(counter);
 }
 
 void generate_stack_announcement_imm_i32(uint32_t addr, int type, bool clear_lsb)
@@ -1,124 +1,105 @@
+#include <sched.h>
 #include "atomic.h"
 #include "cpu.h"
-#include "pthread.h"
+
+// How many failed attempts to take a stripe are made before yielding the host thread
+#define MEMORY_LOCK_SPINS_BEFORE_YIELD 64
 
 static inline void ensure_locked_by_me(struct CPUState *env)
 {
 #if DEBUG
-    if (env->atomic_memory_state->locking_cpu_id != env->id) {
-        tlib_abort("Tried to release global memory lock by the cpu that does not own it!");
+    if (env->atomic_memory_state->held_stripe[env->id] == NO_STRIPE) {
+        tlib_abort("Tried to release memory lock by the cpu that does not own it!");
     }
 #endif
 }
 
-static void initialize_atomic_memory_state(atomic_memory_state_t *sm)
+// The stripe is picked by the 8-byte word within the smallest page of all the targets (1KB), so only the address bits
+// that are the same in the virtual and the physical address are used: cpus accessing one physical word through
+// different virtual mappings always contend on the same stripe.
+static inline uint32_t memory_lock_stripe(target_phys_addr_t address)
 {
-    if (!sm->is_mutex_initialized) {
-        pthread_mutexattr_t attributes;
-        if (unlikely(pthread_mutexattr_init(&attributes))) {
-            tlib_abortf("Failed to initialize phthread_muttexattr_t");
-        }
-// This flag is only supported on Linux
-#if defined(__linux__)
-        if (unlikely(pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST))) {
-            tlib_abortf("Failed to make the mutex robust");
-        }
-#endif
-        if (unlikely(pthread_mutex_init(&sm->global_mutex, &attributes))) {
-            tlib_abortf("Failed to initialize the pthread_mutex");
-        }
-        if (unlikely(pthread_mutexattr_destroy(&attributes))) {
-            tlib_abortf("Failed to destroy the pthread_mutexattr");
-        }
-
-        pthread_cond_init(&sm->global_cond, NULL);
-        sm->locking_cpu_id = NO_CPU_ID;
-        sm->entries_count = 0;
-        sm->number_of_registered_cpus = 0;
+    return (address >> 3) & (MEMORY_LOCK_STRIPES - 1);
+}
 
-        sm->is_mutex_initialized = 1;
-    }
+static inline bool holds_stripe(atomic_memory_state_t *sm, int id, uint32_t stripe)
+{
+    return sm->held_stripe[id] == stripe || sm->held_next_stripe[id] == stripe;
+}
 
-    if (!sm->are_reservations_valid) {
-        sm->reservations_count = 0;
-        for (int i = 0; i < MAX_NUMBER_OF_CPUS; i++) {
-            sm->reservations[i].id = i;
-            sm->reservations[i].active_flag = 0;
-            sm->reservations[i].address = 0;
-            sm->reservations[i].locking_cpu_id = NO_CPU_ID;
-            sm->reservations_by_cpu[i] = NO_RESERVATION;
+static inline void take_stripe(atomic_memory_state_t *sm, int id, uint32_t stripe)
+{
+    uint32_t spins = 0;
+    uint32_t expected = NO_CPU_ID;
+    while (!__atomic_compare_exchange_n(&sm->stripe_locking_cpu_id[stripe], &expected, id, false, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+        expected = NO_CPU_ID;
+        if (++spins == MEMORY_LOCK_SPINS_BEFORE_YIELD) {
+            spins = 0;
+            sched_yield();
         }
-
-        sm->are_reservations_valid = 1;
     }
 }
 
-static inline address_reservation_t *find_reservation_on_address(struct CPUState *env, target_phys_addr_t address,
-                                                                 int starting_position)
+static inline void drop_stripes(atomic_memory_state_t *sm, int id)
 {
-    int i;
-    for (i = starting_position; i < env->atomic_memory_state->reservations_count; i++) {
-        if (env->atomic_memory_state->reservations[i].address == address) {
-            return &env->atomic_memory_state->reservations[i];
-        }
-    }
-    return NULL;
+    uint32_t stripe = sm->held_stripe[id];
+    uint32_t next_stripe = sm->held_next_stripe[id];
+    sm->held_stripe[id] = NO_STRIPE;
+    sm->held_next_stripe[id] = NO_STRIPE;
+    if (next_stripe != NO_STRIPE) {
+        __atomic_store_n(&sm->stripe_locking_cpu_id[next_stripe], NO_CPU_ID, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&sm->stripe_locking_cpu_id[stripe], NO_CPU_ID, __ATOMIC_RELEASE);
 }
 
-// there can be only one reservation per cpu
-static inline address_reservation_t *find_reservation_by_cpu(struct CPUState *env)
+static inline uint32_t reservation_bucket(target_phys_addr_t address)
 {
-    int reservation_id = env->atomic_memory_state->reservations_by_cpu[env->id];
-#if DEBUG
-    if (reservation_id >= env->atomic_memory_state->reservations_count) {
-        tlib_abort("Inconsistent reservation count detected.");
-    }
-#endif
-    return (reservation_id == NO_RESERVATION) ? NULL : &env->atomic_memory_state->reservations[reservation_id];
+    return (address * 0x9E3779B97F4A7C15ull) >> (64 - RESERVATION_BUCKETS_BITS);
 }
 
-static inline address_reservation_t *make_reservation(struct CPUState *env, target_phys_addr_t address)
+static void initialize_atomic_memory_state(atomic_memory_state_t *sm)
 {
-    if (unlikely(env->atomic_memory_state->reservations_count == MAX_NUMBER_OF_CPUS)) {
-        tlib_abort("No more address reservation slots");
-    }
+    if (!sm->are_locks_initialized) {
+        for (int i = 0; i < MEMORY_LOCK_STRIPES; i++) {
+            sm->stripe_locking_cpu_id[i] = NO_CPU_ID;
+        }
+        for (int i = 0; i < MAX_NUMBER_OF_CPUS; i++) {
+            sm->held_stripe[i] = NO_STRIPE;
+            sm->held_next_stripe[i] = NO_STRIPE;
+            sm->entries_count[i] = 0;
+        }
+        sm->number_of_registered_cpus = 0;
 
-    address_reservation_t *reservation = &env->atomic_memory_state->reservations[env->atomic_memory_state->reservations_count];
-    reservation->active_flag = 1;
-    reservation->address = address;
-    reservation->locking_cpu_id = env->id;
+        sm->are_locks_initialized = 1;
+    }
 
-    env->atomic_memory_state->reservations_by_cpu[env->id] = env->atomic_memory_state->reservations_count;
-    env->atomic_memory_state->reservations_count++;
+    if (!sm->are_reservations_valid) {
+        for (int i = 0; i < MAX_NUMBER_OF_CPUS; i++) {
+            sm->reserved_address[i] = NO_RESERVATION;
+            sm->reservation_bucket[i] = NO_BUCKET;
+        }
+        for (int i = 0; i < RESERVATION_BUCKETS; i++) {
+            sm->reservation_buckets[i] = 0;
+        }
 
-    return reservation;
+        sm->are_reservations_valid = 1;
+    }
 }
 
-static inline void free_reservation(struct CPUState *env, address_reservation_t *reservation)
+static inline bool is_synchronization_needed(struct CPUState *env)
 {
-#if DEBUG
-    if (reservation->active_flag == 0) {
-        tlib_abort("Trying to free not active reservation");
-    }
-    if (env->atomic_memory_state->reservations_count == 0) {
-        tlib_abort("Reservations count is 0, but trying to free one");
-    }
-#endif
-
-    env->atomic_memory_state->reservations_by_cpu[reservation->locking_cpu_id] = NO_RESERVATION;
-    if (reservation->id != env->atomic_memory_state->reservations_count - 1) {
-        // if this is not the last reservation, i must copy the last one in this empty place
-        reservation->locking_cpu_id =
-            env->atomic_memory_state->reservations[env->atomic_memory_state->reservations_count - 1].locking_cpu_id;
-        reservation->address = env->atomic_memory_state->reservations[env->atomic_memory_state->reservations_count - 1].address;
-        // active flag does not have to be copied as it's always 1
+    // with no atomic_memory_state or just one cpu there is no need for synchronization
+    return env->atomic_memory_state != NULL && env->atomic_memory_state->number_of_registered_cpus > 1;
+}
 
-        // and update mapping
-        env->atomic_memory_state->reservations_by_cpu[reservation->locking_cpu_id] = reservation->id;
+static inline void drop_own_reservation(atomic_memory_state_t *sm, int id)
+{
+    __atomic_store_n(&sm->reserved_address[id], NO_RESERVATION, __ATOMIC_RELEASE);
+    if (sm->reservation_bucket[id] != NO_BUCKET) {
+        __atomic_and_fetch(&sm->reservation_buckets[sm->reservation_bucket[id]], ~(1u << id), __ATOMIC_RELEASE);
+        sm->reservation_bucket[id] = NO_BUCKET;
     }
-
-    env->atomic_memory_state->reservations[env->atomic_memory_state->reservations_count - 1].active_flag = 0;
-    env->atomic_memory_state->reservations_count--;
 }
 
 void register_in_atomic_memory_state(atomic_memory_state_t *sm, int id)
@@ -131,134 +112,143 @@ void register_in_atomic_memory_state(atomic_memory_state_t *sm, int id)
     sm->number_of_registered_cpus++;
 }
 
-void acquire_global_memory_lock(struct CPUState *env)
+// An access not aligned to 8 bytes may spill into the following word (the slow path splits it into accesses
+// of both words), so the stripe of that word is taken too; two stripes are always taken in the ascending order,
+// so cpus taking them cannot deadlock.
+// The lock is reentrant: nested acquisitions by a cpu already holding the stripes only bump its entries count.
+// They never take another stripe, so they must stay within the words covered by the outermost acquisition,
+// which holds for the accesses of an atomic sequence (all of them to its address) and for the split accesses.
+void acquire_memory_lock(struct CPUState *env, target_phys_addr_t address)
 {
-    if (env->atomic_memory_state == NULL) {
-        // no atomic_memory_state so no need for synchronization
+    if (!is_synchronization_needed(env)) {
         return;
     }
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
-        // there is no need for synchronization
+
+    atomic_memory_state_t *sm = env->atomic_memory_state;
+    if (sm->held_stripe[env->id] != NO_STRIPE) {
+#if DEBUG
+        if (!holds_stripe(sm, env->id, memory_lock_stripe(address))) {
+            tlib_abortf("Nested memory lock acquisition at 0x%" PRIx64 " outside of the words locked by the cpu",
+                        (uint64_t)address);
+        }
+#endif
+        sm->entries_count[env->id]++;
         return;
     }
 
-    pthread_mutex_lock(&env->atomic_memory_state->global_mutex);
-    if (env->atomic_memory_state->locking_cpu_id != env->id) {
-        while (env->atomic_memory_state->locking_cpu_id != NO_CPU_ID) {
-            pthread_cond_wait(&env->atomic_memory_state->global_cond, &env->atomic_memory_state->global_mutex);
+    uint32_t stripe = memory_lock_stripe(address);
+    uint32_t next_stripe = NO_STRIPE;
+    if ((address & 0x7) != 0) {
+        next_stripe = memory_lock_stripe(address + 8);
+    }
+    if (next_stripe != NO_STRIPE && next_stripe < stripe) {
+        take_stripe(sm, env->id, next_stripe);
+        take_stripe(sm, env->id, stripe);
+    } else {
+        take_stripe(sm, env->id, stripe);
+        if (next_stripe != NO_STRIPE) {
+            take_stripe(sm, env->id, next_stripe);
         }
-        env->atomic_memory_state->locking_cpu_id = env->id;
     }
-    env->atomic_memory_state->entries_count++;
-    pthread_mutex_unlock(&env->atomic_memory_state->global_mutex);
+    sm->held_stripe[env->id] = stripe;
+    sm->held_next_stripe[env->id] = next_stripe;
+    sm->entries_count[env->id] = 1;
 }
 
-void release_global_memory_lock(struct CPUState *env)
+void release_memory_lock(struct CPUState *env)
 {
-    if (env->atomic_memory_state == NULL) {
-        // no atomic_memory_state so no need for synchronization
-        return;
-    }
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
-        // there is no need for synchronization
+    if (!is_synchronization_needed(env)) {
         return;
     }
 
-    pthread_mutex_lock(&env->atomic_memory_state->global_mutex);
+    atomic_memory_state_t *sm = env->atomic_memory_state;
     ensure_locked_by_me(env);
-    env->atomic_memory_state->entries_count--;
-    if (env->atomic_memory_state->entries_count == 0) {
-        env->atomic_memory_state->locking_cpu_id = NO_CPU_ID;
-        pthread_cond_signal(&env->atomic_memory_state->global_cond);
+    sm->entries_count[env->id]--;
+    if (sm->entries_count[env->id] == 0) {
+        drop_stripes(sm, env->id);
     }
-    pthread_mutex_unlock(&env->atomic_memory_state->global_mutex);
 }
 
-void clear_global_memory_lock(struct CPUState *env)
+// Releases the stripes held by the cpu, if any, regardless of the nesting level;
+// used when an exception leaves an atomic sequence before its release.
+void clear_memory_lock(struct CPUState *env)
 {
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
-        // there is no need for synchronization
+    if (!is_synchronization_needed(env)) {
         return;
     }
 
-    pthread_mutex_lock(&env->atomic_memory_state->global_mutex);
-    ensure_locked_by_me(env);
-    env->atomic_memory_state->locking_cpu_id = NO_CPU_ID;
-    env->atomic_memory_state->entries_count = 0;
-    pthread_cond_signal(&env->atomic_memory_state->global_cond);
-    pthread_mutex_unlock(&env->atomic_memory_state->global_mutex);
+    atomic_memory_state_t *sm = env->atomic_memory_state;
+    if (sm->held_stripe[env->id] == NO_STRIPE) {
+        return;
+    }
+    sm->entries_count[env->id] = 0;
+    drop_stripes(sm, env->id);
 }
 
-// ! this function should be called when holding the mutex !
+// ! this function should be called when holding the lock on `address` !
+// there can be only one reservation per cpu
 void reserve_address(struct CPUState *env, target_phys_addr_t address)
 {
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
+    if (!is_synchronization_needed(env)) {
         // if there is just one cpu, return ok status
         return;
     }
 
-    address_reservation_t *reservation;
-
+    atomic_memory_state_t *sm = env->atomic_memory_state;
     ensure_locked_by_me(env);
 
-    reservation = find_reservation_by_cpu(env);
-    if (reservation != NULL) {
-        if (reservation->address == address) {
-            return;
-        }
+    uint32_t bucket = reservation_bucket(address);
+    if (sm->reservation_bucket[env->id] != bucket) {
         // cancel the previous reservation and set a new one
-        free_reservation(env, reservation);
+        drop_own_reservation(sm, env->id);
+    }
+    // the address must be visible before the bucket bit is, so anyone finding the bit can invalidate it
+    __atomic_store_n(&sm->reserved_address[env->id], address, __ATOMIC_RELEASE);
+    if (sm->reservation_bucket[env->id] != bucket) {
+        __atomic_or_fetch(&sm->reservation_buckets[bucket], 1u << env->id, __ATOMIC_RELEASE);
+        sm->reservation_bucket[env->id] = bucket;
     }
-    make_reservation(env, address);
 }
 
 uint32_t check_address_reservation(struct CPUState *env, target_phys_addr_t address)
 {
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
+    if (!is_synchronization_needed(env)) {
         // if there is just one cpu, return ok status
         return 0;
     }
 
     ensure_locked_by_me(env);
-    address_reservation_t *reservation = find_reservation_by_cpu(env);
-    return (reservation == NULL || reservation->address != address);
+    return __atomic_load_n(&env->atomic_memory_state->reserved_address[env->id], __ATOMIC_ACQUIRE) != address;
 }
 
 void register_address_access(struct CPUState *env, target_phys_addr_t address)
 {
-    if (env->atomic_memory_state == NULL) {
-        // no atomic_memory_state so no registration needed
-        return;
-    }
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
-        // this is not need when we have only one cpu
+    if (!is_synchronization_needed(env)) {
+        // this is not needed when we have only one cpu
         return;
     }
 
+    atomic_memory_state_t *sm = env->atomic_memory_state;
     ensure_locked_by_me(env);
 
-    address_reservation_t *reservation = find_reservation_on_address(env, address, 0);
-    while (reservation != NULL) {
-        if (reservation->locking_cpu_id != env->id) {
-            free_reservation(env, reservation);
-            reservation = find_reservation_on_address(env, address, 0);
-        } else {
-            reservation = find_reservation_on_address(env, address, reservation->id + 1);
-        }
+    uint32_t others = __atomic_load_n(&sm->reservation_buckets[reservation_bucket(address)], __ATOMIC_ACQUIRE);
+    others &= ~(1u << env->id);
+    while (others != 0) {
+        int id = __builtin_ctz(others);
+        uint64_t expected = address;
+        // Bits are only cleared by their owners, so a stale bit just fails this exchange
+        __atomic_compare_exchange_n(&sm->reserved_address[id], &expected, NO_RESERVATION, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_RELAXED);
+        others &= others - 1;
     }
 }
 
 void cancel_reservation(struct CPUState *env)
 {
-    if (env->atomic_memory_state->number_of_registered_cpus == 1) {
-        // this is not need when we have only one cpu
+    if (!is_synchronization_needed(env)) {
+        // this is not needed when we have only one cpu
         return;
     }
 
-    ensure_locked_by_me(env);
-
-    address_reservation_t *reservation = find_reservation_by_cpu(env);
-    if (reservation != NULL) {
-        free_reservation(env, reservation);
-    }
+    drop_own_reservation(env->atomic_memory_state, env->id);
 }
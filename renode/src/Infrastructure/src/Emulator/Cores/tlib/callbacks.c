@@ -52,6 +52,8 @@ DEFAULT_INT_HANDLER2(uint32_t tlib_on_block_begin, uint64_t address, uint32_t si
 
 DEFAULT_VOID_HANDLER2(void tlib_on_block_finished, uint64_t pc, uint32_t executed_instructions)
 
+DEFAULT_VOID_HANDLER2(void tlib_on_block_begin_batch, void *records, uint32_t count)
+
 void *tlib_malloc(size_t size) __attribute__((weak));
 
 void *tlib_malloc(size_t size)
@@ -97,6 +99,8 @@ void tlib_on_block_translation(uint64_t start, uint32_t size, uint32_t flags)
 
 DEFAULT_VOID_HANDLER3(void tlib_on_memory_access, uint64_t pc, uint32_t operation, uint64_t address)
 
+DEFAULT_VOID_HANDLER1(void tlib_on_memory_trace_ready, void)
+
 DEFAULT_INT_HANDLER1(uint32_t tlib_is_in_debug_mode, void)
 
 DEFAULT_VOID_HANDLER1(void tlib_on_interrupt_begin, uint64_t exception_index)
@@ -105,6 +109,15 @@ DEFAULT_VOID_HANDLER1(void tlib_on_interrupt_end, uint64_t exception_index)
 
 DEFAULT_PTR_HANDLER1(void *tlib_guest_offset_to_host_ptr, uint64_t offset)
 
+void *tlib_guest_offset_to_host_span(uint64_t offset, uint64_t *size) __attribute__((weak));
+
+// Without the host blocks only the byte at `offset` is known to be mapped
+void *tlib_guest_offset_to_host_span(uint64_t offset, uint64_t *size)
+{
+    *size = 1;
+    return tlib_guest_offset_to_host_ptr(offset);
+}
+
 DEFAULT_INT_HANDLER1(uint64_t tlib_host_ptr_to_guest_offset, void *ptr)
 
 DEFAULT_VOID_HANDLER3(void tlib_mmu_fault_external_handler, uint64_t addr, int32_t access_type, int32_t window_index)
@@ -113,6 +126,8 @@ DEFAULT_VOID_HANDLER4(void tlib_profiler_announce_stack_change, uint64_t current
 
 DEFAULT_VOID_HANDLER1(void tlib_profiler_announce_context_change, uint64_t context_id)
 
+DEFAULT_VOID_HANDLER2(void tlib_on_profiler_samples, void *samples, uint32_t count)
+
 DEFAULT_VOID_HANDLER2(void tlib_mass_broadcast_dirty, void* list_start ,int32_t size)
 
 DEFAULT_PTR_HANDLER1(void *tlib_get_dirty_addresses_list, void *size)
@@ -19,6 +19,7 @@
 #include "cpu.h"
 #include "tcg.h"
 #include "atomic.h"
+#include "sampling_profiler.h"
 
 target_ulong virt_to_phys(target_ulong virtual, uint32_t access_type, uint32_t nofault)
 {
@@ -37,7 +38,7 @@ target_ulong virt_to_phys(target_ulong virtual, uint32_t access_type, uint32_t n
     nofault = !!nofault;
 
     masked_virtual = virtual & TARGET_PAGE_MASK;
-    page_index = (virtual >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    page_index = CPU_TLB_INDEX(env, virtual);
 
     if ((env->tlb_table[mmu_idx][page_index].addr_write & TARGET_PAGE_MASK) == masked_virtual) {
         physical = env->tlb_table[mmu_idx][page_index].addr_write;
@@ -164,6 +165,9 @@ static TranslationBlock *tb_find_slow(CPUState *env, target_ulong pc, target_ulo
     h = tb_phys_hash_func(phys_pc);
     ptb1 = &tb_phys_hash[h];
 
+    if (unlikely(env->tb_stats != NULL)) {
+        env->tb_stats->phys_hash_lookups++;
+    }
     if (unlikely(env->tb_cache_disabled || force_translation)) {
         goto not_found;
     }
@@ -190,6 +194,9 @@ static TranslationBlock *tb_find_slow(CPUState *env, target_ulong pc, target_ulo
         ptb1 = &tb->phys_hash_next;
     }
 not_found:
+    if (unlikely(env->tb_stats != NULL)) {
+        env->tb_stats->phys_hash_misses++;
+    }
     /* if no translated code available, then translate it now */
     tb = tb_gen_code(env, pc, cs_base, flags, 0);
 
@@ -222,9 +229,32 @@ static inline TranslationBlock *tb_find_fast(CPUState *env)
     if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base || tb->flags != flags || env->tb_cache_disabled)) {
         tb = tb_find_slow(env, pc, cs_base, flags, 0);
     } else if (tb->was_cut && tb->icount < max_icount) {
-        // force translation
+        // force translation, unless there is a superblock shadowed by this block
+        tb_stats_invalidated(tb->stats, TB_STATS_INVALIDATED_RESIZED);
         tb_phys_invalidate(tb, -1);
+        tb = tb_find_slow(env, pc, cs_base, flags, 0);
+    } else if (unlikely(env->tb_stats != NULL)) {
+        env->tb_stats->jmp_cache_hits++;
+    }
+#ifdef SUPPORTS_SUPERBLOCKS
+    if (unlikely(tb->shadowed_superblock_icount != 0 && tb->shadowed_superblock_icount <= max_icount)) {
+        // the superblock behind this block fits again
+        tb_stats_invalidated(tb->stats, TB_STATS_INVALIDATED_RESIZED);
+        tb_phys_invalidate(tb, -1);
+        tb = tb_find_slow(env, pc, cs_base, flags, 0);
+    }
+    if (unlikely(tb->superblock && tb->icount > max_icount)) {
+        // the superblock does not fit in this `tlib_execute` call, so a regular block is translated in front of it
+        uint32_t superblock_icount = tb->icount;
         tb = tb_find_slow(env, pc, cs_base, flags, 1);
+        tb->shadowed_superblock_icount = superblock_icount;
+    } else if (unlikely(superblock_threshold != 0 && tb->exec_count >= superblock_threshold &&
+                        tb->superblock_attempts < SUPERBLOCK_MAX_ATTEMPTS)) {
+        tb = tb_gen_superblock(env, tb);
+    }
+#endif
+    if (unlikely(!tb->optimized && tb->exec_count >= tiered_translation_threshold)) {
+        tb = tb_gen_second_tier(env, tb);
     }
     return tb;
 }
@@ -244,9 +274,7 @@ static void verify_state(CPUState *env)
     if (env->atomic_memory_state == NULL) {
         return;
     }
-    if (env->atomic_memory_state->locking_cpu_id == env->id) {
-        clear_global_memory_lock(env);
-    }
+    clear_memory_lock(env);
 }
 
 /* main execution loop */
@@ -342,6 +370,9 @@ int cpu_exec(CPUState *env)
                 if (unlikely(env->exception_index != -1)) {
                     cpu_loop_exit_without_hook(env);
                 }
+                if (unlikely(env->sampling_profiler != NULL)) {
+                    sampling_profiler_check(env, CPU_PC(env));
+                }
                 if (cpu->instructions_count_value == cpu->instructions_count_limit) {
                     env->exit_request = 1;
                 }
@@ -354,6 +385,10 @@ int cpu_exec(CPUState *env)
                     cpu_loop_exit_without_hook(env);
                 }
 
+                if (unlikely(env->tlb_resize_pending_bits)) {
+                    tlb_apply_pending_resize(env);
+                }
+
                 tb = tb_find_fast(env);
                 /* Note: we do it here to avoid a gcc bug on Mac OS X when
                    doing it in tb_find_slow */
@@ -382,10 +417,11 @@ int cpu_exec(CPUState *env)
                 asm volatile ("" ::: "memory");
                 if (likely(!env->exit_request)) {
                     tc_ptr = tb->tc_ptr;
+                    env->previous_tb = NULL;
                     /* execute the generated code */
                     next_tb = tcg_tb_exec(env, tc_ptr);
-                    /* Flush the list after every unchained block */
-                    flush_dirty_addresses_list();
+                    /* Broadcast the pending dirty pages once their batch is old enough */
+                    try_flush_dirty_addresses_list();
                     if ((next_tb & 3) == EXIT_TB_FORCE) {
                         tb = (TranslationBlock *)(uintptr_t)(next_tb & ~3);
                         /* Restore PC.  */
@@ -406,6 +442,7 @@ int cpu_exec(CPUState *env)
         }
     } /* for(;;) */
 
+    flush_dirty_addresses_list();
     cpu_exec_epilogue(env);
 
     return ret;
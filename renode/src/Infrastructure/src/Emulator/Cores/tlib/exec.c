@@ -402,10 +402,21 @@ void cpu_exec_init_all()
     cpu_env = tcg_global_reg_new_ptr(TCG_AREG0, "env");
 }
 
+static void tlb_set_size_bits(CPUState *env, uint32_t bits)
+{
+    env->tlb_size_bits = bits;
+    env->tlb_mask = (((uintptr_t)1 << bits) - 1) << CPU_TLB_ENTRY_BITS;
+    env->tlb_window_fills = 0;
+    env->tlb_window_evictions = 0;
+}
+
 void cpu_exec_init(CPUState *env)
 {
     cpu = env;
     QTAILQ_INIT(&cpu->breakpoints);
+    tlb_set_size_bits(env, CPU_TLB_BITS);
+    env->tlb_base_size_bits = CPU_TLB_BITS;
+    env->tlb_dynamic_resize = CPU_TLB_MAX_BITS > CPU_TLB_MIN_BITS;
 }
 
 /* Allocate a new translation block. Flush the translation buffer if
@@ -483,6 +494,13 @@ void tb_flush(CPUState *env1)
         cpu_abort(env1, "Internal error: code buffer overflow\n");
     }
 
+    if (unlikely(cpu->tb_stats != NULL)) {
+        for (int i = 0; i < nb_tbs; ++i) {
+            tb_stats_invalidated(tbs[i].stats, TB_STATS_INVALIDATED_FLUSH);
+        }
+        cpu->tb_stats->flushes++;
+    }
+
     nb_tbs = 0;
     memset(cpu->tb_jmp_cache, 0, TB_JMP_CACHE_SIZE * sizeof (void *));
     memset(tb_phys_hash, 0, CODE_GEN_PHYS_HASH_SIZE * sizeof (void *));
@@ -559,6 +577,9 @@ static inline void tb_jmp_remove(TranslationBlock *tb, int n)
 static inline void tb_reset_jump(TranslationBlock *tb, int n)
 {
     tb_set_jmp_target(tb, n, (uintptr_t)(tb->tc_ptr + tb->tb_next_offset[n]));
+    if (unlikely(tb->stats != NULL)) {
+        tb->stats->chained_exits &= ~(1 << n);
+    }
 }
 
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
@@ -612,6 +633,9 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
     }
     tb->jmp_first = (TranslationBlock *)((uintptr_t)tb | EXIT_TB_FORCE); /* fail safe */
     tb_phys_invalidate_count++;
+    if (unlikely(cpu->tb_stats != NULL)) {
+        cpu->tb_stats->invalidations++;
+    }
 }
 
 static inline void set_bits(uint8_t *tab, int start, int len)
@@ -641,9 +665,47 @@ static inline void set_bits(uint8_t *tab, int start, int len)
     }
 }
 
+/* mark the bytes of the page 'n' of the TB in the code bitmap */
+static void set_page_bitmap_bits(PageDesc *p, TranslationBlock *tb, int n)
+{
+    int tb_start, tb_end;
+
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    if (n == EXIT_TB_NO_JUMP) {
+        /* NOTE: tb_end may be after the end of the page, but
+           it is not a problem */
+        tb_start = tb->pc & ~TARGET_PAGE_MASK;
+        /* empty blocks (with just a breakpoint) take one byte, so that writes at their address are still seen */
+        tb_end = tb_start + (tb->size ? tb->size : 1);
+        if (tb_end > TARGET_PAGE_SIZE) {
+            tb_end = TARGET_PAGE_SIZE;
+        }
+    } else {
+        tb_start = 0;
+        tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
+    }
+    set_bits(p->code_bitmap, tb_start, tb_end - tb_start);
+}
+
+/* check if any of the 'len' (at most 8) bytes at 'offset' in the page may belong to a TB */
+static inline bool page_bitmap_has_code(PageDesc *p, int offset, int len)
+{
+    int index = offset >> 3;
+    uint32_t bits;
+
+    if (offset + len > TARGET_PAGE_SIZE) {
+        len = TARGET_PAGE_SIZE - offset;
+    }
+    bits = p->code_bitmap[index];
+    if (index + 1 < TARGET_PAGE_SIZE / 8) {
+        bits |= p->code_bitmap[index + 1] << 8;
+    }
+    return (bits >> (offset & 7)) & ((1 << len) - 1);
+}
+
 static void build_page_bitmap(PageDesc *p)
 {
-    int n, tb_start, tb_end;
+    int n;
     TranslationBlock *tb;
 
     p->code_bitmap = tlib_mallocz(TARGET_PAGE_SIZE / 8);
@@ -652,25 +714,13 @@ static void build_page_bitmap(PageDesc *p)
     while (tb != NULL) {
         n = (uintptr_t)tb & 3;
         tb = (TranslationBlock *)((uintptr_t)tb & ~3);
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        if (n == EXIT_TB_NO_JUMP) {
-            /* NOTE: tb_end may be after the end of the page, but
-               it is not a problem */
-            tb_start = tb->pc & ~TARGET_PAGE_MASK;
-            tb_end = tb_start + tb->size;
-            if (tb_end > TARGET_PAGE_SIZE) {
-                tb_end = TARGET_PAGE_SIZE;
-            }
-        } else {
-            tb_start = 0;
-            tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
-        }
-        set_bits(p->code_bitmap, tb_start, tb_end - tb_start);
+        set_page_bitmap_bits(p, tb, n);
         tb = tb->page_next[n];
     }
 }
 
-TranslationBlock *tb_gen_code(CPUState *env, target_ulong pc, target_ulong cs_base, int flags, uint16_t cflags)
+static TranslationBlock *tb_gen_code_inner(CPUState *env, target_ulong pc, target_ulong cs_base, int flags, uint16_t cflags,
+                                           const SuperblockTrace *trace, bool optimize)
 {
     TranslationBlock *tb;
     uint8_t *tc_ptr;
@@ -693,7 +743,25 @@ TranslationBlock *tb_gen_code(CPUState *env, target_ulong pc, target_ulong cs_ba
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
-    cpu_gen_code(env, tb, &code_gen_size, &search_size);
+    tb->exec_count = 0;
+    tb->hot_successor_votes = 0;
+    tb->superblock_attempts = 0;
+    tb->shadowed_superblock_icount = 0;
+    // the block header bumps the execution counter of the record, so it has to be there before the code is generated
+    tb->stats = NULL;
+    uint64_t translation_start = 0;
+    if (unlikely(env->tb_stats != NULL)) {
+        env->tb_stats->translations++;
+        tb->stats = tb_stats_new_record(env->tb_stats);
+        translation_start = tb_stats_get_time_ns();
+    }
+#ifdef USE_TCG_OPTIMIZATIONS
+    tb->optimized = optimize;
+#else
+    // there is nothing to gain from translating the block again
+    tb->optimized = true;
+#endif
+    cpu_gen_code(env, tb, trace, &code_gen_size, &search_size);
     code_gen_ptr = (void *)(((uintptr_t)code_gen_ptr + code_gen_size
         + search_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
 
@@ -707,9 +775,163 @@ TranslationBlock *tb_gen_code(CPUState *env, target_ulong pc, target_ulong cs_ba
         }
     }
     tb_link_page(tb, phys_pc, phys_page2);
+
+    if (unlikely(tb->stats != NULL)) {
+        tb->stats->pc = pc;
+        tb->stats->phys_pc = phys_pc;
+        tb->stats->translation_time_ns = tb_stats_get_time_ns() - translation_start;
+        tb->stats->host_code_size = code_gen_size;
+        tb->stats->guest_code_size = tb->size;
+        tb->stats->icount = tb->icount;
+        tb->stats->kind = (tb->optimized ? TB_STATS_KIND_OPTIMIZED : 0) | (tb->superblock ? TB_STATS_KIND_SUPERBLOCK : 0);
+    }
+    return tb;
+}
+
+TranslationBlock *tb_gen_code(CPUState *env, target_ulong pc, target_ulong cs_base, int flags, uint16_t cflags)
+{
+    return tb_gen_code_inner(env, pc, cs_base, flags, cflags, NULL, tiered_translation_threshold == 0);
+}
+
+/* Second tier of the tiered translation: translates a hot block again, this time with the TCG optimizer passes.
+   Both tiers are translated synchronously on the execution thread, only the cost of the first one is cut. */
+TranslationBlock *tb_gen_second_tier(CPUState *env, TranslationBlock *tb)
+{
+    target_ulong pc, cs_base;
+    uint64_t flags;
+    uint16_t cflags;
+
+    // a block that would get cut now is retried on one of the next lookups
+    if (tb->was_cut || tb->dirty_flag || tb->shadowed_superblock_icount != 0 || tb->icount > env->instructions_count_limit - env->instructions_count_value ||
+        env->tb_cache_disabled) {
+        return tb;
+    }
+
+    pc = tb->pc;
+    cs_base = tb->cs_base;
+    flags = tb->flags;
+    cflags = tb->cflags;
+    tb_stats_invalidated(tb->stats, TB_STATS_INVALIDATED_REPLACED);
+    tb_phys_invalidate(tb, -1);
+    tb = tb_gen_code_inner(env, pc, cs_base, flags, cflags, NULL, true);
+    env->tb_jmp_cache[tb_jmp_cache_hash_func(pc)] = tb;
+    // do not patch the jump of the block executed before, it may have been the invalidated one
+    tb_invalidated_flag = 1;
+    return tb;
+}
+
+// Successors reached by chaining are not necessarily in `tb_jmp_cache`, so they are looked up by their physical address
+static TranslationBlock *superblock_find_segment(TranslationBlock *head, target_ulong pc)
+{
+    TranslationBlock *tb;
+    tb_page_addr_t phys_pc;
+
+    if (pc < head->pc || (pc & TARGET_PAGE_MASK) != (head->pc & TARGET_PAGE_MASK)) {
+        return NULL;
+    }
+    phys_pc = head->page_addr[0] + (pc & ~TARGET_PAGE_MASK);
+    for (tb = tb_phys_hash[tb_phys_hash_func(phys_pc)]; tb != NULL; tb = tb->phys_hash_next) {
+        if (tb->pc == pc && tb->page_addr[0] == head->page_addr[0] && tb->cs_base == head->cs_base && tb->flags == head->flags) {
+            break;
+        }
+    }
+    if (tb == NULL || tb->superblock || tb->was_cut || tb->dirty_flag || tb->page_addr[1] != -1) {
+        return NULL;
+    }
     return tb;
 }
 
+// a block that is not worth it now is retried after another `superblock_threshold` executions, until it runs out of attempts
+static inline TranslationBlock *superblock_not_formed(TranslationBlock *head)
+{
+    head->superblock_attempts++;
+    head->exec_count = head->superblock_attempts < SUPERBLOCK_MAX_ATTEMPTS ? 0 : block_profiling_limit + 1;
+    return head;
+}
+
+/* Retranslates a hot block together with the blocks it most often chains to.
+   Returns the new superblock, or `head` if there is no trace worth forming yet. */
+TranslationBlock *tb_gen_superblock(CPUState *env, TranslationBlock *head)
+{
+    SuperblockTrace trace;
+    TranslationBlock *tb, *next;
+    target_ulong pc, cs_base;
+    uint64_t flags;
+    uint32_t budget = env->instructions_count_limit - env->instructions_count_value;
+    uint32_t icount = head->icount;
+
+    if (budget > maximum_block_size) {
+        budget = maximum_block_size;
+    }
+    if (budget > SUPERBLOCK_MAX_INSNS) {
+        budget = SUPERBLOCK_MAX_INSNS;
+    }
+
+    if (head->superblock || head->shadowed_superblock_icount != 0 || head->was_cut || head->dirty_flag || head->page_addr[1] != -1 ||
+        env->chaining_disabled || env->tb_cache_disabled || env->block_begin_hook_present || env->block_finished_hook_present ||
+        env->block_batch != NULL || !QTAILQ_EMPTY(&env->breakpoints)) {
+        return superblock_not_formed(head);
+    }
+
+    trace.segment_pc[0] = head->pc;
+    trace.segments_count = 1;
+    tb = head;
+    while (trace.segments_count < SUPERBLOCK_MAX_SEGMENTS) {
+        // only follow edges taken on about half of the executions or more
+        if (tb->hot_successor_votes < SUPERBLOCK_MIN_EDGE_VOTES || tb->hot_successor_votes * 2 < tb->exec_count) {
+            break;
+        }
+        next = superblock_find_segment(head, tb->hot_successor_pc);
+        if (next == NULL || icount + next->icount > budget) {
+            break;
+        }
+        trace.segment_pc[trace.segments_count++] = next->pc;
+        icount += next->icount;
+        tb = next;
+    }
+    if (trace.segments_count < 2) {
+        return superblock_not_formed(head);
+    }
+
+    pc = head->pc;
+    cs_base = head->cs_base;
+    flags = head->flags;
+    tb_stats_invalidated(head->stats, TB_STATS_INVALIDATED_REPLACED);
+    tb_phys_invalidate(head, -1);
+    tb = tb_gen_code_inner(env, pc, cs_base, flags, 0, &trace, true);
+    env->tb_jmp_cache[tb_jmp_cache_hash_func(pc)] = tb;
+    // do not patch the jump of the block executed before, it may have been the invalidated head
+    tb_invalidated_flag = 1;
+    return tb;
+}
+
+static bool tb_is_in_phys_hash(TranslationBlock *tb)
+{
+    tb_page_addr_t phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
+    TranslationBlock *tb1;
+
+    for (tb1 = tb_phys_hash[tb_phys_hash_func(phys_pc)]; tb1 != NULL; tb1 = tb1->phys_hash_next) {
+        if (tb1 == tb) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Superblocks are only formed while no block begin or end hook is installed, so they do not call them
+   between their segments. They have to be dropped when such a hook appears; regular blocks take their place. */
+void tb_invalidate_superblocks(CPUState *env)
+{
+    for (int i = 0; i < nb_tbs; ++i) {
+        TranslationBlock *tb = &tbs[i];
+        // invalidated blocks stay in `tbs` until the next flush
+        if (tb->superblock && tb_is_in_phys_hash(tb)) {
+            tb_stats_invalidated(tb->stats, TB_STATS_INVALIDATED_REPLACED);
+            tb_phys_invalidate(tb, -1);
+        }
+    }
+}
+
 void helper_mark_tbs_as_dirty(CPUState *env, target_ulong pc, int access_width, int broadcast)
 {
     int n;
@@ -742,6 +964,15 @@ void helper_mark_tbs_as_dirty(CPUState *env, target_ulong pc, int access_width,
         append_dirty_address(masked_address);
     }
 
+    // Data stored next to code is common, so after a few writes the page gets a bitmap of its code bytes
+    // and the stores that miss them no longer walk the list of the blocks
+    if (!p->code_bitmap && ++p->code_write_count >= SMC_BITMAP_USE_THRESHOLD) {
+        build_page_bitmap(p);
+    }
+    if (p->code_bitmap && !page_bitmap_has_code(p, phys_pc & ~TARGET_PAGE_MASK, access_width)) {
+        return;
+    }
+
     // Below code is a simplified version of the `tb_invalidate_phys_page_range_inner` search
     tb = p->first_tb;
     while (tb != NULL) {
@@ -752,6 +983,8 @@ void helper_mark_tbs_as_dirty(CPUState *env, target_ulong pc, int access_width,
         tb_end = tb_start + tb->size;
         if ((tb_start <= phys_pc && phys_pc < tb_end) || (phys_pc <= tb_start && tb_start < phys_pc + access_width)) {
             tb->dirty_flag = true;
+            // makes the block header call `prepare_block_for_execution`, which invalidates the block
+            tb->exec_count = 0;
         }
         tb = tb_next;
     }
@@ -834,6 +1067,7 @@ void tb_invalidate_phys_page_range_inner(tb_page_addr_t start, tb_page_addr_t en
                 saved_tb = env->current_tb;
                 env->current_tb = NULL;
             }
+            tb_stats_invalidated(tb->stats, TB_STATS_INVALIDATED_CODE_WRITE);
             tb_phys_invalidate(tb, -1);
             if (env) {
                 env->current_tb = saved_tb;
@@ -871,6 +1105,31 @@ void tb_invalidate_phys_page_range(tb_page_addr_t start, tb_page_addr_t end, int
     tb_invalidate_phys_page_range_inner(start, end, is_cpu_write_access, 1);
 }
 
+static int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* invalidate whole pages containing the given addresses, e.g. the ones broadcast as dirty by other cores;
+   the array is sorted in place so that each page is handled once */
+void tb_invalidate_phys_pages(uint64_t *addresses, uint64_t count)
+{
+    uint64_t i;
+    tb_page_addr_t page, last_page = -1;
+
+    qsort(addresses, count, sizeof(uint64_t), compare_uint64);
+    for (i = 0; i < count; i++) {
+        page = addresses[i] & TARGET_PAGE_MASK;
+        if (page == last_page) {
+            continue;
+        }
+        last_page = page;
+        tb_invalidate_phys_page_range_inner(page, page + TARGET_PAGE_SIZE, false, false);
+    }
+}
+
 /* len must be <= 8 and start must be a multiple of len */
 static inline void tb_invalidate_phys_page_fast(tb_page_addr_t start, int len)
 {
@@ -903,7 +1162,11 @@ static inline void tb_alloc_page(TranslationBlock *tb, unsigned int n, tb_page_a
     tb->page_next[n] = p->first_tb;
     page_already_protected = p->first_tb != NULL;
     p->first_tb = (TranslationBlock *)((uintptr_t)tb | n);
-    invalidate_page_bitmap(p);
+    /* keep the bitmap of a page that mixes code and data instead of
+       walking the TB list on its next writes again */
+    if (p->code_bitmap) {
+        set_page_bitmap_bits(p, tb, n);
+    }
 
     /* if some code is already present, then the pages are already
        protected. So we handle the case where only the first TB is
@@ -1046,6 +1309,7 @@ void interrupt_current_translation_block(CPUState *env, int exeception_type)
     }
 
     cpu_get_tb_cpu_state(cpu, &pc, &cs_base, &cpu_flags);
+    tb_stats_invalidated(cpu->current_tb->stats, TB_STATS_INVALIDATED_INTERRUPTED);
     tb_phys_invalidate(cpu->current_tb, -1);
     tb_gen_code(cpu, pc, cs_base, cpu_flags, 0);
 
@@ -1162,11 +1426,118 @@ void cpu_abort(CPUState *env, const char *fmt, ...)
     tlib_abort(s);
 }
 
+static int compare_target_ulong(const void *a, const void *b)
+{
+    target_ulong x = *(const target_ulong *)a;
+    target_ulong y = *(const target_ulong *)b;
+    return (x > y) - (x < y);
+}
+
+static void rebuild_external_mmu_index(CPUState *env)
+{
+    ExtMmuRange *mmu_window = env->external_mmu_window;
+    ExtMmuSegment *segments = env->external_mmu_segments;
+    target_ulong boundaries[MAX_EXTERNAL_MMU_SEGMENTS];
+    int windows_count = 0;
+    int boundaries_count = 0;
+    int segments_count = 0;
+    int i, j, type;
+
+    // The lookup stops at the first inactive window, so only the active prefix is indexed
+    while (windows_count < MAX_EXTERNAL_MMU_RANGES && mmu_window[windows_count].active) {
+        if (mmu_window[windows_count].range_start < mmu_window[windows_count].range_end) {
+            boundaries[boundaries_count++] = mmu_window[windows_count].range_start;
+            boundaries[boundaries_count++] = mmu_window[windows_count].range_end;
+        }
+        windows_count++;
+    }
+
+    qsort(boundaries, boundaries_count, sizeof(target_ulong), compare_target_ulong);
+    for (i = 0; i < boundaries_count; i++) {
+        if (segments_count == 0 || segments[segments_count - 1].start != boundaries[i]) {
+            segments[segments_count].start = boundaries[i];
+            segments[segments_count].window[ACCESS_DATA_LOAD] = -1;
+            segments[segments_count].window[ACCESS_DATA_STORE] = -1;
+            segments[segments_count].window[ACCESS_INST_FETCH] = -1;
+            segments_count++;
+        }
+    }
+
+    // Windows are visited in index order, so on overlaps the lowest index wins, as in a linear scan
+    for (i = 0; i < windows_count; i++) {
+        if (mmu_window[i].range_start >= mmu_window[i].range_end) {
+            continue;
+        }
+        int low = 0;
+        int high = segments_count - 1;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (segments[middle].start < mmu_window[i].range_start) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        for (j = low; j < segments_count && segments[j].start < mmu_window[i].range_end; j++) {
+            for (type = ACCESS_DATA_LOAD; type <= ACCESS_INST_FETCH; type++) {
+                if ((mmu_window[i].type & (1 << type)) && segments[j].window[type] == -1) {
+                    segments[j].window[type] = i;
+                }
+            }
+        }
+    }
+
+    // Merge neighbours served by the same windows to keep the search space small
+    j = 0;
+    for (i = 1; i < segments_count; i++) {
+        if (memcmp(segments[i].window, segments[j].window, sizeof(segments[j].window)) != 0) {
+            segments[++j] = segments[i];
+        }
+    }
+
+    env->external_mmu_segments_count = segments_count == 0 ? 0 : j + 1;
+    env->external_mmu_index_valid = true;
+    memset(env->external_mmu_last_segment, 0, sizeof(env->external_mmu_last_segment));
+}
+
+static int find_external_mmu_window(CPUState *env, target_ulong address, int access_type)
+{
+    ExtMmuSegment *segments = env->external_mmu_segments;
+    uint32_t count;
+    uint32_t index;
+
+    if (unlikely(!env->external_mmu_index_valid)) {
+        rebuild_external_mmu_index(env);
+    }
+    count = env->external_mmu_segments_count;
+
+    // The last segment always ends the highest window, so it never maps anything
+    index = env->external_mmu_last_segment[access_type];
+    if (index + 1 < count && segments[index].start <= address && address < segments[index + 1].start) {
+        return segments[index].window[access_type];
+    }
+
+    if (count == 0 || address < segments[0].start) {
+        return -1;
+    }
+    uint32_t low = 0;
+    uint32_t high = count - 1;
+    while (low < high) {
+        uint32_t middle = (low + high + 1) / 2;
+        if (segments[middle].start <= address) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    env->external_mmu_last_segment[access_type] = low;
+    return segments[low].window[access_type];
+}
+
 int get_external_mmu_phys_addr(CPUState *env, uint32_t address, int access_type,
                                                               target_phys_addr_t *phys_ptr, int *prot, int no_page_fault)
 {
-    bool found = false;
-    int window_index = 0;
+    int window_index;
     ExtMmuRange *mmu_window = env->external_mmu_window;
     uint32_t access_type_mask = 0;
     switch (access_type) {
@@ -1187,18 +1558,9 @@ int get_external_mmu_phys_addr(CPUState *env, uint32_t address, int access_type,
     *phys_ptr = address;
     *prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
 
-    for (; window_index < MAX_EXTERNAL_MMU_RANGES; window_index++) {
-        if (!mmu_window[window_index].active) {
-            break;
-        } else if ((mmu_window[window_index].type & access_type_mask) &&
-                   (address >= mmu_window[window_index].range_start) &&
-                   (address < mmu_window[window_index].range_end)) {
-            found = true;
-            break;
-        }
-    }
+    window_index = find_external_mmu_window(env, address, access_type);
 
-    if (found) {
+    if (window_index != -1) {
         *phys_ptr += mmu_window[window_index].addend;
         *prot = mmu_window[window_index].priv;
         if (*prot & access_type_mask) {
@@ -1211,7 +1573,7 @@ int get_external_mmu_phys_addr(CPUState *env, uint32_t address, int access_type,
         // The exit_request needs to be set to prevent the cpu_exec from trying to execute the block
         cpu->exit_request = 1;
         cpu->mmu_fault = true;
-        tlib_mmu_fault_external_handler(address, access_type, found ? window_index : -1);
+        tlib_mmu_fault_external_handler(address, access_type, window_index);
         if(access_type != ACCESS_INST_FETCH && cpu->current_tb != NULL)
         {
             interrupt_current_translation_block(cpu, MMU_EXTERNAL_FAULT);
@@ -1237,6 +1599,14 @@ static CPUTLBEntry s_cputlb_empty_entry = {
     .addr_read = -1, .addr_write = -1, .addr_code  = -1, .addend     = -1,
 };
 
+static void tlb_clear_tables(CPUState *env)
+{
+    for (int mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        memset(env->tlb_table[mmu_idx], 0xFF, (1 << env->tlb_size_bits) * sizeof(CPUTLBEntry));
+    }
+    memset(env->tlb_v_table, 0xFF, sizeof(env->tlb_v_table));
+}
+
 /* NOTE: if flush_global is true, also flush global entries (not
    implemented yet) */
 void tlb_flush(CPUState *env, int flush_global, bool from_generated_code)
@@ -1247,15 +1617,71 @@ void tlb_flush(CPUState *env, int flush_global, bool from_generated_code)
         env->current_tb = NULL;
     }
 
-    memset(env->tlb_table, 0xFF, CPU_TLB_SIZE * NB_MMU_MODES * sizeof (CPUTLBEntry));
+    tlb_clear_tables(env);
 
     memset(env->tb_jmp_cache, 0, TB_JMP_CACHE_SIZE * sizeof (void *));
 
+    /* A table that was barely refilled since the previous flush can shrink back */
+    if (env->tlb_dynamic_resize && env->tlb_size_bits > env->tlb_base_size_bits &&
+        env->tlb_fills_since_flush < ((1u << env->tlb_size_bits) >> 3) && !env->tlb_resize_pending_bits) {
+        env->tlb_resize_pending_bits = env->tlb_size_bits - 1;
+    }
+    env->tlb_fills_since_flush = 0;
+
     env->tlb_flush_addr = -1;
     env->tlb_flush_mask = 0;
     tlb_flush_count++;
 }
 
+/* The TLB can't change its size while a memory access helper holds an index into it,
+   so new sizes are only requested and then applied here, between blocks. */
+void tlb_apply_pending_resize(CPUState *env)
+{
+    tlb_set_size_bits(env, env->tlb_resize_pending_bits);
+    env->tlb_resize_pending_bits = 0;
+    env->tlb_fills_since_flush = 0;
+    /* Entries are indexed with the new mask from now on */
+    tlb_clear_tables(env);
+}
+
+void tlb_request_resize(CPUState *env, uint32_t bits)
+{
+    if (bits < CPU_TLB_MIN_BITS) {
+        bits = CPU_TLB_MIN_BITS;
+    } else if (bits > CPU_TLB_MAX_BITS) {
+        bits = CPU_TLB_MAX_BITS;
+    }
+    env->tlb_base_size_bits = bits;
+    env->tlb_resize_pending_bits = bits != env->tlb_size_bits ? bits : 0;
+}
+
+/* Called after a miss in the main TLB. On a hit in the victim TLB its entry is swapped
+   with the one at 'index', so the caller can simply retry the lookup. 'elt_ofs' selects
+   the CPUTLBEntry field matching the access type. */
+bool tlb_victim_hit(CPUState *env, int mmu_idx, int index, size_t elt_ofs, target_ulong page)
+{
+    env->tlb_miss_count++;
+    for (int vidx = 0; vidx < CPU_VTLB_SIZE; vidx++) {
+        CPUTLBEntry *vtlb = &env->tlb_v_table[mmu_idx][vidx];
+        target_ulong cmp = *(target_ulong *)((uintptr_t)vtlb + elt_ofs);
+
+        /* TLB_ONE_SHOT entries have to go through tlb_fill again */
+        if ((cmp & (TARGET_PAGE_MASK | TLB_INVALID_MASK)) == page && !(cmp & TLB_ONE_SHOT)) {
+            CPUTLBEntry tmp_entry = *vtlb;
+            *vtlb = env->tlb_table[mmu_idx][index];
+            env->tlb_table[mmu_idx][index] = tmp_entry;
+
+            target_phys_addr_t tmp_iotlb = env->iotlb_v[mmu_idx][vidx];
+            env->iotlb_v[mmu_idx][vidx] = env->iotlb[mmu_idx][index];
+            env->iotlb[mmu_idx][index] = tmp_iotlb;
+
+            env->tlb_victim_hit_count++;
+            return true;
+        }
+    }
+    return false;
+}
+
 static inline void tlb_flush_entry(CPUTLBEntry *tlb_entry, target_ulong addr)
 {
     if (addr == (tlb_entry->addr_read & (TARGET_PAGE_MASK | TLB_INVALID_MASK)) ||
@@ -1273,7 +1699,8 @@ void tlb_flush_masked(CPUState *env, uint32_t mmu_indexes_mask)
 
     for (int mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx += 1) {
         if (extract32(mmu_indexes_mask, mmu_idx, 1)) {
-            memset(&env->tlb_table[mmu_idx], 0xFF, CPU_TLB_SIZE * sizeof(CPUTLBEntry));
+            memset(env->tlb_table[mmu_idx], 0xFF, (1 << env->tlb_size_bits) * sizeof(CPUTLBEntry));
+            memset(env->tlb_v_table[mmu_idx], 0xFF, sizeof(env->tlb_v_table[mmu_idx]));
         }
     }
 
@@ -1298,10 +1725,13 @@ void tlb_flush_page_masked(CPUState *env, target_ulong addr, uint32_t mmu_indexe
     }
 
     addr &= TARGET_PAGE_MASK;
-    i = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    i = CPU_TLB_INDEX(env, addr);
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx += 1) {
         if (extract32(mmu_indexes_mask, mmu_idx, 1)) {
             tlb_flush_entry(&env->tlb_table[mmu_idx][i], addr);
+            for (int vidx = 0; vidx < CPU_VTLB_SIZE; vidx++) {
+                tlb_flush_entry(&env->tlb_v_table[mmu_idx][vidx], addr);
+            }
         }
     }
 
@@ -1347,9 +1777,12 @@ static inline void tlb_set_dirty(CPUState *env, target_ulong vaddr)
     int mmu_idx;
 
     vaddr &= TARGET_PAGE_MASK;
-    i = (vaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    i = CPU_TLB_INDEX(env, vaddr);
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         tlb_set_dirty1(&env->tlb_table[mmu_idx][i], vaddr);
+        for (int vidx = 0; vidx < CPU_VTLB_SIZE; vidx++) {
+            tlb_set_dirty1(&env->tlb_v_table[mmu_idx][vidx], vaddr);
+        }
     }
 }
 
@@ -1367,11 +1800,14 @@ static void tlb_protect_code(ram_addr_t ram_addr)
 
     int mmu_idx;
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        for (i = 0; i < CPU_TLB_SIZE; i++) {
+        for (i = 0; i < (1 << cpu->tlb_size_bits); i++) {
             /* we modify the TLB entries so that the dirty bit will be set again
             when accessing the range */
             tlb_reset_dirty_range(&cpu->tlb_table[mmu_idx][i], start1, TARGET_PAGE_SIZE);
         }
+        for (i = 0; i < CPU_VTLB_SIZE; i++) {
+            tlb_reset_dirty_range(&cpu->tlb_v_table[mmu_idx][i], start1, TARGET_PAGE_SIZE);
+        }
     }
 }
 
@@ -1421,6 +1857,40 @@ static inline int is_io_accessed(CPUState *env, target_ulong vaddr)
     return 0;
 }
 
+static inline bool tlb_entry_is_valid(CPUTLBEntry *tlb_entry)
+{
+    return tlb_entry->addr_read != -1 || tlb_entry->addr_write != -1 || tlb_entry->addr_code != -1;
+}
+
+/* Makes room for the translation of 'vaddr' at 'index' of the main TLB. A live entry for
+   another page is moved to the victim TLB, and when a window of fills keeps doing that
+   the main TLB is asked to grow. */
+static inline void tlb_evict_to_victim(CPUState *env, int mmu_idx, unsigned int index, target_ulong vaddr)
+{
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+
+    env->tlb_fills_since_flush++;
+    env->tlb_window_fills++;
+    if (tlb_entry_is_valid(te)) {
+        target_ulong te_addr = te->addr_read != -1 ? te->addr_read : te->addr_write != -1 ? te->addr_write : te->addr_code;
+        if ((te_addr & TARGET_PAGE_MASK) != (vaddr & TARGET_PAGE_MASK)) {
+            int vidx = env->vtlb_index[mmu_idx]++ % CPU_VTLB_SIZE;
+            env->tlb_v_table[mmu_idx][vidx] = *te;
+            env->iotlb_v[mmu_idx][vidx] = env->iotlb[mmu_idx][index];
+            env->tlb_window_evictions++;
+        }
+    }
+
+    if (env->tlb_window_fills >= (1u << env->tlb_size_bits)) {
+        if (env->tlb_dynamic_resize && env->tlb_size_bits < CPU_TLB_MAX_BITS &&
+            env->tlb_window_evictions > (env->tlb_window_fills >> 1) && !env->tlb_resize_pending_bits) {
+            env->tlb_resize_pending_bits = env->tlb_size_bits + 1;
+        }
+        env->tlb_window_fills = 0;
+        env->tlb_window_evictions = 0;
+    }
+}
+
 /* Add a new TLB entry. At most one entry for a given virtual address
    is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
    supplied size is only used by tlb_flush_page.  */
@@ -1492,9 +1962,10 @@ void tlb_set_page(CPUState *env, target_ulong vaddr, target_phys_addr_t paddr, i
         address |= TLB_MMIO;
     }
 
-    index = (vaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
-    env->iotlb[mmu_idx][index] = iotlb - vaddr;
+    index = CPU_TLB_INDEX(env, vaddr);
     te = &env->tlb_table[mmu_idx][index];
+    tlb_evict_to_victim(env, mmu_idx, index, vaddr);
+    env->iotlb[mmu_idx][index] = iotlb - vaddr;
     te->addend = addend - vaddr;
     if (prot & PAGE_READ) {
         te->addr_read = address;
@@ -1637,6 +2108,75 @@ void notdirty_mem_writel(void *opaque, target_phys_addr_t ram_addr, uint32_t val
     }
 }
 
+static inline bool is_ram_page(ram_addr_t pd, bool is_write)
+{
+    if (is_write) {
+        return (pd & ~TARGET_PAGE_MASK) == IO_MEM_RAM;
+    }
+    return !((pd & ~TARGET_PAGE_MASK) > IO_MEM_ROM && !(pd & IO_MEM_ROMD));
+}
+
+/* Returns the host pointer to the RAM at `addr`, whose page descriptor is `pd`, and trims `*len` to the part
+   of it that is contiguous both in the host memory and in the guest physical RAM pages following it */
+static uint8_t *get_ram_span(target_phys_addr_t addr, ram_addr_t pd, uint64_t *len, bool is_write)
+{
+    ram_addr_t ram_addr = (pd & TARGET_PAGE_MASK) + (addr & ~TARGET_PAGE_MASK);
+    uint64_t host_size;
+    uint8_t *ptr = tlib_guest_offset_to_host_span(ram_addr, &host_size);
+    /* a single page is always backed by a single host block */
+    uint64_t span = TARGET_PAGE_SIZE - (addr & ~TARGET_PAGE_MASK);
+
+    while (span < *len && span < host_size) {
+        PhysPageDesc *p = phys_page_find((addr + span) >> TARGET_PAGE_BITS);
+        if (p == NULL || !is_ram_page(p->phys_offset, is_write) || (p->phys_offset & TARGET_PAGE_MASK) != ram_addr + span) {
+            break;
+        }
+        span += TARGET_PAGE_SIZE;
+    }
+    if (span < *len) {
+        *len = span;
+    }
+    return ptr;
+}
+
+/* Splits the guest physical range into spans of RAM contiguous in the host memory and spans of anything else,
+   which have `host_pointer` set to NULL. Returns the number of spans written to `spans`; if it is `max_spans`,
+   the range may continue past the last one.
+   Writes through the returned pointers don't invalidate the translated code. */
+uint32_t get_host_memory_spans(target_phys_addr_t addr, uint64_t size, HostMemorySpan *spans, uint32_t max_spans)
+{
+    uint32_t count = 0;
+    PhysPageDesc *p;
+    ram_addr_t pd;
+
+    while (size > 0 && count < max_spans) {
+        HostMemorySpan *span = &spans[count++];
+        span->address = addr;
+        span->size = size;
+        p = phys_page_find(addr >> TARGET_PAGE_BITS);
+        pd = p ? p->phys_offset : IO_MEM_UNASSIGNED;
+        if (is_ram_page(pd, false)) {
+            span->host_pointer = get_ram_span(addr, pd, &span->size, false);
+        } else {
+            span->host_pointer = NULL;
+            span->size = TARGET_PAGE_SIZE - (addr & ~TARGET_PAGE_MASK);
+            while (span->size < size) {
+                p = phys_page_find((addr + span->size) >> TARGET_PAGE_BITS);
+                if (p != NULL && is_ram_page(p->phys_offset, false)) {
+                    break;
+                }
+                span->size += TARGET_PAGE_SIZE;
+            }
+            if (span->size > size) {
+                span->size = size;
+            }
+        }
+        addr += span->size;
+        size -= span->size;
+    }
+    return count;
+}
+
 /* physical memory access (slow version, mainly for debug) */
 void cpu_physical_memory_rw(target_phys_addr_t addr, uint8_t *buf, int len, int is_write)
 {
@@ -1670,6 +2210,7 @@ void cpu_physical_memory_rw(target_phys_addr_t addr, uint8_t *buf, int len, int
                     /* 64 bit write access */
                     val = ldq_p(buf);
                     tlib_write_quad_word(addr1, val);
+                    l = 8;
                 } else if (l >= 4 && ((addr1 & 3) == 0)) {
                     /* 32 bit write access */
                     val = ldl_p(buf);
@@ -1689,12 +2230,22 @@ void cpu_physical_memory_rw(target_phys_addr_t addr, uint8_t *buf, int len, int
             } else {
                 uintptr_t addr1;
                 addr1 = (pd & TARGET_PAGE_MASK) + (addr & ~TARGET_PAGE_MASK);
-                /* RAM case */
-                ptr = get_ram_ptr(addr1);
-                memcpy(ptr, buf, l);
-                if (!p->phys_dirty) {
-                    /* invalidate code */
-                    tb_invalidate_phys_page_range(addr1, addr1 + l, 1);
+                /* RAM case, copied together with the RAM pages following it */
+                uint64_t span = len;
+                ptr = get_ram_span(addr, pd, &span, true);
+                memcpy(ptr, buf, span);
+                l = span;
+                for (uint64_t offset = 0; offset < span;) {
+                    uint64_t page_len = TARGET_PAGE_SIZE - ((addr1 + offset) & ~TARGET_PAGE_MASK);
+                    if (page_len > span - offset) {
+                        page_len = span - offset;
+                    }
+                    p = phys_page_find((addr + offset) >> TARGET_PAGE_BITS);
+                    if (!p->phys_dirty) {
+                        /* invalidate code */
+                        tb_invalidate_phys_page_range(addr1 + offset, addr1 + offset + page_len, 1);
+                    }
+                    offset += page_len;
                 }
             }
         } else {
@@ -1726,9 +2277,11 @@ void cpu_physical_memory_rw(target_phys_addr_t addr, uint8_t *buf, int len, int
                     l = 1;
                 }
             } else {
-                /* RAM case */
-                ptr = get_ram_ptr(pd & TARGET_PAGE_MASK);
-                memcpy(buf, ptr + (addr & ~TARGET_PAGE_MASK), l);
+                /* RAM case, copied together with the RAM pages following it */
+                uint64_t span = len;
+                ptr = get_ram_span(addr, pd, &span, false);
+                memcpy(buf, ptr, span);
+                l = span;
             }
         }
         len -= l;
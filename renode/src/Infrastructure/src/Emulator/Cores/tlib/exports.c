@@ -25,6 +25,9 @@
 #include "exec-all.h"
 #include "tb-helper.h"
 #include "unwind.h"
+#include "memory_trace.h"
+#include "sampling_profiler.h"
+#include "tb_stats.h"
 
 #include "exports.h"
 
@@ -56,6 +59,7 @@ static void init_tcg()
                               offsetof(CPUState, tlb_table[i][0].addend));
         set_tlb_table_n_0(i, offsetof(CPUState, tlb_table[i][0]));
     }
+    set_tlb_mask_offset(offsetof(CPUState, tlb_mask));
     set_tlb_entry_addr_rwu(offsetof(CPUTLBEntry, addr_read), offsetof(CPUTLBEntry, addr_write), offsetof(CPUTLBEntry, addend));
     set_sizeof_CPUTLBEntry(sizeof(CPUTLBEntry));
     set_TARGET_PAGE_BITS(TARGET_PAGE_BITS);
@@ -175,6 +179,108 @@ uint32_t tlib_get_maximum_block_size()
 
 EXC_INT_0(uint32_t, tlib_get_maximum_block_size)
 
+uint32_t superblock_threshold;
+uint32_t tiered_translation_threshold;
+uint32_t block_profiling_limit;
+
+static void update_block_profiling_limit()
+{
+    block_profiling_limit = tiered_translation_threshold;
+#ifdef SUPPORTS_SUPERBLOCKS
+    if (superblock_threshold > block_profiling_limit) {
+        block_profiling_limit = superblock_threshold;
+    }
+#endif
+}
+
+// Number of executions after which a block is retranslated into a superblock, 0 disables superblocks
+void tlib_set_superblock_threshold(uint32_t threshold)
+{
+    superblock_threshold = threshold;
+    update_block_profiling_limit();
+}
+
+EXC_VOID_1(tlib_set_superblock_threshold, uint32_t, threshold)
+
+uint32_t tlib_get_superblock_threshold()
+{
+    return superblock_threshold;
+}
+
+EXC_INT_0(uint32_t, tlib_get_superblock_threshold)
+
+// Number of executions after which a block is translated again with the TCG optimizer passes,
+// 0 runs them on every block right away
+void tlib_set_tiered_translation_threshold(uint32_t threshold)
+{
+    tiered_translation_threshold = threshold;
+    update_block_profiling_limit();
+}
+
+EXC_VOID_1(tlib_set_tiered_translation_threshold, uint32_t, threshold)
+
+uint32_t tlib_get_tiered_translation_threshold()
+{
+    return tiered_translation_threshold;
+}
+
+EXC_INT_0(uint32_t, tlib_get_tiered_translation_threshold)
+
+// Sets the number of main TLB entries per MMU mode to 2^bits, clamped to the range supported by the host backend.
+// The new size takes effect before the next block is executed.
+void tlib_set_tlb_size_bits(uint32_t bits)
+{
+    tlb_request_resize(cpu, bits);
+}
+
+EXC_VOID_1(tlib_set_tlb_size_bits, uint32_t, bits)
+
+uint32_t tlib_get_tlb_size_bits()
+{
+    return cpu->tlb_size_bits;
+}
+
+EXC_INT_0(uint32_t, tlib_get_tlb_size_bits)
+
+// When enabled, the main TLB grows if most fills evict live entries and shrinks back
+// towards the size set with `tlib_set_tlb_size_bits` if it's barely used between flushes
+void tlib_set_tlb_dynamic_resize(uint32_t enabled)
+{
+    cpu->tlb_dynamic_resize = !!enabled;
+}
+
+EXC_VOID_1(tlib_set_tlb_dynamic_resize, uint32_t, enabled)
+
+uint32_t tlib_get_tlb_dynamic_resize()
+{
+    return cpu->tlb_dynamic_resize;
+}
+
+EXC_INT_0(uint32_t, tlib_get_tlb_dynamic_resize)
+
+// Number of accesses that missed the main TLB, including the ones then found in the victim TLB
+uint64_t tlib_get_tlb_miss_count()
+{
+    return cpu->tlb_miss_count;
+}
+
+EXC_INT_0(uint64_t, tlib_get_tlb_miss_count)
+
+uint64_t tlib_get_tlb_victim_hit_count()
+{
+    return cpu->tlb_victim_hit_count;
+}
+
+EXC_INT_0(uint64_t, tlib_get_tlb_victim_hit_count)
+
+void tlib_reset_tlb_counters()
+{
+    cpu->tlb_miss_count = 0;
+    cpu->tlb_victim_hit_count = 0;
+}
+
+EXC_VOID_0(tlib_reset_tlb_counters)
+
 void tlib_set_cycles_per_instruction(uint32_t count)
 {
     env->cycles_per_instruction = count;
@@ -202,6 +308,8 @@ int32_t tlib_init(char *cpu_name)
         return -1;
     }
     tlib_set_maximum_block_size(TCG_MAX_INSNS);
+    tlib_set_superblock_threshold(SUPERBLOCK_DEFAULT_THRESHOLD);
+    tlib_set_tiered_translation_threshold(TIERED_TRANSLATION_DEFAULT_THRESHOLD);
     env->atomic_memory_state = NULL;
     return 0;
 }
@@ -219,6 +327,18 @@ EXC_VOID_2(tlib_atomic_memory_state_init, int, id, uintptr_t, atomic_memory_stat
 
 void tlib_dispose()
 {
+    if (cpu->memory_trace != NULL) {
+        memory_trace_destroy(cpu->memory_trace);
+    }
+    if (cpu->block_batch != NULL) {
+        tlib_free(cpu->block_batch);
+    }
+    if (cpu->sampling_profiler != NULL) {
+        sampling_profiler_destroy(cpu->sampling_profiler);
+    }
+    if (cpu->tb_stats != NULL) {
+        tb_stats_destroy(cpu->tb_stats);
+    }
     tlib_arch_dispose();
     code_gen_free();
     free_all_page_descriptors();
@@ -279,11 +399,21 @@ int32_t tlib_execute(uint32_t max_insns)
         tlib_abortf("Tried to execute cpu without reading executed instructions count first.");
     }
     cpu->instructions_count_limit = max_insns;
+    if (cpu->sampling_profiler != NULL) {
+        // the limit is set anew, also after a previous call was unwound while armed
+        cpu->sampling_profiler->withheld = 0;
+    }
 
     uint32_t local_counter = 0;
     int32_t result = EXCP_INTERRUPT;
     while ((result == EXCP_INTERRUPT) && (cpu->instructions_count_limit > 0)) {
+        if (cpu->sampling_profiler != NULL) {
+            sampling_profiler_arm(cpu);
+        }
         result = cpu_exec(cpu);
+        if (cpu->sampling_profiler != NULL) {
+            sampling_profiler_disarm(cpu);
+        }
 
         local_counter += cpu->instructions_count_value;
         cpu->instructions_count_limit -= cpu->instructions_count_value;
@@ -301,6 +431,16 @@ int32_t tlib_execute(uint32_t max_insns)
     // to read the progress
     cpu->instructions_count_value = local_counter;
 
+    if (cpu->memory_trace != NULL) {
+        memory_trace_flush(cpu->memory_trace);
+    }
+    if (cpu->block_batch != NULL) {
+        flush_block_batch(cpu);
+    }
+    if (cpu->sampling_profiler != NULL) {
+        sampling_profiler_flush(cpu);
+    }
+
     return result;
 }
 
@@ -398,6 +538,32 @@ void tlib_invalidate_translation_blocks(uintptr_t start, uintptr_t end)
 
 EXC_VOID_2(tlib_invalidate_translation_blocks, uintptr_t, start, uintptr_t, end)
 
+// Fills `spans`, an array of `max_spans` `HostMemorySpan`s, with the host memory backing the guest physical range;
+// see `get_host_memory_spans`. After writing through the pointers `tlib_invalidate_translation_blocks` has to be called.
+uint32_t tlib_get_host_memory_spans(uint64_t address, uint64_t size, void *spans, uint32_t max_spans)
+{
+    return get_host_memory_spans(address, size, (HostMemorySpan *)spans, max_spans);
+}
+
+EXC_INT_4(uint32_t, tlib_get_host_memory_spans, uint64_t, address, uint64_t, size, void *, spans, uint32_t, max_spans)
+
+// Performs the accesses described by an array of `count` `PhysicalMemoryVector`s. Runs of RAM pages are copied at once,
+// the rest goes through the bus like the guest accesses.
+void tlib_physical_memory_rw_vectored(void *vectors, uint32_t count, uint32_t is_write)
+{
+    PhysicalMemoryVector *vector = (PhysicalMemoryVector *)vectors;
+    for (uint32_t i = 0; i < count; i++, vector++) {
+        uint64_t done = 0;
+        while (done < vector->size) {
+            int len = vector->size - done > INT_MAX ? INT_MAX : vector->size - done;
+            cpu_physical_memory_rw(vector->address + done, (uint8_t *)vector->buffer + done, len, is_write);
+            done += len;
+        }
+    }
+}
+
+EXC_VOID_3(tlib_physical_memory_rw_vectored, void *, vectors, uint32_t, count, uint32_t, is_write)
+
 uint64_t tlib_translate_to_physical_address(uint64_t address, uint32_t access_type)
 {
     uint64_t ret = virt_to_phys(address, access_type, 1);
@@ -459,6 +625,39 @@ void tlib_invalidate_translation_cache()
 
 EXC_VOID_0(tlib_invalidate_translation_cache)
 
+// Returns 1 if the library was built with the TCG optimizer passes (the TCG_OPTIMIZATIONS option), 0 otherwise
+uint32_t tlib_has_tcg_optimizer()
+{
+#ifdef USE_TCG_OPTIMIZATIONS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+EXC_INT_0(uint32_t, tlib_has_tcg_optimizer)
+
+// Copies up to `count` TCG optimizer counters, ordered as in `TCGOptimizerCounter`,
+// into `values` and returns the number of counters copied
+uint32_t tlib_get_tcg_optimizer_counters(uint64_t *values, uint32_t count)
+{
+    if(count > TCG_OPT_COUNTERS_COUNT)
+    {
+        count = TCG_OPT_COUNTERS_COUNT;
+    }
+    memcpy(values, tcg->ctx->optimizer_counters, count * sizeof(uint64_t));
+    return count;
+}
+
+EXC_INT_2(uint32_t, tlib_get_tcg_optimizer_counters, uint64_t *, values, uint32_t, count)
+
+void tlib_reset_tcg_optimizer_counters()
+{
+    memset(tcg->ctx->optimizer_counters, 0, sizeof(tcg->ctx->optimizer_counters));
+}
+
+EXC_VOID_0(tlib_reset_tcg_optimizer_counters)
+
 int tlib_restore_context()
 {
     uintptr_t pc;
@@ -528,6 +727,9 @@ EXC_INT_0(uint32_t, tlib_get_tb_cache_enabled)
 
 void tlib_set_block_finished_hook_present(uint32_t val)
 {
+    if (cpu->block_finished_hook_present != !!val) {
+        tb_invalidate_superblocks(cpu);
+    }
     cpu->block_finished_hook_present = !!val;
 }
 
@@ -535,11 +737,101 @@ EXC_VOID_1(tlib_set_block_finished_hook_present, uint32_t, val)
 
 void tlib_set_block_begin_hook_present(uint32_t val)
 {
+    // e.g. single-stepping or inactive breakpoint hooks need the hook, but do not clear the translation cache
+    if (cpu->block_begin_hook_present != !!val) {
+        tb_invalidate_superblocks(cpu);
+    }
     cpu->block_begin_hook_present = !!val;
 }
 
 EXC_VOID_1(tlib_set_block_begin_hook_present, uint32_t, val)
 
+static void free_block_batch(void)
+{
+    flush_block_batch(cpu);
+    tlib_free(cpu->block_batch);
+    cpu->block_batch = cpu->block_batch_next = cpu->block_batch_end = NULL;
+}
+
+// Makes the block header append (pc, icount) to a buffer of `capacity` entries instead of calling a hook.
+// The buffer is passed to `tlib_on_block_begin_batch` when it gets full and at the end of `tlib_execute`.
+// Unlike `tlib_on_block_begin`, this can't stop the execution, so it's meant for hooks that only observe it.
+uint32_t tlib_enable_block_begin_batching(uint32_t capacity)
+{
+    if (capacity == 0) {
+        return 0;
+    }
+    if (cpu->block_batch != NULL) {
+        free_block_batch();
+    }
+    cpu->block_batch = tlib_malloc(capacity * sizeof(ExecutedBlock));
+    cpu->block_batch_next = cpu->block_batch;
+    cpu->block_batch_end = cpu->block_batch + capacity;
+    tb_flush(cpu);
+    return 1;
+}
+
+EXC_INT_1(uint32_t, tlib_enable_block_begin_batching, uint32_t, capacity)
+
+// Pending events are delivered before the buffer is released
+void tlib_disable_block_begin_batching()
+{
+    if (cpu->block_batch == NULL) {
+        return;
+    }
+    free_block_batch();
+    tb_flush(cpu);
+}
+
+EXC_VOID_0(tlib_disable_block_begin_batching)
+
+// Collects the statistics of up to `capacity` translated blocks and of the translation cache lookups, see tb_stats.h.
+// The translation cache is flushed, so that every block gets translated with the execution counter in its header.
+uint32_t tlib_enable_tb_stats(uint32_t capacity)
+{
+    tb_stats_t *stats = tb_stats_create(capacity);
+    if (stats == NULL) {
+        return 0;
+    }
+    // the records of the blocks translated so far are dropped together with them
+    tb_flush(cpu);
+    if (cpu->tb_stats != NULL) {
+        tb_stats_destroy(cpu->tb_stats);
+    }
+    cpu->tb_stats = stats;
+    return 1;
+}
+
+EXC_INT_1(uint32_t, tlib_enable_tb_stats, uint32_t, capacity)
+
+void tlib_disable_tb_stats()
+{
+    if (cpu->tb_stats == NULL) {
+        return;
+    }
+    tb_flush(cpu);
+    tb_stats_destroy(cpu->tb_stats);
+    cpu->tb_stats = NULL;
+}
+
+EXC_VOID_0(tlib_disable_tb_stats)
+
+// Copies a snapshot of the statistics, i.e., `tb_stats_t` followed by its records, to `buffer`.
+// Returns the size of the snapshot, or 0 if the statistics are disabled; nothing is copied if the snapshot doesn't fit in `size` bytes.
+uint64_t tlib_get_tb_stats(void *buffer, uint64_t size)
+{
+    if (cpu->tb_stats == NULL) {
+        return 0;
+    }
+    uint64_t snapshot_size = tb_stats_snapshot_size(cpu->tb_stats);
+    if (snapshot_size <= size) {
+        memcpy(buffer, cpu->tb_stats, snapshot_size);
+    }
+    return snapshot_size;
+}
+
+EXC_INT_2(uint64_t, tlib_get_tb_stats, void *, buffer, uint64_t, size)
+
 int32_t tlib_set_return_on_exception(int32_t value)
 {
     int32_t previousValue = cpu->return_on_exception;
@@ -592,15 +884,55 @@ void tlib_set_interrupt_end_hook_present(uint32_t val)
 
 EXC_VOID_1(tlib_set_interrupt_end_hook_present, uint32_t, val)
 
-void tlib_on_memory_access_event_enabled(int32_t value)
+static void update_memory_access_tracking(void)
 {
-    cpu->tlib_is_on_memory_access_enabled = !!value;
+    cpu->tlib_is_on_memory_access_enabled = cpu->memory_access_hook_enabled || cpu->memory_trace != NULL;
     // In order to get all of the memory accesses we need to prevent tcg from using the tlb
-    tcg_context_use_tlb(!value);
+    tcg_context_use_tlb(!cpu->tlib_is_on_memory_access_enabled);
+}
+
+void tlib_on_memory_access_event_enabled(int32_t value)
+{
+    cpu->memory_access_hook_enabled = !!value;
+    update_memory_access_tracking();
 }
 
 EXC_VOID_1(tlib_on_memory_access_event_enabled, int32_t, value)
 
+// Starts recording memory accesses in a new ring of 2^capacity_bits records and returns it, or NULL if the capacity
+// is out of range. The consumer is notified with `tlib_on_memory_trace_ready` when the ring gets half full and at
+// the end of `tlib_execute`. Blocks translated earlier are flushed, as they access the TLB directly.
+void *tlib_enable_memory_trace(uint32_t capacity_bits)
+{
+    memory_trace_ring_t *ring = memory_trace_create(capacity_bits);
+    if (ring == NULL) {
+        return NULL;
+    }
+    if (cpu->memory_trace != NULL) {
+        memory_trace_destroy(cpu->memory_trace);
+    }
+    cpu->memory_trace = ring;
+    update_memory_access_tracking();
+    tb_flush(cpu);
+    return ring;
+}
+
+EXC_POINTER_1(void *, tlib_enable_memory_trace, uint32_t, capacity_bits)
+
+// Records left in the ring are discarded, the consumer should drain it first
+void tlib_disable_memory_trace()
+{
+    if (cpu->memory_trace == NULL) {
+        return;
+    }
+    memory_trace_destroy(cpu->memory_trace);
+    cpu->memory_trace = NULL;
+    update_memory_access_tracking();
+    tb_flush(cpu);
+}
+
+EXC_VOID_0(tlib_disable_memory_trace)
+
 void tlib_clean_wfi_proc_state(void)
 {
     // Invalidates "Wait for interrupt" state, and makes the core ready to resume execution
@@ -617,12 +949,29 @@ void tlib_enable_opcodes_counting(uint32_t value)
 
 EXC_VOID_1(tlib_enable_opcodes_counting, uint32_t, value)
 
-uint32_t tlib_get_opcode_counter(uint32_t opcode_id)
+uint64_t tlib_get_opcode_counter(uint32_t opcode_id)
 {
     return cpu->opcode_counters[opcode_id - 1].counter;
 }
 
-EXC_INT_1(uint32_t, tlib_get_opcode_counter, uint32_t, opcode_id)
+EXC_INT_1(uint64_t, tlib_get_opcode_counter, uint32_t, opcode_id)
+
+// Copies up to `count` counters, ordered by their ids, into `values`
+// and returns the number of counters copied
+uint32_t tlib_get_opcode_counters(uint64_t *values, uint32_t count)
+{
+    if(count > cpu->opcode_counters_size)
+    {
+        count = cpu->opcode_counters_size;
+    }
+    for(uint32_t i = 0; i < count; i++)
+    {
+        values[i] = cpu->opcode_counters[i].counter;
+    }
+    return count;
+}
+
+EXC_INT_2(uint32_t, tlib_get_opcode_counters, uint64_t *, values, uint32_t, count)
 
 void tlib_reset_opcode_counters()
 {
@@ -647,6 +996,7 @@ uint32_t tlib_install_opcode_counter(uint32_t opcode, uint32_t mask)
     cpu->opcode_counters[cpu->opcode_counters_size].opcode = opcode;
     cpu->opcode_counters[cpu->opcode_counters_size].mask = mask;
     cpu->opcode_counters_size++;
+    opcode_counters_invalidate_index();
 
     return cpu->opcode_counters_size;
 }
@@ -671,6 +1021,43 @@ void tlib_enable_guest_profiler(int value)
 }
 EXC_VOID_1(tlib_enable_guest_profiler, int32_t, value)
 
+static void free_sampling_profiler(void)
+{
+    sampling_profiler_disarm(cpu);
+    sampling_profiler_flush(cpu);
+    sampling_profiler_destroy(cpu->sampling_profiler);
+    cpu->sampling_profiler = NULL;
+}
+
+// Takes a sample every `period` instructions, at the first block boundary past it, and passes them
+// to `tlib_on_profiler_samples` in batches of `capacity` and at the end of every `tlib_execute`.
+// Unlike `tlib_enable_guest_profiler` this doesn't need any code to be translated again.
+// Returns 0 if any of the parameters is 0.
+uint32_t tlib_enable_sampling_profiler(uint64_t period, uint32_t capacity)
+{
+    sampling_profiler_t *profiler = sampling_profiler_create(period, capacity);
+    if (profiler == NULL) {
+        return 0;
+    }
+    if (cpu->sampling_profiler != NULL) {
+        free_sampling_profiler();
+    }
+    profiler->next_sample = cpu->instructions_count_total_value + period;
+    cpu->sampling_profiler = profiler;
+    return 1;
+}
+
+EXC_INT_2(uint32_t, tlib_enable_sampling_profiler, uint64_t, period, uint32_t, capacity)
+
+void tlib_disable_sampling_profiler()
+{
+    if (cpu->sampling_profiler != NULL) {
+        free_sampling_profiler();
+    }
+}
+
+EXC_VOID_0(tlib_disable_sampling_profiler)
+
 uint32_t tlib_get_current_tb_disas_flags()
 {
     if (cpu->current_tb == NULL) {
@@ -808,6 +1195,7 @@ void tlib_reset_mmu_window(uint32_t index)
     ASSERT_WINDOW_IN_RANGE(index)
     ExtMmuRange *mmu_array = cpu->external_mmu_window;
     memset((void *)(mmu_array + index), 0, sizeof(ExtMmuRange));
+    cpu->external_mmu_index_valid = false;
 }
 EXC_VOID_1(tlib_reset_mmu_window, uint32_t, index)
 
@@ -818,6 +1206,7 @@ int32_t tlib_acquire_mmu_window(uint32_t type)
         if (!cpu->external_mmu_window[window_index].active) {
             cpu->external_mmu_window[window_index].active = true;
             cpu->external_mmu_window[window_index].type = (uint8_t)type;
+            cpu->external_mmu_index_valid = false;
             return window_index;
         }
     }
@@ -835,6 +1224,7 @@ void tlib_set_mmu_window_start(uint32_t index, uint64_t addr_start)
     ASSERT_NO_OVERLAP(addr_start, cpu->external_mmu_window[index].type)
 #endif
     cpu->external_mmu_window[index].range_start = addr_start;
+    cpu->external_mmu_index_valid = false;
 }
 EXC_VOID_2(tlib_set_mmu_window_start, uint32_t, index, uint64_t, addr_start)
 
@@ -847,6 +1237,7 @@ void tlib_set_mmu_window_end(uint32_t index, uint64_t addr_end)
     ASSERT_NO_OVERLAP(addr_end, cpu->external_mmu_window[index].type)
 #endif
     cpu->external_mmu_window[index].range_end = addr_end;
+    cpu->external_mmu_index_valid = false;
 }
 EXC_VOID_2(tlib_set_mmu_window_end, uint32_t, index, uint64_t, addr_end)
 
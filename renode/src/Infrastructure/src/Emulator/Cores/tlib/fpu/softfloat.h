@@ -340,6 +340,16 @@ INLINE int float32_is_zero_or_denormal(float32 a)
     return (float32_val(a) & 0x7f800000) == 0;
 }
 
+INLINE int float32_is_normal(float32 a)
+{
+    return ((float32_val(a) + 0x00800000) & 0x7fffffff) >= 0x01000000;
+}
+
+INLINE int float32_is_zero_or_normal(float32 a)
+{
+    return float32_is_normal(a) || float32_is_zero(a);
+}
+
 INLINE float32 float32_set_sign(float32 a, int sign)
 {
     return make_float32((float32_val(a) & 0x7fffffff) | (sign << 31));
@@ -452,6 +462,16 @@ INLINE int float64_is_any_nan(float64 a)
     return ((float64_val(a) & ~(1ULL << 63)) > 0x7ff0000000000000ULL);
 }
 
+INLINE int float64_is_normal(float64 a)
+{
+    return ((float64_val(a) + 0x0010000000000000ULL) & 0x7fffffffffffffffULL) >= 0x0020000000000000ULL;
+}
+
+INLINE int float64_is_zero_or_normal(float64 a)
+{
+    return float64_is_normal(a) || float64_is_zero(a);
+}
+
 #define float64_zero     make_float64(0)
 #define float64_one      make_float64(0x3ff0000000000000LL)
 #define float64_one_point_five      make_float64(0x3FF8000000000000ULL)
@@ -3,11 +3,19 @@
 #include "callbacks.h"
 #include "debug.h"
 #include "atomic.h"
+#include "sampling_profiler.h"
 
 // Dirty addresses handling
-#define MAX_DIRTY_ADDRESSES_LIST_COUNT 100
+// Written code pages are batched and deduplicated with a small hash set, so each page is broadcast at most once per batch.
+// The batch is sent when it fills up, when the instructions budget since its first page runs out or when leaving `cpu_exec`.
+#define MAX_DIRTY_ADDRESSES_LIST_COUNT 128
+#define DIRTY_ADDRESSES_SET_SIZE       (2 * MAX_DIRTY_ADDRESSES_LIST_COUNT)
+#define DIRTY_ADDRESSES_FLUSH_BUDGET   1000
 static uint64_t dirty_addresses_list[MAX_DIRTY_ADDRESSES_LIST_COUNT];
+// Holds `page address + 1`, so that 0 marks a free slot
+static uint64_t dirty_addresses_set[DIRTY_ADDRESSES_SET_SIZE];
 static short current_dirty_addresses_list_index = 0;
+static uint64_t dirty_addresses_batch_start;
 
 void flush_dirty_addresses_list()
 {
@@ -17,17 +25,38 @@ void flush_dirty_addresses_list()
     }
     tlib_mass_broadcast_dirty((void *)&dirty_addresses_list, current_dirty_addresses_list_index);
     current_dirty_addresses_list_index = 0;
+    memset(dirty_addresses_set, 0, sizeof(dirty_addresses_set));
+}
+
+void try_flush_dirty_addresses_list()
+{
+    if (current_dirty_addresses_list_index != 0 &&
+        cpu->instructions_count_total_value - dirty_addresses_batch_start >= DIRTY_ADDRESSES_FLUSH_BUDGET) {
+        flush_dirty_addresses_list();
+    }
 }
 
 void append_dirty_address(uint64_t address)
 {
-    if (address == dirty_addresses_list[current_dirty_addresses_list_index-1]) {
-        return;
+    address &= TARGET_PAGE_MASK;
+    uint32_t home = (uint32_t)(((address >> TARGET_PAGE_BITS) * 0x9E3779B97F4A7C15ull) >> 32) & (DIRTY_ADDRESSES_SET_SIZE - 1);
+    uint32_t slot = home;
+    while (dirty_addresses_set[slot] != 0) {
+        if (dirty_addresses_set[slot] == address + 1) {
+            // already in this batch
+            return;
+        }
+        slot = (slot + 1) & (DIRTY_ADDRESSES_SET_SIZE - 1);
     }
     if (current_dirty_addresses_list_index == MAX_DIRTY_ADDRESSES_LIST_COUNT) {
         // list is full
         flush_dirty_addresses_list();
+        slot = home;
     }
+    if (current_dirty_addresses_list_index == 0) {
+        dirty_addresses_batch_start = cpu->instructions_count_total_value;
+    }
+    dirty_addresses_set[slot] = address + 1;
     dirty_addresses_list[current_dirty_addresses_list_index++] = address;
 }
 
@@ -37,23 +66,69 @@ void mark_tbs_containing_pc_as_dirty(target_ulong addr, int access_width, int br
     helper_mark_tbs_as_dirty(cpu, addr, access_width, broadcast);
 }
 
-// verify if there are instructions left to execute, update instructions count
-// and trim the block and exit to the main loop if necessary
+#ifdef SUPPORTS_SUPERBLOCKS
+// Majority vote over the chained successors of `tb`, the winner is followed when forming superblocks
+static inline void profile_block_edge(TranslationBlock *tb, TranslationBlock *successor)
+{
+    if (tb->hot_successor_pc == successor->pc) {
+        tb->hot_successor_votes++;
+    } else if (tb->hot_successor_votes == 0) {
+        tb->hot_successor_pc = successor->pc;
+        tb->hot_successor_votes = 1;
+    } else {
+        tb->hot_successor_votes--;
+    }
+}
+#endif
+
+// verify if there are instructions left to execute, update the execution profile
+// and trim the block and exit to the main loop if necessary;
+// blocks translated with the optimizer call it only when the inline checks of their header do not pass, see `gen_block_header`
 uint32_t HELPER(prepare_block_for_execution)(void *tb)
 {
     cpu->current_tb = (TranslationBlock *)tb;
 
+    // the profile is only needed up to the thresholds, past them the block takes the inline path
+    bool profiled = cpu->current_tb->exec_count <= block_profiling_limit;
+    if (profiled) {
+        cpu->current_tb->exec_count++;
+    }
+#ifdef SUPPORTS_SUPERBLOCKS
+    if (cpu->previous_tb != NULL) {
+        profile_block_edge(cpu->previous_tb, cpu->current_tb);
+    }
+    cpu->previous_tb = profiled ? cpu->current_tb : NULL;
+#endif
+
     if (cpu->exit_request != 0) {
         return cpu->exit_request;
     }
 
+    if (unlikely(cpu->sampling_profiler != NULL)) {
+        // chained blocks may never get back to the main loop, so the samples are taken here too
+        sampling_profiler_check(cpu, cpu->current_tb->pc);
+    }
+
     uint32_t instructions_left = cpu->instructions_count_limit - cpu->instructions_count_value;
 
     if (instructions_left == 0) {
         // setting `tb_restart_request` to 1 will stop executing this block at the end of the header
         cpu->tb_restart_request = 1;
+    } else if (unlikely(cpu->current_tb->exec_count == tiered_translation_threshold && !cpu->current_tb->optimized)) {
+        // chained blocks may never get back to the main loop on their own, and that is where they get translated again
+        cpu->tb_restart_request = 1;
+#ifdef SUPPORTS_SUPERBLOCKS
+    } else if (unlikely(cpu->current_tb->exec_count == superblock_threshold && superblock_threshold != 0)) {
+        // the same holds for forming superblocks
+        cpu->tb_restart_request = 1;
+#endif
+    } else if (cpu->current_tb->superblock && cpu->current_tb->icount > instructions_left && !cpu->current_tb->dirty_flag) {
+        // keep the superblock for the next `tlib_execute` calls, `tb_find_fast` translates a regular block for the rest of this one
+        cpu->tb_restart_request = 1;
     } else if (cpu->current_tb->icount > instructions_left || cpu->current_tb->dirty_flag) {
         // invalidate this block and jump back to the main loop
+        tb_stats_invalidated(cpu->current_tb->stats,
+                             cpu->current_tb->dirty_flag ? TB_STATS_INVALIDATED_DIRTY : TB_STATS_INVALIDATED_RESIZED);
         tb_phys_invalidate(cpu->current_tb, -1);
         cpu->tb_restart_request = 1;
     }
@@ -74,6 +149,20 @@ void HELPER(block_finished_event)(target_ulong address, uint32_t executed_instru
     tlib_on_block_finished(address, executed_instructions);
 }
 
+void flush_block_batch(CPUState *env)
+{
+    uint32_t count = env->block_batch_next - env->block_batch;
+    if (count != 0) {
+        tlib_on_block_begin_batch(env->block_batch, count);
+        env->block_batch_next = env->block_batch;
+    }
+}
+
+void HELPER(flush_block_batch)(void)
+{
+    flush_block_batch(cpu);
+}
+
 void HELPER(abort)(void) {
     tlib_abort("aborted by gen_abort!");
 }
@@ -84,14 +173,14 @@ void HELPER(log)(uint32_t id, uint32_t pc)
                     cpu), msgs[id] == NULL ? "unknown??" : msgs[id]);
 }
 
-void HELPER(acquire_global_memory_lock)(CPUState * env)
+void HELPER(acquire_memory_lock)(CPUState * env, target_ulong address)
 {
-    acquire_global_memory_lock(env);
+    acquire_memory_lock(env, address);
 }
 
-void HELPER(release_global_memory_lock)(CPUState * env)
+void HELPER(release_memory_lock)(CPUState * env)
 {
-    release_global_memory_lock(env);
+    release_memory_lock(env);
 }
 
 void HELPER(reserve_address)(CPUState * env, ram_addr_t address)
@@ -109,11 +198,6 @@ void HELPER(var_log)(target_ulong v)
     tlib_printf(LOG_LEVEL_INFO, "Var Log: 0x" TARGET_FMT_lx, v);
 }
 
-void HELPER(count_opcode_inner)(uint32_t instruction_id)
-{
-   cpu->opcode_counters[instruction_id].counter++;
-}
-
 void HELPER(announce_stack_change)(target_ulong pc, uint32_t state)
 {
     tlib_announce_stack_change(pc, state);
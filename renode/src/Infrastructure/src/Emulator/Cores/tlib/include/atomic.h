@@ -8,42 +8,59 @@
 #define MAX_NUMBER_OF_CPUS 32
 
 #define NO_CPU_ID          0xFFFFFFFF
-#define NO_RESERVATION     -1
+#define NO_STRIPE          0xFFFFFFFF
+#define NO_BUCKET          0xFFFFFFFF
+#define NO_RESERVATION     UINT64_MAX
 
-struct CPUState;
+// The memory lock is striped by address, so that atomic sequences
+// on unrelated addresses executed by different cpus do not serialize.
+// Stripes are picked by the address bits below the smallest page size of all the targets,
+// so they are the same for a virtual address and the physical address it maps to.
+#define MEMORY_LOCK_STRIPES_BITS 6
+#define MEMORY_LOCK_STRIPES      (1 << MEMORY_LOCK_STRIPES_BITS)
 
-typedef struct address_reservation_t
-{
-    uint32_t locking_cpu_id;
-    uint64_t address;
-    uint8_t active_flag;
-    uint8_t id;
-} address_reservation_t;
+// Reservations are indexed by address hash; each bucket holds
+// a mask of cpus whose reservation (possibly stale) hashes there.
+#define RESERVATION_BUCKETS_BITS 8
+#define RESERVATION_BUCKETS      (1 << RESERVATION_BUCKETS_BITS)
+
+// This must match `AtomicMemoryStateSize` in Machine.cs which allocates the state.
+#define ATOMIC_MEMORY_STATE_MAX_SIZE 25600
+
+struct CPUState;
 
 typedef struct atomic_memory_state_t
 {
-    uint8_t is_mutex_initialized;
+    uint8_t are_locks_initialized;
     uint8_t are_reservations_valid;
 
     uint32_t number_of_registered_cpus;
 
-    uint32_t locking_cpu_id;
-    uint32_t entries_count;
+    // id of the cpu holding the stripe or NO_CPU_ID; only changed with CAS
+    uint32_t stripe_locking_cpu_id[MEMORY_LOCK_STRIPES];
 
-    int reservations_count;
-    int reservations_by_cpu[MAX_NUMBER_OF_CPUS];
-    address_reservation_t reservations[MAX_NUMBER_OF_CPUS];
+    // per cpu, only modified by the owning cpu
+    uint32_t held_stripe[MAX_NUMBER_OF_CPUS];
+    // stripe of the word following an unaligned access or NO_STRIPE
+    uint32_t held_next_stripe[MAX_NUMBER_OF_CPUS];
+    uint32_t entries_count[MAX_NUMBER_OF_CPUS];
+    uint32_t reservation_bucket[MAX_NUMBER_OF_CPUS];
 
-    pthread_mutex_t global_mutex;
-    pthread_cond_t global_cond;
+    // per cpu; other cpus may only clear it with CAS when they write to the reserved address
+    uint64_t reserved_address[MAX_NUMBER_OF_CPUS];
 
+    uint32_t reservation_buckets[RESERVATION_BUCKETS];
 } atomic_memory_state_t;
 
+// The stripe bits, above the 3 bits of the offset within a word, must fit in the smallest page (1KB).
+extern int memory_lock_stripes_beyond_smallest_page[MEMORY_LOCK_STRIPES_BITS + 3 <= 10 ? 1 : -1];
+extern int atomic_memory_state_too_big[sizeof(atomic_memory_state_t) <= ATOMIC_MEMORY_STATE_MAX_SIZE ? 1 : -1];
+
 void register_in_atomic_memory_state(atomic_memory_state_t *sm, int id);
 
-void acquire_global_memory_lock(struct CPUState *env);
-void release_global_memory_lock(struct CPUState *env);
-void clear_global_memory_lock(struct CPUState *env);
+void acquire_memory_lock(struct CPUState *env, target_phys_addr_t address);
+void release_memory_lock(struct CPUState *env);
+void clear_memory_lock(struct CPUState *env);
 
 void reserve_address(struct CPUState *env, target_phys_addr_t address);
 uint32_t check_address_reservation(struct CPUState *env, target_phys_addr_t address);
@@ -70,6 +70,7 @@ void tlib_write_word(uint64_t address, uint64_t value);
 void tlib_write_double_word(uint64_t address, uint64_t value);
 void tlib_write_quad_word(uint64_t address, uint64_t value);
 void *tlib_guest_offset_to_host_ptr(uint64_t offset);
+void *tlib_guest_offset_to_host_span(uint64_t offset, uint64_t *size);
 uint64_t tlib_host_ptr_to_guest_offset(void *ptr);
 void tlib_mmu_fault_external_handler(uint64_t addr, int32_t access_type, int32_t window_index);
 void tlib_invalidate_tb_in_other_cpus(uintptr_t start, uintptr_t end);
@@ -85,6 +86,7 @@ void tlib_log(int32_t level, char *message);
 
 void tlib_on_translation_block_find_slow(uint64_t pc);
 uint32_t tlib_on_block_begin(uint64_t address, uint32_t size);
+void tlib_on_block_begin_batch(void *records, uint32_t count);
 void tlib_on_translation_cache_size_change(uint64_t new_size);
 void tlib_on_block_translation(uint64_t start, uint32_t size, uint32_t flags);
 extern int32_t tlib_is_on_block_translation_enabled;
@@ -94,8 +96,10 @@ void tlib_on_interrupt_begin(uint64_t exception_index);
 void tlib_on_interrupt_end(uint64_t exception_index);
 void tlib_profiler_announce_stack_change(uint64_t current_address, uint64_t current_return_address, uint64_t current_instructions_count, int32_t is_frame_add);
 void tlib_profiler_announce_context_change(uint64_t context_id);
+void tlib_on_profiler_samples(void *samples, uint32_t count);
 void tlib_on_memory_access(uint64_t pc, uint32_t operation, uint64_t addr);
 void tlib_on_memory_access_event_enabled(int32_t value);
+void tlib_on_memory_trace_ready(void);
 void tlib_mass_broadcast_dirty(void* list_start, int size);
 void *tlib_get_dirty_addresses_list(void *size);
 
@@ -100,6 +100,22 @@ typedef struct PhysPageDesc {
     bool phys_dirty;
 } PhysPageDesc;
 
+/* The layouts of these two are a part of the exported API */
+typedef struct HostMemorySpan {
+    uint64_t address;
+    uint64_t size;
+    /* NULL if the span isn't RAM */
+    void *host_pointer;
+} HostMemorySpan;
+
+typedef struct PhysicalMemoryVector {
+    uint64_t address;
+    uint64_t size;
+    void *buffer;
+} PhysicalMemoryVector;
+
+uint32_t get_host_memory_spans(target_phys_addr_t addr, uint64_t size, HostMemorySpan *spans, uint32_t max_spans);
+
 target_ulong virt_to_phys(target_ulong virtual, uint32_t access_type, uint32_t nofault);
 
 void tlib_arch_dispose(void);
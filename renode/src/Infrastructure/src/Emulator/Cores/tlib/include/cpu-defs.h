@@ -76,6 +76,11 @@ typedef struct DisasContextBase {
     int mem_idx;
     int is_jmp;
     int guest_profile;
+    /* superblock translation: the jump to the next segment of `trace` becomes a branch to `trace_next_label` */
+    const struct SuperblockTrace *trace;
+    uint32_t trace_segment;
+    int trace_next_label;
+    bool trace_continued;
 } DisasContextBase;
 
 #define HOST_LONG_SIZE      (HOST_LONG_BITS / 8)
@@ -100,8 +105,24 @@ typedef struct DisasContextBase {
 #define TB_JMP_ADDR_MASK   (TB_JMP_PAGE_SIZE - 1)
 #define TB_JMP_PAGE_MASK   (TB_JMP_CACHE_SIZE - TB_JMP_PAGE_SIZE)
 
+/* Default size of the main TLB. It can be changed at runtime and grows on
+   its own when the guest keeps evicting live entries, up to
+   CPU_TLB_MAX_BITS. The ARM host backend encodes the index mask as an
+   immediate, so the size is fixed there. */
 #define CPU_TLB_BITS       8
 #define CPU_TLB_SIZE       (1 << CPU_TLB_BITS)
+#if defined(HOST_I386)
+#define CPU_TLB_MIN_BITS   6
+#define CPU_TLB_MAX_BITS   12
+#else
+#define CPU_TLB_MIN_BITS   CPU_TLB_BITS
+#define CPU_TLB_MAX_BITS   CPU_TLB_BITS
+#endif
+#define CPU_TLB_MAX_SIZE   (1 << CPU_TLB_MAX_BITS)
+#define CPU_TLB_INDEX(env, addr) (((addr) >> TARGET_PAGE_BITS) & ((env)->tlb_mask >> CPU_TLB_ENTRY_BITS))
+
+/* Entries of the fully associative victim TLB, per MMU mode */
+#define CPU_VTLB_SIZE      8
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -131,8 +152,25 @@ extern int CPUTLBEntry_wrong_size[sizeof(CPUTLBEntry) == (1 << CPU_TLB_ENTRY_BIT
 
 #define CPU_COMMON_TLB \
     /* The meaning of the MMU modes is defined in the target code. */   \
-    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
-    target_phys_addr_t iotlb[NB_MMU_MODES][CPU_TLB_SIZE];               \
+    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_MAX_SIZE];              \
+    target_phys_addr_t iotlb[NB_MMU_MODES][CPU_TLB_MAX_SIZE];           \
+    /* entries evicted from 'tlb_table', replaced round-robin */        \
+    CPUTLBEntry tlb_v_table[NB_MMU_MODES][CPU_VTLB_SIZE];               \
+    target_phys_addr_t iotlb_v[NB_MMU_MODES][CPU_VTLB_SIZE];            \
+    uint32_t vtlb_index[NB_MMU_MODES];                                  \
+    /* (tlb_size - 1) << CPU_TLB_ENTRY_BITS, used by the generated code */ \
+    uintptr_t tlb_mask;                                                 \
+    uint32_t tlb_size_bits;                                             \
+    /* size set by the user, the lower bound for dynamic resizing */    \
+    uint32_t tlb_base_size_bits;                                        \
+    bool tlb_dynamic_resize;                                            \
+    /* new size applied between blocks, 0 if none is pending */         \
+    uint32_t tlb_resize_pending_bits;                                   \
+    uint32_t tlb_window_fills;                                          \
+    uint32_t tlb_window_evictions;                                      \
+    uint32_t tlb_fills_since_flush;                                     \
+    uint64_t tlb_miss_count;                                            \
+    uint64_t tlb_victim_hit_count;                                      \
     target_ulong tlb_flush_addr;                                        \
     target_ulong tlb_flush_mask;
 
@@ -160,8 +198,28 @@ typedef struct ExtMmuRange
     bool active;
 } ExtMmuRange;
 
+/* Flattened, sorted view of the active external MMU windows.
+   Segment `i` covers [start, start of segment `i + 1`) and keeps, for every
+   access type, the index of the first window serving it there (or -1). */
+typedef struct ExtMmuSegment
+{
+    target_ulong start;
+    int16_t window[3];
+} ExtMmuSegment;
+
+#define MAX_EXTERNAL_MMU_SEGMENTS (2 * MAX_EXTERNAL_MMU_RANGES)
+
 #define MAX_IO_ACCESS_REGIONS_COUNT 1024
 
+/* Written by the block header when block begin events are batched.
+   This must match the layout read by `OnBlockBeginBatch` in TranslationCPU.cs */
+typedef struct ExecutedBlock
+{
+    uint64_t pc;
+    uint32_t instructions_count;
+    uint32_t reserved;
+} ExecutedBlock;
+
 #define CPU_TEMP_BUF_NLONGS 128
 #define cpu_common_first_field instructions_count_limit
 #define CPU_COMMON                                                            \
@@ -171,7 +229,7 @@ typedef struct ExtMmuRange
     /* instruction counting is used to execute callback after given \
        number of instructions */                                              \
     /* the types of instructions_count_* need to match the TCG-generated      \
-       accesses in `gen_update_instructions_count` in translate-all.c */      \
+       accesses in `gen_block_header` and `gen_update_instructions_count` */  \
     uint32_t instructions_count_limit;                                        \
     uint32_t instructions_count_value;                                        \
     uint64_t instructions_count_total_value;                                  \
@@ -221,7 +279,9 @@ typedef struct ExtMmuRange
     uint32_t cycles_per_instruction;                                          \
     int interrupt_begin_callback_enabled;                                     \
     int interrupt_end_callback_enabled;                                       \
+    /* set when either the hook or the trace wants memory accesses */        \
     int32_t tlib_is_on_memory_access_enabled;                                 \
+    bool memory_access_hook_enabled;                                          \
     int allow_unaligned_accesses;                                             \
                                                                               \
     bool count_opcodes;                                                       \
@@ -232,6 +292,14 @@ typedef struct ExtMmuRange
     atomic_memory_state_t* atomic_memory_state;                               \
     /* STARTING FROM HERE FIELDS ARE NOT SERIALIZED */                        \
     struct TranslationBlock *current_tb; /* currently executing TB  */        \
+    /* last TB entered by chaining while profiled, NULL when entered from     \
+       `cpu_exec` */                                                          \
+    struct TranslationBlock *previous_tb;                                     \
+    /* the block header adds the whole `icount` to the counters; in case of   \
+       exiting the block before the end (e.g., on an exception) the rest is   \
+       given back, and these prevent doing it twice for one execution */      \
+    struct TranslationBlock *instructions_count_restored_tb;                  \
+    uint64_t instructions_count_restored_total;                               \
     CPU_COMMON_TLB                                                            \
     struct TranslationBlock *tb_jmp_cache[TB_JMP_CACHE_SIZE];                 \
     /* buffer for temporaries in the code generator */                        \
@@ -239,6 +307,30 @@ typedef struct ExtMmuRange
     /* when set any exception will force `cpu_exec` to finish immediately */  \
     int32_t return_on_exception;                                              \
     bool guest_profiler_enabled;                                              \
+    /* index of `external_mmu_window`, rebuilt lazily when not valid; it is   \
+       cleared when the windows change and, as it is not serialized, starts   \
+       cleared after the windows are restored with the state */              \
+    bool external_mmu_index_valid;                                            \
+    uint32_t external_mmu_segments_count;                                     \
+    ExtMmuSegment external_mmu_segments[MAX_EXTERNAL_MMU_SEGMENTS];           \
+    /* last external MMU segment hit, per access type */                      \
+    uint32_t external_mmu_last_segment[3];                                    \
+    /* memory access trace ring, NULL when tracing is disabled */             \
+    struct memory_trace_ring_t *memory_trace;                                 \
+    /* buffer of batched block begin events, NULL when they aren't batched;   \
+       the generated code appends at `block_batch_next` and calls a helper    \
+       to deliver the batch when it reaches `block_batch_end` */              \
+    ExecutedBlock *block_batch;                                               \
+    ExecutedBlock *block_batch_next;                                          \
+    ExecutedBlock *block_batch_end;                                           \
+    /* sampling profiler state, NULL when it is disabled */                   \
+    struct sampling_profiler_t *sampling_profiler;                            \
+    /* translation statistics, NULL when they are disabled */                 \
+    struct tb_stats_t *tb_stats;                                              \
+    /* cleared when the opcode counters change; as it is not serialized, the  \
+       index is also rebuilt after the counters are restored with the state   \
+       */                                                                     \
+    bool opcode_counters_index_valid;                                         \
                                                                               \
 
 #endif
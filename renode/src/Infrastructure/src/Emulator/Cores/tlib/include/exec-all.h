@@ -27,6 +27,7 @@
 #include "compiler.h"
 #include "cpu.h"
 #include "tcg-op.h"
+#include "tb_stats.h"
 
 extern CPUState *env;
 
@@ -47,6 +48,7 @@ typedef ram_addr_t tb_page_addr_t;
 
 struct TranslationBlock;
 typedef struct TranslationBlock TranslationBlock;
+struct SuperblockTrace;
 
 // Architecture-specific
 void do_interrupt(CPUState *env);
@@ -60,23 +62,33 @@ int tlb_fill(CPUState *env1, target_ulong addr, int is_write, int mmu_idx, void
 // All the other functions declared in this header are common for all architectures.
 void gen_exit_tb(TranslationBlock *, int);
 void gen_exit_tb_no_chaining(TranslationBlock *);
+bool gen_superblock_continue(DisasContextBase *dc, target_ulong dest);
+bool superblock_can_chain(DisasContextBase *dc);
 CPUBreakpoint *process_breakpoints(CPUState *env, target_ulong pc);
 
-void cpu_gen_code(CPUState *env, struct TranslationBlock *tb, int *gen_code_size_ptr, int *search_size_ptr);
+void cpu_gen_code(CPUState *env, struct TranslationBlock *tb, const struct SuperblockTrace *trace, int *gen_code_size_ptr,
+                  int *search_size_ptr);
 int cpu_restore_state_from_tb(CPUState *env, struct TranslationBlock *tb, uintptr_t searched_pc);
 void cpu_restore_state(CPUState *env, void *retaddr);
 int cpu_restore_state_and_restore_instructions_count(CPUState *env, struct TranslationBlock *tb, uintptr_t searched_pc);
 TranslationBlock *tb_gen_code(CPUState *env, target_ulong pc, target_ulong cs_base, int flags, uint16_t cflags);
+TranslationBlock *tb_gen_superblock(CPUState *env, TranslationBlock *head);
+void tb_invalidate_superblocks(CPUState *env);
+TranslationBlock *tb_gen_second_tier(CPUState *env, TranslationBlock *tb);
 void cpu_exec_init(CPUState *env);
 void cpu_exec_init_all();
 void TLIB_NORETURN cpu_loop_exit(CPUState *env1);
 void TLIB_NORETURN cpu_loop_exit_restore(CPUState *env1, uintptr_t pc, uint32_t call_hook);
 void tb_invalidate_phys_page_range(tb_page_addr_t start, tb_page_addr_t end, int is_cpu_write_access);
+void tb_invalidate_phys_pages(uint64_t *addresses, uint64_t count);
 void tlb_flush(CPUState *env, int flush_global, bool from_generated_code);
 void tlb_flush_masked(CPUState *env, uint32_t mmu_indexes_mask);
 void tlb_flush_page(CPUState *env, target_ulong addr, bool from_generated_code);
 void tlb_flush_page_masked(CPUState *env, target_ulong addr, uint32_t mmu_indexes_mask, bool from_generated_code);
 void tlb_set_page(CPUState *env, target_ulong vaddr, target_phys_addr_t paddr, int prot, int mmu_idx, target_ulong size);
+bool tlb_victim_hit(CPUState *env, int mmu_idx, int index, size_t elt_ofs, target_ulong page);
+void tlb_request_resize(CPUState *env, uint32_t bits);
+void tlb_apply_pending_resize(CPUState *env);
 void interrupt_current_translation_block(CPUState *env, int exception_type);
 int get_external_mmu_phys_addr(CPUState *env, uint32_t address, int access_type,
                                                               target_phys_addr_t *phys_ptr, int *prot, int no_page_fault);
@@ -95,6 +107,35 @@ int get_external_mmu_phys_addr(CPUState *env, uint32_t address, int access_type,
 
 extern uint32_t maximum_block_size;
 
+/* Superblocks (tier-2 translation): a block entered at least `superblock_threshold` times is
+   retranslated together with its most frequent chained successors into one block with side exits.
+   The trace may only follow successors placed after its head on the same page, so that
+   the [pc, pc + size) range used for invalidation covers all of them. */
+#define SUPERBLOCK_MAX_SEGMENTS      8
+#define SUPERBLOCK_MAX_INSNS         256
+#define SUPERBLOCK_MIN_EDGE_VOTES    16
+#define SUPERBLOCK_DEFAULT_THRESHOLD 256
+/* a block that did not form a superblock is profiled again at most this many times */
+#define SUPERBLOCK_MAX_ATTEMPTS      4
+
+extern uint32_t superblock_threshold;
+
+/* Tiered translation: blocks are first translated without the TCG optimizer passes, which take
+   a large part of the translation time, and translated again with them once they get entered
+   `tiered_translation_threshold` times.  Most blocks of boot and initialization code never get there. */
+#define TIERED_TRANSLATION_DEFAULT_THRESHOLD 64
+
+extern uint32_t tiered_translation_threshold;
+
+/* The execution count of a block is updated until it exceeds both thresholds above, only then
+   the block header skips the `prepare_block_for_execution` helper call. */
+extern uint32_t block_profiling_limit;
+
+typedef struct SuperblockTrace {
+    uint32_t segments_count;
+    target_ulong segment_pc[SUPERBLOCK_MAX_SEGMENTS];
+} SuperblockTrace;
+
 struct TranslationBlock {
     target_ulong pc;      /* simulated PC corresponding to this block (EIP + CS base) */
     target_ulong cs_base; /* CS base for this block */
@@ -128,15 +169,25 @@ struct TranslationBlock {
        jmp_first */
     struct TranslationBlock *jmp_next[2];
     struct TranslationBlock *jmp_first;
-    // the type of this field needs to match the TCG-generated access in `gen_update_instructions_count` in translate-all.c
     uint32_t icount;
     bool was_cut;
     // this field is used to keep track of the previous value of size, i.e., it shows the size of translation block without the last instruction; used by a blockend hook
     uint16_t prev_size;
-    // signals that the `icount` of this tb has been added to global instructions counters
-    // in case of exiting this tb before the end (e.g., in case of an exception, watchpoint etc.) the value of counters must be rebuilt
-    // the type of this field needs to match the TCG-generated access in `gen_update_instructions_count` in translate-all.c
-    uint32_t instructions_count_dirty;
+    // execution profile used for tiered translation and to form superblocks, updated by `prepare_block_for_execution`;
+    // the type of this field needs to match the TCG-generated access in `gen_block_header` in translate-all.c
+    uint32_t exec_count;
+    target_ulong hot_successor_pc;
+    // majority vote for `hot_successor_pc` over the blocks this one chained to
+    uint32_t hot_successor_votes;
+    uint8_t superblock_attempts;
+    // set for superblocks; side exits give back the instructions of the segments they skip
+    bool superblock;
+    // nonzero for a regular block translated in front of a superblock that did not fit in the instructions limit
+    uint32_t shadowed_superblock_icount;
+    // set if the TCG optimizer passes ran on this block
+    bool optimized;
+    // statistics record of this block, NULL if the statistics are disabled or out of records
+    tb_stats_record_t *stats;
 #if DEBUG
     uint32_t lock_active;
     char *lock_file;
@@ -168,6 +219,9 @@ void tb_flush(CPUState *env);
 void tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc, tb_page_addr_t phys_page2);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
 
+// Passes the batched block begin events to `tlib_on_block_begin_batch` and empties the buffer
+void flush_block_batch(CPUState *env);
+
 extern TranslationBlock *tb_phys_hash[CODE_GEN_PHYS_HASH_SIZE];
 
 #if defined(__i386__) || defined(__x86_64__)
@@ -224,6 +278,10 @@ static inline void tb_add_jump(TranslationBlock *tb, int n, TranslationBlock *tb
         /* add in TB jmp circular list */
         tb->jmp_next[n] = tb_next->jmp_first;
         tb_next->jmp_first = (TranslationBlock *)((uintptr_t)(tb) | (n));
+
+        if (unlikely(tb->stats != NULL)) {
+            tb->stats->chained_exits |= 1 << n;
+        }
     }
 }
 
@@ -234,6 +292,7 @@ extern int tb_invalidated_flag;
 
 void mark_tbs_containing_pc_as_dirty(target_ulong addr, int access_width, int broadcast);
 void flush_dirty_addresses_list(void);
+void try_flush_dirty_addresses_list(void);
 void append_dirty_address(uint64_t address);
 
 #include "softmmu_defs.h"
@@ -267,7 +326,7 @@ static inline tb_page_addr_t get_page_addr_code(CPUState *env1, target_ulong add
     ram_addr_t pd;
     void *p;
 
-    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    page_index = CPU_TLB_INDEX(env1, addr);
     mmu_idx = cpu_mmu_index(env1);
     if (unlikely(env1->tlb_table[mmu_idx][page_index].addr_code != (addr & TARGET_PAGE_MASK))) {
         if(map_when_needed)
@@ -301,6 +360,7 @@ void free_all_page_descriptors(void);
 void code_gen_free(void);
 
 void generate_opcode_count_increment(CPUState*, uint64_t);
+void opcode_counters_invalidate_index(void);
 void generate_stack_announcement_imm_i32(uint32_t addr, int type, bool clear_lsb);
 void generate_stack_announcement_imm_i64(uint64_t addr, int type, bool clear_lsb);
 void generate_stack_announcement(TCGv pc, int type, bool clear_lsb);
@@ -5,6 +5,17 @@
 
 uint32_t tlib_set_maximum_block_size(uint32_t size);
 uint32_t tlib_get_maximum_block_size(void);
+void tlib_set_superblock_threshold(uint32_t threshold);
+uint32_t tlib_get_superblock_threshold(void);
+void tlib_set_tiered_translation_threshold(uint32_t threshold);
+uint32_t tlib_get_tiered_translation_threshold(void);
+void tlib_set_tlb_size_bits(uint32_t bits);
+uint32_t tlib_get_tlb_size_bits(void);
+void tlib_set_tlb_dynamic_resize(uint32_t enabled);
+uint32_t tlib_get_tlb_dynamic_resize(void);
+uint64_t tlib_get_tlb_miss_count(void);
+uint64_t tlib_get_tlb_victim_hit_count(void);
+void tlib_reset_tlb_counters(void);
 
 void tlib_set_cycles_per_instruction(uint32_t size);
 uint32_t tlib_get_cycles_per_instruction(void);
@@ -33,6 +44,8 @@ void tlib_unmap_range(uint64_t start, uint64_t end);
 uint32_t tlib_is_range_mapped(uint64_t start, uint64_t end);
 
 void tlib_invalidate_translation_blocks(uintptr_t start, uintptr_t end);
+uint32_t tlib_get_host_memory_spans(uint64_t address, uint64_t size, void *spans, uint32_t max_spans);
+void tlib_physical_memory_rw_vectored(void *vectors, uint32_t count, uint32_t is_write);
 
 uint64_t tlib_translate_to_physical_address(uint64_t address, uint32_t access_type);
 
@@ -42,13 +55,20 @@ int32_t tlib_is_irq_set(void);
 void tlib_add_breakpoint(uint64_t address);
 void tlib_remove_breakpoint(uint64_t address);
 void tlib_set_block_begin_hook_present(uint32_t val);
+uint32_t tlib_enable_block_begin_batching(uint32_t capacity);
+void tlib_disable_block_begin_batching(void);
 
 uint64_t tlib_get_total_executed_instructions(void);
 
 void tlib_set_translation_cache_size(uintptr_t size);
 void tlib_invalidate_translation_cache(void);
+uint32_t tlib_enable_tb_stats(uint32_t capacity);
+void tlib_disable_tb_stats(void);
+uint64_t tlib_get_tb_stats(void *buffer, uint64_t size);
 
 void tlib_enable_guest_profiler(int value);
+uint32_t tlib_enable_sampling_profiler(uint64_t period, uint32_t capacity);
+void tlib_disable_sampling_profiler(void);
 
 void tlib_set_page_io_accessed(uint64_t address);
 void tlib_clear_page_io_accessed(uint64_t address);
@@ -65,6 +85,9 @@ uint32_t tlib_get_tb_cache_enabled(void);
 
 void tlib_set_block_finished_hook_present(uint32_t val);
 
+void *tlib_enable_memory_trace(uint32_t capacity_bits);
+void tlib_disable_memory_trace(void);
+
 int32_t tlib_set_return_on_exception(int32_t value);
 void tlib_flush_page(uint64_t address);
 
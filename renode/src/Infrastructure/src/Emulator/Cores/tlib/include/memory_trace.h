@@ -0,0 +1,55 @@
+#ifndef MEMORY_TRACE_H_
+#define MEMORY_TRACE_H_
+
+#include <stdint.h>
+
+// Memory operation types, shared with `MemoryOperation` on the C# side
+#define MEMORY_IO_READ  0
+#define MEMORY_IO_WRITE 1
+#define MEMORY_READ     2
+#define MEMORY_WRITE    3
+#define INSN_FETCH      4
+
+#define MEMORY_TRACE_MIN_CAPACITY_BITS 4
+#define MEMORY_TRACE_MAX_CAPACITY_BITS 24
+
+// Stored when the page of a page-crossing access is no longer in the TLB
+#define MEMORY_TRACE_UNKNOWN_PADDR UINT64_MAX
+
+// This must match the layout read by `DrainMemoryAccessTrace` in TranslationCPU_MemoryTrace.cs.
+typedef struct memory_trace_record_t
+{
+    uint64_t pc;
+    uint64_t vaddr;
+    uint64_t paddr;
+    uint64_t value;
+    uint32_t type;
+    uint32_t width;
+} memory_trace_record_t;
+
+// Single producer, single consumer ring allocated with `tlib_malloc`, so that the consumer reads the records in place.
+// `head` is written only by the cpu thread and `tail` only by the consumer; both only grow and are taken
+// modulo `capacity` when indexing `records`.
+typedef struct memory_trace_ring_t
+{
+    uint64_t head;
+    uint64_t tail;
+    // accesses not recorded because the ring was full
+    uint64_t dropped;
+    uint32_t capacity;
+    uint32_t record_size;
+    memory_trace_record_t records[];
+} memory_trace_ring_t;
+
+struct CPUState;
+
+memory_trace_ring_t *memory_trace_create(uint32_t capacity_bits);
+void memory_trace_destroy(memory_trace_ring_t *ring);
+void memory_trace_flush(memory_trace_ring_t *ring);
+
+// Reports a memory access to the `tlib_on_memory_access` hook and/or the trace ring, whichever is enabled.
+// `tlb_addr` and `iotlb` are the TLB entry at the index of `vaddr` after the access.
+void on_memory_access(struct CPUState *env, uint32_t type, uint64_t vaddr, uint64_t value, uint32_t width, uint64_t tlb_addr,
+                      uint64_t iotlb);
+
+#endif
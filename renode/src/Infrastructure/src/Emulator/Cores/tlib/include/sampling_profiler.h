@@ -0,0 +1,60 @@
+#ifndef SAMPLING_PROFILER_H_
+#define SAMPLING_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILER_SAMPLE_MAX_DEPTH 32
+
+// This must match the layout read by `OnProfilerSamples` in TranslationCPU_Profiler.cs.
+typedef struct profiler_sample_t
+{
+    // total number of instructions executed when the sample was taken
+    uint64_t instructions_count;
+    uint32_t depth;
+    uint32_t reserved;
+    // `frames[0]` is the pc, the rest are return addresses found by walking the frame pointers
+    uint64_t frames[PROFILER_SAMPLE_MAX_DEPTH];
+} profiler_sample_t;
+
+typedef struct sampling_profiler_t
+{
+    uint64_t period;
+    // value of `instructions_count_total_value` at which the next sample is due
+    uint64_t next_sample;
+    // part of the `tlib_execute` budget taken away from `instructions_count_limit`, so that the execution
+    // gets back to the main loop or the block header slow path once the next sample is due
+    uint32_t withheld;
+    uint32_t count;
+    uint32_t capacity;
+    profiler_sample_t samples[];
+} sampling_profiler_t;
+
+// Where the frame record of the current function is and how it is laid out; both offsets are relative to `frame_pointer`
+typedef struct frame_record_layout_t
+{
+    uint64_t frame_pointer;
+    int32_t previous_frame_pointer_offset;
+    int32_t return_address_offset;
+    uint32_t word_size;
+    // clears the instruction set bits of the return addresses
+    uint64_t return_address_mask;
+} frame_record_layout_t;
+
+struct CPUState;
+
+sampling_profiler_t *sampling_profiler_create(uint64_t period, uint32_t capacity);
+void sampling_profiler_destroy(sampling_profiler_t *profiler);
+void sampling_profiler_flush(struct CPUState *env);
+
+// Hold back and give back the part of the budget past the next sample point, around each `cpu_exec`
+void sampling_profiler_arm(struct CPUState *env);
+void sampling_profiler_disarm(struct CPUState *env);
+
+// Called at block boundaries, where the guest registers are synchronized; takes a sample if it is due
+void sampling_profiler_check(struct CPUState *env, uint64_t pc);
+
+// Implemented by the architectures supporting guest profiling
+void cpu_get_frame_record_layout(struct CPUState *env, frame_record_layout_t *layout);
+
+#endif
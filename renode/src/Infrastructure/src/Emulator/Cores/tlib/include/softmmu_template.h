@@ -24,6 +24,7 @@
 #include "infrastructure.h"
 #include <stdint.h>
 #include "atomic.h"
+#include "memory_trace.h"
 
 extern void *global_retaddr;
 
@@ -57,12 +58,6 @@ extern void *global_retaddr;
 #define ADDR_READ        addr_read
 #endif
 
-#define MEMORY_IO_READ 0
-#define MEMORY_IO_WRITE 1
-#define MEMORY_READ 2
-#define MEMORY_WRITE 3
-#define INSN_FETCH 4
-
 #ifdef ALIGNED_ONLY
 void do_unaligned_access(target_ulong addr, int is_write, int is_user, void *retaddr);
 #endif
@@ -104,12 +99,12 @@ __attribute__((always_inline)) inline DATA_TYPE REGPARM glue(glue(glue(__ld, SUF
     uintptr_t addend;
     bool is_insn_fetch = (env->current_tb == NULL);
 
-    acquire_global_memory_lock(cpu);
+    acquire_memory_lock(cpu, addr);
     register_address_access(cpu, addr);
 
     /* test if there is match for unaligned or IO access */
     /* XXX: could done more in memory macro in a non portable way */
-    index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    index = CPU_TLB_INDEX(cpu, addr);
 
     tlb_addr = cpu->tlb_table[mmu_idx][index].ADDR_READ;
     if(tlb_addr != -1 && (tlb_addr & TLB_ONE_SHOT) != 0) {
@@ -138,7 +133,7 @@ redo:
             res = glue(io_read, SUFFIX)(ioaddr, addr, retaddr);
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), MEMORY_IO_READ, addr);
+                on_memory_access(cpu, MEMORY_IO_READ, addr, res, DATA_SIZE, cpu->tlb_table[mmu_idx][index].ADDR_READ, cpu->iotlb[mmu_idx][index]);
             }
         } else if (((addr & ~TARGET_PAGE_MASK) + DATA_SIZE - 1) >= TARGET_PAGE_SIZE) {
             /* slow unaligned access (it spans two pages or IO) */
@@ -152,7 +147,8 @@ do_unaligned_access:
             res = glue(glue(glue(slow_ld, SUFFIX), _err), MMUSUFFIX)(addr, mmu_idx, retaddr, err);
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), is_insn_fetch ? INSN_FETCH : MEMORY_READ, addr);
+                on_memory_access(cpu, is_insn_fetch ? INSN_FETCH : MEMORY_READ, addr, res, DATA_SIZE, cpu->tlb_table[mmu_idx][index].ADDR_READ,
+                                 cpu->iotlb[mmu_idx][index]);
             }
         } else {
             /* unaligned/aligned access in the same page */
@@ -166,7 +162,8 @@ do_unaligned_access:
             res = glue(glue(ld, USUFFIX), _raw)((uint8_t *)(uintptr_t)(addr + addend));
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), is_insn_fetch ? INSN_FETCH : MEMORY_READ, addr);
+                on_memory_access(cpu, is_insn_fetch ? INSN_FETCH : MEMORY_READ, addr, res, DATA_SIZE, cpu->tlb_table[mmu_idx][index].ADDR_READ,
+                                 cpu->iotlb[mmu_idx][index]);
             }
         }
     } else {
@@ -177,6 +174,9 @@ do_unaligned_access:
             do_unaligned_access(addr, READ_ACCESS_TYPE, mmu_idx, retaddr);
         }
 #endif
+        if (tlb_victim_hit(cpu, mmu_idx, index, offsetof(CPUTLBEntry, ADDR_READ), addr & TARGET_PAGE_MASK)) {
+            goto redo;
+        }
         if (!tlb_fill(cpu, addr, READ_ACCESS_TYPE, mmu_idx, retaddr, !!err, DATA_SIZE)) {
             goto redo;
         } else {
@@ -187,7 +187,7 @@ do_unaligned_access:
         }
     }
 
-    release_global_memory_lock(cpu);
+    release_memory_lock(cpu);
     return res;
 }
 
@@ -205,7 +205,7 @@ static DATA_TYPE glue(glue(glue(slow_ld, SUFFIX), _err), MMUSUFFIX)(target_ulong
     target_ulong tlb_addr, addr1, addr2;
     uintptr_t addend;
 
-    index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    index = CPU_TLB_INDEX(cpu, addr);
 
     tlb_addr = cpu->tlb_table[mmu_idx][index].ADDR_READ;
     if(tlb_addr != -1 && (tlb_addr & TLB_ONE_SHOT) != 0) {
@@ -251,6 +251,9 @@ do_unaligned_access:
         }
     } else {
         /* the page is not in the TLB : fill it */
+        if (tlb_victim_hit(cpu, mmu_idx, index, offsetof(CPUTLBEntry, ADDR_READ), addr & TARGET_PAGE_MASK)) {
+            goto redo;
+        }
         if (!tlb_fill(cpu, addr, READ_ACCESS_TYPE, mmu_idx, retaddr, err == NULL ? 0 : 1, DATA_SIZE)) {
             goto redo;
         } else {
@@ -309,10 +312,10 @@ __attribute__((always_inline)) inline void REGPARM glue(glue(__st, SUFFIX), MMUS
     int index;
     uintptr_t addend;
 
-    acquire_global_memory_lock(cpu);
+    acquire_memory_lock(cpu, addr);
     register_address_access(cpu, addr);
 
-    index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    index = CPU_TLB_INDEX(cpu, addr);
 
     tlb_addr = cpu->tlb_table[mmu_idx][index].addr_write;
     if(tlb_addr != -1 && (tlb_addr & TLB_ONE_SHOT) != 0) {
@@ -341,7 +344,7 @@ redo:
             glue(io_write, SUFFIX)(ioaddr, val, addr, retaddr);
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), MEMORY_IO_WRITE, addr);
+                on_memory_access(cpu, MEMORY_IO_WRITE, addr, val, DATA_SIZE, cpu->tlb_table[mmu_idx][index].addr_write, cpu->iotlb[mmu_idx][index]);
             }
         } else if (((addr & ~TARGET_PAGE_MASK) + DATA_SIZE - 1) >= TARGET_PAGE_SIZE) {
 do_unaligned_access:
@@ -354,7 +357,7 @@ do_unaligned_access:
             glue(glue(slow_st, SUFFIX), MMUSUFFIX)(addr, val, mmu_idx, retaddr);
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), MEMORY_WRITE, addr);
+                on_memory_access(cpu, MEMORY_WRITE, addr, val, DATA_SIZE, cpu->tlb_table[mmu_idx][index].addr_write, cpu->iotlb[mmu_idx][index]);
             }
         } else {
             /* aligned/unaligned access in the same page */
@@ -369,7 +372,7 @@ do_unaligned_access:
             glue(glue(st, SUFFIX), _raw)((uint8_t *)(uintptr_t)(addr + addend), val);
             if(unlikely(cpu->tlib_is_on_memory_access_enabled != 0))
             {
-                tlib_on_memory_access(CPU_PC(cpu), MEMORY_WRITE, addr);
+                on_memory_access(cpu, MEMORY_WRITE, addr, val, DATA_SIZE, cpu->tlb_table[mmu_idx][index].addr_write, cpu->iotlb[mmu_idx][index]);
             }
         }
     } else {
@@ -380,12 +383,15 @@ do_unaligned_access:
             do_unaligned_access(addr, 1, mmu_idx, retaddr);
         }
 #endif
+        if (tlb_victim_hit(cpu, mmu_idx, index, offsetof(CPUTLBEntry, addr_write), addr & TARGET_PAGE_MASK)) {
+            goto redo;
+        }
         tlb_fill(cpu, addr, 1, mmu_idx, retaddr, 0, DATA_SIZE);
         goto redo;
     }
 
     mark_tbs_containing_pc_as_dirty(addr, DATA_SIZE, 1);
-    release_global_memory_lock(cpu);
+    release_memory_lock(cpu);
 }
 
 /* handles all unaligned cases */
@@ -396,7 +402,7 @@ void glue(glue(slow_st, SUFFIX), MMUSUFFIX)(target_ulong addr, DATA_TYPE val, in
     int index, i;
     uintptr_t addend;
 
-    index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    index = CPU_TLB_INDEX(cpu, addr);
 
     tlb_addr = cpu->tlb_table[mmu_idx][index].addr_write;
     if(tlb_addr != -1 && (tlb_addr & TLB_ONE_SHOT) != 0) {
@@ -440,6 +446,9 @@ do_unaligned_access:
         }
     } else {
         /* the page is not in the TLB : fill it */
+        if (tlb_victim_hit(cpu, mmu_idx, index, offsetof(CPUTLBEntry, addr_write), addr & TARGET_PAGE_MASK)) {
+            goto redo;
+        }
         tlb_fill(cpu, addr, 1, mmu_idx, retaddr, 0, DATA_SIZE);
         goto redo;
     }
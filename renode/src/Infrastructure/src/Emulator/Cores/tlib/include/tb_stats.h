@@ -0,0 +1,76 @@
+#ifndef TB_STATS_H_
+#define TB_STATS_H_
+
+#include <stdint.h>
+
+// Why a block is no longer in the translation cache
+#define TB_STATS_VALID                  0
+#define TB_STATS_INVALIDATED_FLUSH      1
+// guest code was written or the host asked to invalidate the range
+#define TB_STATS_INVALIDATED_CODE_WRITE 2
+// a write to an address of the block marked it dirty
+#define TB_STATS_INVALIDATED_DIRTY      3
+// translated again to fit a different instructions budget
+#define TB_STATS_INVALIDATED_RESIZED    4
+// replaced by an optimized block or a superblock
+#define TB_STATS_INVALIDATED_REPLACED   5
+// stopped in the middle, e.g., by a watchpoint
+#define TB_STATS_INVALIDATED_INTERRUPTED 6
+
+#define TB_STATS_KIND_OPTIMIZED  (1 << 0)
+#define TB_STATS_KIND_SUPERBLOCK (1 << 1)
+
+typedef struct tb_stats_record_t
+{
+    uint64_t pc;
+    uint64_t phys_pc;
+    // bumped by the block header, so it counts chained executions too
+    uint64_t exec_count;
+    uint64_t translation_time_ns;
+    uint32_t host_code_size;
+    uint32_t guest_code_size;
+    uint32_t icount;
+    // bit n is set while the exit n of the block jumps directly to another one
+    uint8_t chained_exits;
+    uint8_t kind;
+    uint8_t invalidation_reason;
+    uint8_t reserved;
+} tb_stats_record_t;
+
+// Allocated with `tlib_malloc`; the snapshot returned by `tlib_get_tb_stats` is this structure with the first `count` records.
+// Records are never reused, so the ones of invalidated blocks stay in place until the statistics are enabled again.
+typedef struct tb_stats_t
+{
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t reserved;
+    // blocks translated after all the records were used up
+    uint64_t untracked;
+    uint64_t jmp_cache_hits;
+    uint64_t phys_hash_lookups;
+    uint64_t phys_hash_misses;
+    uint64_t translations;
+    uint64_t invalidations;
+    uint64_t flushes;
+    tb_stats_record_t records[];
+} tb_stats_t;
+
+tb_stats_t *tb_stats_create(uint32_t capacity);
+void tb_stats_destroy(tb_stats_t *stats);
+uint64_t tb_stats_snapshot_size(tb_stats_t *stats);
+
+// Returns NULL once the records are used up
+tb_stats_record_t *tb_stats_new_record(tb_stats_t *stats);
+
+// Only the first reason is kept
+static inline void tb_stats_invalidated(tb_stats_record_t *record, uint8_t reason)
+{
+    if (record != NULL && record->invalidation_reason == TB_STATS_VALID) {
+        record->invalidation_reason = reason;
+    }
+}
+
+uint64_t tb_stats_get_time_ns(void);
+
+#endif
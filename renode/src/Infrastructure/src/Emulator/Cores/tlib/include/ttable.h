@@ -24,6 +24,14 @@ typedef struct
 typedef bool TTableEntryCompareFn(TTable_entry entry, const void *value);
 typedef void TTableEntryRemoveCallback(TTable_entry *entry);
 
+// Key types supported by hashed TTables; other tables are always scanned linearly.
+typedef enum
+{
+    TTABLE_KEY_CUSTOM = 0,
+    TTABLE_KEY_UINT32,
+    TTABLE_KEY_STRING,
+} TTableKeyType;
+
 typedef struct
 {
     uint32_t count;
@@ -31,6 +39,13 @@ typedef struct
     TTableEntryRemoveCallback *entry_remove_callback;
     TTableEntryCompareFn *key_compare_function;
     uint32_t size;
+
+    // Open addressing index of entry ids (-1 marks a free slot), only present in hashed TTables.
+    TTableKeyType key_type;
+    int32_t *hash_index;
+    uint32_t hash_mask;
+    // No insertions are allowed after freezing.
+    bool frozen;
 } TTable;
 
 // Only one of these functions will be used for the given TTable depending on what TTable_entry's key is.
@@ -64,18 +79,108 @@ static inline TTable *ttable_create(uint32_t entries_max, TTableEntryRemoveCallb
     ttable->entry_remove_callback = entry_remove_callback;
     ttable->key_compare_function = key_compare_function;
     ttable->size = entries_max;
+    ttable->key_type = TTABLE_KEY_CUSTOM;
+    ttable->hash_index = NULL;
+    ttable->frozen = false;
+    return ttable;
+}
+
+static inline uint32_t ttable_hash_key(TTableKeyType key_type, const void *key)
+{
+    uint32_t hash;
+    if (key_type == TTABLE_KEY_UINT32) {
+        // MurmurHash3 finalizer
+        hash = *(const uint32_t *)key;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6b;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35;
+        hash ^= hash >> 16;
+    } else {
+        // FNV-1a
+        const unsigned char *c;
+        hash = 2166136261u;
+        for (c = key; *c; c++) {
+            hash = (hash ^ *c) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static inline bool ttable_key_equals(TTableKeyType key_type, const void *entry_key, const void *key)
+{
+    if (key_type == TTABLE_KEY_UINT32) {
+        return *(const uint32_t *)entry_key == *(const uint32_t *)key;
+    }
+    return strcmp(entry_key, key) == 0;
+}
+
+static inline void ttable_hash_index_add(TTable *ttable, uint32_t entry_id)
+{
+    uint32_t slot = ttable_hash_key(ttable->key_type, ttable->entries[entry_id].key) & ttable->hash_mask;
+    while (ttable->hash_index[slot] != -1) {
+        slot = (slot + 1) & ttable->hash_mask;
+    }
+    ttable->hash_index[slot] = entry_id;
+}
+
+// Sizes the index for `entries_count` entries at a load factor of at most 1/2 and refills it.
+static inline void ttable_hash_index_rebuild(TTable *ttable, uint32_t entries_count)
+{
+    uint32_t slots = 2;
+    while (slots < 2 * entries_count) {
+        slots <<= 1;
+    }
+
+    if (ttable->hash_index) {
+        tlib_free(ttable->hash_index);
+    }
+    ttable->hash_index = tlib_malloc(slots * sizeof(int32_t));
+    memset(ttable->hash_index, -1, slots * sizeof(int32_t));
+    ttable->hash_mask = slots - 1;
+
+    uint32_t i;
+    for (i = 0; i < ttable->count; i++) {
+        ttable_hash_index_add(ttable, i);
+    }
+}
+
+// Creates a TTable which, apart from the usual entries array, keeps a hash index used by `ttable_lookup`.
+static inline TTable *ttable_create_hashed(uint32_t entries_max, TTableEntryRemoveCallback *entry_remove_callback,
+                                           TTableKeyType key_type)
+{
+    tlib_assert(key_type == TTABLE_KEY_UINT32 || key_type == TTABLE_KEY_STRING);
+
+    TTable *ttable = ttable_create(entries_max, entry_remove_callback,
+                                   key_type == TTABLE_KEY_UINT32 ? ttable_compare_key_uint32 : ttable_compare_key_string);
+    ttable->key_type = key_type;
+    ttable_hash_index_rebuild(ttable, entries_max);
     return ttable;
 }
 
 static inline void ttable_insert(TTable *ttable, void *key, void *value)
 {
     tlib_assert(ttable->count < ttable->size);
+    tlib_assert(!ttable->frozen);
 
     uint32_t first_free_entry_id = ttable->count;
     ttable->entries[first_free_entry_id].key = key;
     ttable->entries[first_free_entry_id].value = value;
 
     ttable->count++;
+
+    if (ttable->hash_index) {
+        ttable_hash_index_add(ttable, first_free_entry_id);
+    }
+}
+
+// Marks the TTable as complete; for hashed TTables the index is shrunk to fit the actual number of entries.
+static inline void ttable_freeze(TTable *ttable)
+{
+    ttable->frozen = true;
+    if (ttable->hash_index) {
+        ttable_hash_index_rebuild(ttable, ttable->count);
+    }
 }
 
 static inline TTable_entry *ttable_lookup_custom(TTable *ttable, TTableEntryCompareFn *entry_compare_function,
@@ -91,8 +196,25 @@ static inline TTable_entry *ttable_lookup_custom(TTable *ttable, TTableEntryComp
     return NULL;
 }
 
+static inline TTable_entry *ttable_lookup_hashed(TTable *ttable, const void *key)
+{
+    uint32_t slot = ttable_hash_key(ttable->key_type, key) & ttable->hash_mask;
+    int32_t entry_id;
+    // Entries with equal keys are probed in insertion order, so the first one inserted is found like in a linear scan.
+    while ((entry_id = ttable->hash_index[slot]) != -1) {
+        if (ttable_key_equals(ttable->key_type, ttable->entries[entry_id].key, key)) {
+            return &ttable->entries[entry_id];
+        }
+        slot = (slot + 1) & ttable->hash_mask;
+    }
+    return NULL;
+}
+
 static inline TTable_entry *ttable_lookup(TTable *ttable, void *key)
 {
+    if (ttable->hash_index) {
+        return ttable_lookup_hashed(ttable, key);
+    }
     return ttable_lookup_custom(ttable, ttable->key_compare_function, key);
 }
 
@@ -124,6 +246,9 @@ static inline void ttable_remove(TTable *ttable)
         }
     }
 
+    if (ttable->hash_index) {
+        tlib_free(ttable->hash_index);
+    }
     tlib_free(ttable->entries);
     tlib_free(ttable);
 }
@@ -0,0 +1,79 @@
+#include <string.h>
+#include "cpu.h"
+#include "callbacks.h"
+#include "memory_trace.h"
+
+memory_trace_ring_t *memory_trace_create(uint32_t capacity_bits)
+{
+    if (capacity_bits < MEMORY_TRACE_MIN_CAPACITY_BITS || capacity_bits > MEMORY_TRACE_MAX_CAPACITY_BITS) {
+        return NULL;
+    }
+    uint32_t capacity = 1u << capacity_bits;
+    memory_trace_ring_t *ring = tlib_malloc(sizeof(memory_trace_ring_t) + capacity * sizeof(memory_trace_record_t));
+    memset(ring, 0, sizeof(memory_trace_ring_t));
+    ring->capacity = capacity;
+    ring->record_size = sizeof(memory_trace_record_t);
+    return ring;
+}
+
+void memory_trace_destroy(memory_trace_ring_t *ring)
+{
+    tlib_free(ring);
+}
+
+// Asks the consumer to drain the ring; it is expected to do it before returning
+void memory_trace_flush(memory_trace_ring_t *ring)
+{
+    if (ring->head != __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+        tlib_on_memory_trace_ready();
+    }
+}
+
+static void memory_trace_append(memory_trace_ring_t *ring, uint64_t pc, uint32_t type, uint64_t vaddr, uint64_t paddr,
+                                uint64_t value, uint32_t width)
+{
+    uint64_t head = ring->head;
+    uint64_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (unlikely(used == ring->capacity)) {
+        // the consumer did not drain the ring when it got half full
+        ring->dropped++;
+        return;
+    }
+
+    memory_trace_record_t *record = &ring->records[head & (ring->capacity - 1)];
+    record->pc = pc;
+    record->vaddr = vaddr;
+    record->paddr = paddr;
+    record->value = value;
+    record->type = type;
+    record->width = width;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    // notify once per crossing of the half, so that a slow consumer isn't called on every access
+    if (unlikely(used + 1 == ring->capacity / 2)) {
+        memory_trace_flush(ring);
+    }
+}
+
+static inline uint64_t memory_access_paddr(target_ulong vaddr, target_ulong tlb_addr, target_phys_addr_t iotlb)
+{
+    if ((vaddr & TARGET_PAGE_MASK) != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))) {
+        return MEMORY_TRACE_UNKNOWN_PADDR;
+    }
+    // for both RAM and IO pages `iotlb` is the physical page address with flags in the low bits,
+    // minus the virtual page address (see `tlb_set_page`)
+    return (iotlb & TARGET_PAGE_MASK) + vaddr;
+}
+
+void on_memory_access(CPUState *env, uint32_t type, uint64_t vaddr, uint64_t value, uint32_t width, uint64_t tlb_addr,
+                      uint64_t iotlb)
+{
+    if (env->memory_access_hook_enabled) {
+        tlib_on_memory_access(CPU_PC(env), type, vaddr);
+    }
+    if (env->memory_trace != NULL) {
+        memory_trace_append(env->memory_trace, CPU_PC(env), type, vaddr, memory_access_paddr(vaddr, tlb_addr, iotlb), value,
+                            width);
+    }
+}
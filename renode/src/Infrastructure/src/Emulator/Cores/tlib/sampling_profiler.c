@@ -0,0 +1,133 @@
+#include <string.h>
+#include "cpu.h"
+#include "exec-all.h"
+#include "callbacks.h"
+#include "sampling_profiler.h"
+
+sampling_profiler_t *sampling_profiler_create(uint64_t period, uint32_t capacity)
+{
+    if (period == 0 || capacity == 0) {
+        return NULL;
+    }
+    sampling_profiler_t *profiler = tlib_malloc(sizeof(sampling_profiler_t) + capacity * sizeof(profiler_sample_t));
+    memset(profiler, 0, sizeof(sampling_profiler_t));
+    profiler->period = period;
+    profiler->capacity = capacity;
+    return profiler;
+}
+
+void sampling_profiler_destroy(sampling_profiler_t *profiler)
+{
+    tlib_free(profiler);
+}
+
+void sampling_profiler_flush(CPUState *env)
+{
+    sampling_profiler_t *profiler = env->sampling_profiler;
+    if (profiler->count != 0) {
+        tlib_on_profiler_samples(profiler->samples, profiler->count);
+        profiler->count = 0;
+    }
+}
+
+void sampling_profiler_disarm(CPUState *env)
+{
+    sampling_profiler_t *profiler = env->sampling_profiler;
+    env->instructions_count_limit += profiler->withheld;
+    profiler->withheld = 0;
+}
+
+void sampling_profiler_arm(CPUState *env)
+{
+    sampling_profiler_t *profiler = env->sampling_profiler;
+    sampling_profiler_disarm(env);
+
+    uint64_t total = env->instructions_count_total_value;
+    uint64_t until_sample = profiler->next_sample > total ? profiler->next_sample - total : 0;
+    // stop a whole block past the sample point, so that no block is translated shorter because of it;
+    // adjusting the limit and the value by the same amount, like `tlib_get_executed_instructions` does, keeps it in place
+    uint64_t window = until_sample + maximum_block_size;
+    uint32_t left = env->instructions_count_limit - env->instructions_count_value;
+    if (window < left) {
+        profiler->withheld = left - window;
+        env->instructions_count_limit -= profiler->withheld;
+    }
+}
+
+#ifdef SUPPORTS_GUEST_PROFILING
+// Reads a word of guest RAM, never touching the IO regions
+static bool read_guest_word(CPUState *env, uint64_t address, uint32_t size, uint64_t *value)
+{
+    if (address % size != 0) {
+        return false;
+    }
+
+    uint8_t *host;
+    int mmu_idx = cpu_mmu_index(env);
+    int index = CPU_TLB_INDEX(env, address);
+    if (env->tlb_table[mmu_idx][index].addr_read == (address & TARGET_PAGE_MASK)) {
+        // the stack is usually in the TLB already
+        host = (uint8_t *)(uintptr_t)(address + env->tlb_table[mmu_idx][index].addend);
+    } else {
+        target_phys_addr_t page = cpu_get_phys_page_debug(env, address & TARGET_PAGE_MASK);
+        if (page == -1) {
+            return false;
+        }
+        PhysPageDesc *p = phys_page_find(page >> TARGET_PAGE_BITS);
+        if (p == NULL || ((p->phys_offset & ~TARGET_PAGE_MASK) > IO_MEM_ROM && !(p->phys_offset & IO_MEM_ROMD))) {
+            return false;
+        }
+        host = (uint8_t *)get_ram_ptr(p->phys_offset & TARGET_PAGE_MASK) + (address & ~TARGET_PAGE_MASK);
+    }
+    *value = size == 8 ? ldq_p(host) : ldl_p(host);
+    return true;
+}
+
+static uint32_t unwind_stack(CPUState *env, uint64_t *frames, uint32_t max_depth)
+{
+    frame_record_layout_t layout;
+    uint64_t return_address, previous_frame_pointer;
+    uint32_t depth = 0;
+
+    cpu_get_frame_record_layout(env, &layout);
+    uint64_t frame_pointer = layout.frame_pointer;
+    while (depth < max_depth && frame_pointer != 0) {
+        if (!read_guest_word(env, frame_pointer + layout.return_address_offset, layout.word_size, &return_address) ||
+            !read_guest_word(env, frame_pointer + layout.previous_frame_pointer_offset, layout.word_size, &previous_frame_pointer) ||
+            return_address == 0) {
+            break;
+        }
+        frames[depth++] = return_address & layout.return_address_mask;
+        // the stack grows down, so anything else means the chain is broken, e.g. by code built without frame pointers
+        if (previous_frame_pointer <= frame_pointer) {
+            break;
+        }
+        frame_pointer = previous_frame_pointer;
+    }
+    return depth;
+}
+#endif
+
+void sampling_profiler_check(CPUState *env, uint64_t pc)
+{
+    sampling_profiler_t *profiler = env->sampling_profiler;
+    if (env->instructions_count_total_value < profiler->next_sample) {
+        return;
+    }
+
+    profiler_sample_t *sample = &profiler->samples[profiler->count];
+    sample->instructions_count = env->instructions_count_total_value;
+    sample->frames[0] = pc;
+    sample->depth = 1;
+#ifdef SUPPORTS_GUEST_PROFILING
+    sample->depth += unwind_stack(env, &sample->frames[1], PROFILER_SAMPLE_MAX_DEPTH - 1);
+#endif
+    profiler->next_sample = env->instructions_count_total_value + profiler->period;
+    // the limit was only lowered for this sample
+    sampling_profiler_arm(env);
+
+    // the consumer may disable the profiler, so this goes last
+    if (++profiler->count == profiler->capacity) {
+        sampling_profiler_flush(env);
+    }
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include <time.h>
+#include "callbacks.h"
+#include "tb_stats.h"
+
+tb_stats_t *tb_stats_create(uint32_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    tb_stats_t *stats = tlib_malloc(sizeof(tb_stats_t) + (uint64_t)capacity * sizeof(tb_stats_record_t));
+    memset(stats, 0, sizeof(tb_stats_t));
+    stats->record_size = sizeof(tb_stats_record_t);
+    stats->capacity = capacity;
+    return stats;
+}
+
+void tb_stats_destroy(tb_stats_t *stats)
+{
+    tlib_free(stats);
+}
+
+uint64_t tb_stats_snapshot_size(tb_stats_t *stats)
+{
+    return sizeof(tb_stats_t) + (uint64_t)stats->count * sizeof(tb_stats_record_t);
+}
+
+tb_stats_record_t *tb_stats_new_record(tb_stats_t *stats)
+{
+    if (stats->count == stats->capacity) {
+        stats->untracked++;
+        return NULL;
+    }
+    tb_stats_record_t *record = &stats->records[stats->count++];
+    memset(record, 0, sizeof(tb_stats_record_t));
+    return record;
+}
+
+uint64_t tb_stats_get_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
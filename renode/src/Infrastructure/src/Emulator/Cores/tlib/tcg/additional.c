@@ -97,6 +97,7 @@ unsigned int tlb_table_n_0[MMU_MODES_MAX];
 unsigned int tlb_table_n_0_addr_read[MMU_MODES_MAX];
 unsigned int tlb_table_n_0_addr_write[MMU_MODES_MAX];
 unsigned int tlb_table_n_0_addend[MMU_MODES_MAX];
+unsigned int tlb_mask_offset;
 unsigned int tlb_entry_addr_read;
 unsigned int tlb_entry_addr_write;
 unsigned int tlb_entry_addend;
@@ -130,6 +131,11 @@ void set_tlb_table_n_0(int i, unsigned int offset)
     tlb_table_n_0[i] = offset;
 }
 
+void set_tlb_mask_offset(unsigned int offset)
+{
+    tlb_mask_offset = offset;
+}
+
 void set_tlb_table_n_0_rwa(int i, unsigned int read, unsigned int write, unsigned int addend)
 {
     tlb_table_n_0_addr_read[i] = read;
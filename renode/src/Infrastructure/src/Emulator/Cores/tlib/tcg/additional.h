@@ -19,6 +19,7 @@ extern unsigned int tlb_table_n_0_addr_read[MMU_MODES_MAX];
 extern unsigned int tlb_table_n_0_addr_write[MMU_MODES_MAX];
 extern unsigned int tlb_table_n_0_addend[MMU_MODES_MAX];
 extern unsigned int tlb_table_n_0[MMU_MODES_MAX];
+extern unsigned int tlb_mask_offset;
 extern unsigned int tlb_entry_addr_read;
 extern unsigned int tlb_entry_addr_write;
 extern unsigned int tlb_entry_addend;
@@ -22,6 +22,8 @@
  * THE SOFTWARE.
  */
 
+#include <cpuid.h>
+
 /* *INDENT-OFF* */
 static const int tcg_target_reg_alloc_order[] = {
 #if TCG_TARGET_REG_BITS == 64
@@ -40,6 +42,22 @@ static const int tcg_target_reg_alloc_order[] = {
     TCG_REG_RSI,
     TCG_REG_RDI,
     TCG_REG_RAX,
+    TCG_REG_XMM0,
+    TCG_REG_XMM1,
+    TCG_REG_XMM2,
+    TCG_REG_XMM3,
+    TCG_REG_XMM4,
+    TCG_REG_XMM5,
+    TCG_REG_XMM6,
+    TCG_REG_XMM7,
+    TCG_REG_XMM8,
+    TCG_REG_XMM9,
+    TCG_REG_XMM10,
+    TCG_REG_XMM11,
+    TCG_REG_XMM12,
+    TCG_REG_XMM13,
+    TCG_REG_XMM14,
+    TCG_REG_XMM15,
 #else
     TCG_REG_EBX,
     TCG_REG_ESI,
@@ -80,6 +98,13 @@ static const int tcg_target_call_oarg_regs[] = {
 
 /* *INDENT-ON* */
 
+#if defined(_WIN64)
+/* XMM6-XMM15 are callee-saved on Windows, the prologue doesn't save them */
+#define ALL_VECTOR_REGS 0x003f0000
+#else
+#define ALL_VECTOR_REGS 0xffff0000
+#endif
+
 static uint8_t *tb_ret_addr;
 
 static void patch_reloc(uint8_t *code_ptr, int type, tcg_target_long value, tcg_target_long addend)
@@ -195,6 +220,11 @@ static int target_parse_constraint(TCGArgConstraint *ct, const char **pct_str)
         }
         break;
 
+    case 'x':
+        ct->ct |= TCG_CT_REG;
+        tcg_regset_set32(ct->u.regs, 0, ALL_VECTOR_REGS);
+        break;
+
     case 'e':
         ct->ct |= TCG_CT_CONST_S32;
         break;
@@ -239,17 +269,22 @@ static inline int tcg_target_const_match(tcg_target_long val, const TCGArgConstr
 # define P_REXW         0x800           /* Set REX.W = 1 */
 # define P_REXB_R       0x1000          /* REG field as byte register */
 # define P_REXB_RM      0x2000          /* R/M field as byte register */
+# define P_SIMDF3       0x4000          /* 0xf3 opcode prefix */
+# define P_SIMDF2       0x8000          /* 0xf2 opcode prefix */
 #else
 # define P_ADDR32       0
 # define P_REXW         0
 # define P_REXB_R       0
 # define P_REXB_RM      0
+# define P_SIMDF3       0
+# define P_SIMDF2       0
 #endif
 
 #define OPC_ARITH_EvIz  (0x81)
 #define OPC_ARITH_EvIb  (0x83)
 #define OPC_ARITH_GvEv  (0x03)          /* ... plus (ARITH_FOO << 3) */
 #define OPC_ADD_GvEv    (OPC_ARITH_GvEv | (ARITH_ADD << 3))
+#define OPC_AND_GvEv    (OPC_ARITH_GvEv | (ARITH_AND << 3))
 #define OPC_BSWAP       (0xc8 | P_EXT)
 #define OPC_CALL_Jz     (0xe8)
 #define OPC_CMOVCC      (0x40 | P_EXT)  /* ... plus condition code */
@@ -289,6 +324,39 @@ static inline int tcg_target_const_match(tcg_target_long val, const TCGArgConstr
 #define OPC_GRP3_Ev     (0xf7)
 #define OPC_GRP5        (0xff)
 
+/* SSE2, only emitted on 64-bit hosts */
+#define OPC_MOVD_VyEy   (0x6e | P_EXT | P_DATA16)   /* with P_REXW: movq xmm, r64 */
+#define OPC_MOVDQA_VxWx (0x6f | P_EXT | P_DATA16)
+#define OPC_MOVDQU_VxWx (0x6f | P_EXT | P_SIMDF3)
+#define OPC_MOVDQU_WxVx (0x7f | P_EXT | P_SIMDF3)
+#define OPC_MOVQ_VqWq   (0x7e | P_EXT | P_SIMDF3)
+#define OPC_MOVQ_WqVq   (0xd6 | P_EXT | P_DATA16)
+#define OPC_PADDB       (0xfc | P_EXT | P_DATA16)
+#define OPC_PADDW       (0xfd | P_EXT | P_DATA16)
+#define OPC_PADDD       (0xfe | P_EXT | P_DATA16)
+#define OPC_PADDQ       (0xd4 | P_EXT | P_DATA16)
+#define OPC_PAND        (0xdb | P_EXT | P_DATA16)
+#define OPC_PANDN       (0xdf | P_EXT | P_DATA16)
+#define OPC_PINSRW      (0xc4 | P_EXT | P_DATA16)
+#define OPC_PMAXSW      (0xee | P_EXT | P_DATA16)
+#define OPC_PMAXUB      (0xde | P_EXT | P_DATA16)
+#define OPC_PMINSW      (0xea | P_EXT | P_DATA16)
+#define OPC_PMINUB      (0xda | P_EXT | P_DATA16)
+#define OPC_PMULLW      (0xd5 | P_EXT | P_DATA16)
+#define OPC_POR         (0xeb | P_EXT | P_DATA16)
+#define OPC_PSHIFTW_Ib  (0x71 | P_EXT | P_DATA16)   /* /2 /4 /6 */
+#define OPC_PSHIFTD_Ib  (0x72 | P_EXT | P_DATA16)   /* /2 /4 /6 */
+#define OPC_PSHIFTQ_Ib  (0x73 | P_EXT | P_DATA16)   /* /2 /6 */
+#define OPC_PSHUFD      (0x70 | P_EXT | P_DATA16)
+#define OPC_PSHUFLW     (0x70 | P_EXT | P_SIMDF2)
+#define OPC_PSUBB       (0xf8 | P_EXT | P_DATA16)
+#define OPC_PSUBW       (0xf9 | P_EXT | P_DATA16)
+#define OPC_PSUBD       (0xfa | P_EXT | P_DATA16)
+#define OPC_PSUBQ       (0xfb | P_EXT | P_DATA16)
+#define OPC_PUNPCKLBW   (0x60 | P_EXT | P_DATA16)
+#define OPC_PUNPCKLQDQ  (0x6c | P_EXT | P_DATA16)
+#define OPC_PXOR        (0xef | P_EXT | P_DATA16)
+
 /* Group 1 opcode extensions for 0x80-0x83.
    These are also used as modifiers for OPC_ARITH.  */
 #define ARITH_ADD       0
@@ -315,6 +383,11 @@ static inline int tcg_target_const_match(tcg_target_long val, const TCGArgConstr
 #define EXT3_DIV        6
 #define EXT3_IDIV       7
 
+/* Group 12-14 opcode extensions for the SSE2 shifts by an immediate.  */
+#define EXT_PSHIFT_SRL  2
+#define EXT_PSHIFT_SRA  4
+#define EXT_PSHIFT_SLL  6
+
 /* Group 5 opcode extensions for 0xff.  To be used with OPC_GRP5.  */
 #define EXT5_INC_Ev     0
 #define EXT5_DEC_Ev     1
@@ -351,10 +424,16 @@ static void tcg_out_opc(TCGContext *s, int opc, int r, int rm, int x)
     int rex;
 
     if (opc & P_DATA16) {
-        /* We should never be asking for both 16 and 64-bit operation.  */
-        assert((opc & P_REXW) == 0);
+        /* We should never be asking for both 16 and 64-bit operation,
+           for SSE instructions 0x66 is a part of the opcode.  */
+        assert((opc & P_REXW) == 0 || (opc & P_EXT));
         tcg_out8(s, 0x66);
     }
+    if (opc & P_SIMDF3) {
+        tcg_out8(s, 0xf3);
+    } else if (opc & P_SIMDF2) {
+        tcg_out8(s, 0xf2);
+    }
     if (opc & P_ADDR32) {
         tcg_out8(s, 0x67);
     }
@@ -510,6 +589,10 @@ static inline void tcg_out_mov(TCGContext *s, TCGType type, TCGReg ret, TCGReg a
 {
     if (arg != ret) {
         int opc = OPC_MOVL_GvEv + (type == TCG_TYPE_I64 ? P_REXW : 0);
+        if (type >= TCG_TYPE_V64) {
+            /* the whole register, also for V64 */
+            opc = OPC_MOVDQA_VxWx;
+        }
         tcg_out_modrm(s, opc, ret, arg);
     }
 }
@@ -557,13 +640,35 @@ static inline void tcg_out_pop(TCGContext *s, int reg)
 
 static inline void tcg_out_ld(TCGContext *s, TCGType type, TCGReg ret, TCGReg arg1, tcg_target_long arg2)
 {
-    int opc = OPC_MOVL_GvEv + (type == TCG_TYPE_I64 ? P_REXW : 0);
+    int opc;
+    switch (type) {
+    case TCG_TYPE_V64:
+        opc = OPC_MOVQ_VqWq;
+        break;
+    case TCG_TYPE_V128:
+        opc = OPC_MOVDQU_VxWx;
+        break;
+    default:
+        opc = OPC_MOVL_GvEv + (type == TCG_TYPE_I64 ? P_REXW : 0);
+        break;
+    }
     tcg_out_modrm_offset(s, opc, ret, arg1, arg2);
 }
 
 static inline void tcg_out_st(TCGContext *s, TCGType type, TCGReg arg, TCGReg arg1, tcg_target_long arg2)
 {
-    int opc = OPC_MOVL_EvGv + (type == TCG_TYPE_I64 ? P_REXW : 0);
+    int opc;
+    switch (type) {
+    case TCG_TYPE_V64:
+        opc = OPC_MOVQ_WqVq;
+        break;
+    case TCG_TYPE_V128:
+        opc = OPC_MOVDQU_WxVx;
+        break;
+    default:
+        opc = OPC_MOVL_EvGv + (type == TCG_TYPE_I64 ? P_REXW : 0);
+        break;
+    }
     tcg_out_modrm_offset(s, opc, arg, arg1, arg2);
 }
 
@@ -966,7 +1071,8 @@ static inline void tcg_out_tlb_load(TCGContext *s, int addrlo_idx, int mem_index
     const int addrlo = args[addrlo_idx];
 
     tgen_arithi(s, ARITH_AND + rexw, r0, TARGET_PAGE_MASK | ((1 << s_bits) - 1), 0);
-    tgen_arithi(s, ARITH_AND + rexw, r1, (CPU_TLB_SIZE - 1) << CPU_TLB_ENTRY_BITS, 0);
+    /* and tlb_mask(env), r1 -- the TLB size can change at runtime */
+    tcg_out_modrm_offset(s, OPC_AND_GvEv + rexw, r1, TCG_AREG0, tlb_mask_offset);
 
     tcg_out_modrm_sib_offset(s, OPC_LEA + P_REXW, r1, TCG_AREG0, r1, 0,
                              /* offsetof(CPUState, tlb_table[mem_index][0]) */ tlb_table_n_0[mem_index] + which);
@@ -1379,6 +1485,171 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args, int opc)
     }
 }
 
+#if TCG_TARGET_MAYBE_vec
+/* Replicate the low VECE element of the general register A into every lane of R */
+static void tcg_out_dup_vec(TCGContext *s, unsigned vece, TCGReg r, TCGReg a)
+{
+    tcg_out_modrm(s, OPC_MOVD_VyEy + (vece == MO_64 ? P_REXW : 0), r, a);
+    switch (vece) {
+    case MO_8:
+        tcg_out_modrm(s, OPC_PUNPCKLBW, r, r);
+        /* FALLTHRU */
+    case MO_16:
+        tcg_out_modrm(s, OPC_PSHUFLW, r, r);
+        tcg_out8(s, 0);
+        /* FALLTHRU */
+    case MO_32:
+        tcg_out_modrm(s, OPC_PSHUFD, r, r);
+        tcg_out8(s, 0);
+        break;
+    case MO_64:
+        tcg_out_modrm(s, OPC_PUNPCKLQDQ, r, r);
+        break;
+    default:
+        tcg_abort();
+    }
+}
+
+/* Same for an element loaded from memory; bytes can't be loaded without SSE4.1 */
+static void tcg_out_dupm_vec(TCGContext *s, unsigned vece, TCGReg r, TCGReg base, tcg_target_long offset)
+{
+    switch (vece) {
+    case MO_16:
+        tcg_out_modrm_offset(s, OPC_PINSRW, r, base, offset);
+        tcg_out8(s, 0);
+        tcg_out_modrm(s, OPC_PSHUFLW, r, r);
+        tcg_out8(s, 0);
+        tcg_out_modrm(s, OPC_PSHUFD, r, r);
+        tcg_out8(s, 0);
+        break;
+    case MO_32:
+        tcg_out_modrm_offset(s, OPC_MOVD_VyEy, r, base, offset);
+        tcg_out_modrm(s, OPC_PSHUFD, r, r);
+        tcg_out8(s, 0);
+        break;
+    case MO_64:
+        tcg_out_modrm_offset(s, OPC_MOVQ_VqWq, r, base, offset);
+        tcg_out_modrm(s, OPC_PUNPCKLQDQ, r, r);
+        break;
+    default:
+        tcg_abort();
+    }
+}
+
+/* The SSE2 encodings are two-operand: the output is always tied to an input, see x86_op_defs */
+static void tcg_out_vec_op(TCGContext *s, TCGOpcode opc, const TCGArg *args)
+{
+    static const int add_insn[4] = { OPC_PADDB, OPC_PADDW, OPC_PADDD, OPC_PADDQ };
+    static const int sub_insn[4] = { OPC_PSUBB, OPC_PSUBW, OPC_PSUBD, OPC_PSUBQ };
+    TCGArg vec_arg = args[tcg_op_defs[opc].nb_args - 1];
+    TCGType type = TCG_VEC_ARG_TYPE(vec_arg);
+    unsigned vece = TCG_VEC_ARG_VECE(vec_arg);
+    int insn, ext;
+
+    switch (opc) {
+    case INDEX_op_ld_vec:
+        tcg_out_ld(s, type, args[0], args[1], args[2]);
+        return;
+    case INDEX_op_st_vec:
+        tcg_out_st(s, type, args[0], args[1], args[2]);
+        return;
+    case INDEX_op_dup_vec:
+        tcg_out_dup_vec(s, vece, args[0], args[1]);
+        return;
+    case INDEX_op_dupm_vec:
+        tcg_out_dupm_vec(s, vece, args[0], args[1], args[2]);
+        return;
+
+    case INDEX_op_andc_vec:
+        /* pandn computes ~dst & src, so the output is tied to the second input */
+        tcg_out_modrm(s, OPC_PANDN, args[0], args[1]);
+        return;
+
+    case INDEX_op_shli_vec:
+        ext = EXT_PSHIFT_SLL;
+        goto gen_shift;
+    case INDEX_op_shri_vec:
+        ext = EXT_PSHIFT_SRL;
+        goto gen_shift;
+    case INDEX_op_sari_vec:
+        ext = EXT_PSHIFT_SRA;
+    gen_shift:
+        tcg_out_modrm(s, OPC_PSHIFTW_Ib + vece - MO_16, ext, args[0]);
+        tcg_out8(s, args[2]);
+        return;
+
+    case INDEX_op_add_vec:
+        insn = add_insn[vece];
+        break;
+    case INDEX_op_sub_vec:
+        insn = sub_insn[vece];
+        break;
+    case INDEX_op_mul_vec:
+        insn = OPC_PMULLW;
+        break;
+    case INDEX_op_and_vec:
+        insn = OPC_PAND;
+        break;
+    case INDEX_op_or_vec:
+        insn = OPC_POR;
+        break;
+    case INDEX_op_xor_vec:
+        insn = OPC_PXOR;
+        break;
+    case INDEX_op_umin_vec:
+        insn = OPC_PMINUB;
+        break;
+    case INDEX_op_umax_vec:
+        insn = OPC_PMAXUB;
+        break;
+    case INDEX_op_smin_vec:
+        insn = OPC_PMINSW;
+        break;
+    case INDEX_op_smax_vec:
+        insn = OPC_PMAXSW;
+        break;
+    default:
+        tcg_abort();
+    }
+    tcg_out_modrm(s, insn, args[0], args[2]);
+}
+
+int tcg_can_emit_vec_op(TCGOpcode opc, TCGType type, unsigned vece)
+{
+    switch (opc) {
+    case INDEX_op_add_vec:
+    case INDEX_op_sub_vec:
+    case INDEX_op_and_vec:
+    case INDEX_op_or_vec:
+    case INDEX_op_xor_vec:
+    case INDEX_op_andc_vec:
+        return 1;
+    case INDEX_op_dupm_vec:
+    case INDEX_op_shli_vec:
+    case INDEX_op_shri_vec:
+        return vece != MO_8;
+    case INDEX_op_sari_vec:
+        return vece == MO_16 || vece == MO_32;
+    case INDEX_op_mul_vec:
+    case INDEX_op_smin_vec:
+    case INDEX_op_smax_vec:
+        return vece == MO_16;
+    case INDEX_op_umin_vec:
+    case INDEX_op_umax_vec:
+        return vece == MO_8;
+    default:
+        /* Everything else is expanded by the generic code */
+        return 0;
+    }
+}
+
+void tcg_expand_vec_op(TCGOpcode opc, TCGType type, unsigned vece, TCGArg a0, ...)
+{
+    /* tcg_can_emit_vec_op never asks for a backend expansion */
+    tcg_abort();
+}
+#endif
+
 /* *INDENT-OFF* */
 
 static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
@@ -1754,6 +2025,12 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         break;
 
     default:
+#if TCG_TARGET_MAYBE_vec
+        if (tcg_op_defs[opc].flags & TCG_OPF_VECTOR) {
+            tcg_out_vec_op(s, opc, args);
+            break;
+        }
+#endif
         tcg_abort();
     }
 
@@ -1873,6 +2150,26 @@ static const TCGTargetOpDef x86_op_defs[] = {
 
     { INDEX_op_mulu2_i64, { "a", "d", "a", "r" } },
     { INDEX_op_muls2_i64, { "a", "d", "a", "r" } },
+
+    { INDEX_op_mov_vec, { "x", "x" } },
+    { INDEX_op_ld_vec, { "x", "r" } },
+    { INDEX_op_st_vec, { "x", "r" } },
+    { INDEX_op_dup_vec, { "x", "r" } },
+    { INDEX_op_dupm_vec, { "x", "r" } },
+    { INDEX_op_add_vec, { "x", "0", "x" } },
+    { INDEX_op_sub_vec, { "x", "0", "x" } },
+    { INDEX_op_mul_vec, { "x", "0", "x" } },
+    { INDEX_op_and_vec, { "x", "0", "x" } },
+    { INDEX_op_or_vec, { "x", "0", "x" } },
+    { INDEX_op_xor_vec, { "x", "0", "x" } },
+    { INDEX_op_andc_vec, { "x", "x", "0" } },
+    { INDEX_op_smin_vec, { "x", "0", "x" } },
+    { INDEX_op_umin_vec, { "x", "0", "x" } },
+    { INDEX_op_smax_vec, { "x", "0", "x" } },
+    { INDEX_op_umax_vec, { "x", "0", "x" } },
+    { INDEX_op_shli_vec, { "x", "0" } },
+    { INDEX_op_shri_vec, { "x", "0" } },
+    { INDEX_op_sari_vec, { "x", "0" } },
 #endif
 
 #if TCG_TARGET_REG_BITS == 64
@@ -1974,6 +2271,31 @@ static void tcg_target_qemu_prologue(TCGContext *s)
     tcg_out_opc(s, OPC_RET, 0, 0, 0);
 }
 
+bool have_sse2;
+bool have_avx2;
+
+static void detect_host_vector_features(void)
+{
+    unsigned a, b, c, d;
+    unsigned max_leaf = __get_cpuid_max(0, 0);
+
+    if (max_leaf < 1) {
+        return;
+    }
+    __cpuid(1, a, b, c, d);
+    have_sse2 = (d & bit_SSE2) != 0;
+
+    /* AVX2 also needs the OS to save the YMM state on context switches */
+    if (max_leaf >= 7 && (c & bit_OSXSAVE) && (c & bit_AVX)) {
+        unsigned xcr0_low, xcr0_high;
+        asm volatile ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+        if ((xcr0_low & 6) == 6) {
+            __cpuid_count(7, 0, a, b, c, d);
+            have_avx2 = (b & bit_AVX2) != 0;
+        }
+    }
+}
+
 static void tcg_target_init(TCGContext *s)
 {
     /* fail safe */
@@ -1981,9 +2303,15 @@ static void tcg_target_init(TCGContext *s)
         tcg_abort();
     }
 
+    detect_host_vector_features();
+
     if (TCG_TARGET_REG_BITS == 64) {
         tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_I32], 0, 0xffff);
         tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_I64], 0, 0xffff);
+        if (have_sse2) {
+            tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_V64], 0, ALL_VECTOR_REGS);
+            tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_V128], 0, ALL_VECTOR_REGS);
+        }
     } else {
         tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_I32], 0, 0xff);
     }
@@ -2001,6 +2329,8 @@ static void tcg_target_init(TCGContext *s)
         tcg_regset_set_reg(tcg_target_call_clobber_regs, TCG_REG_R9);
         tcg_regset_set_reg(tcg_target_call_clobber_regs, TCG_REG_R10);
         tcg_regset_set_reg(tcg_target_call_clobber_regs, TCG_REG_R11);
+        /* none of the vector registers survives a call, on Windows the others aren't used */
+        tcg_regset_set32(tcg_target_call_clobber_regs, 0, ALL_VECTOR_REGS);
     }
 
     tcg_regset_clear(s->reserved_regs);
@@ -28,7 +28,7 @@
 //#define TCG_TARGET_WORDS_BIGENDIAN
 
 #if TCG_TARGET_REG_BITS == 64
-# define TCG_TARGET_NB_REGS 16
+# define TCG_TARGET_NB_REGS 32
 #else
 # define TCG_TARGET_NB_REGS 8
 #endif
@@ -53,6 +53,25 @@ typedef enum {
     TCG_REG_R13,
     TCG_REG_R14,
     TCG_REG_R15,
+
+    /* SSE registers, only used on 64-bit hosts */
+    TCG_REG_XMM0,
+    TCG_REG_XMM1,
+    TCG_REG_XMM2,
+    TCG_REG_XMM3,
+    TCG_REG_XMM4,
+    TCG_REG_XMM5,
+    TCG_REG_XMM6,
+    TCG_REG_XMM7,
+    TCG_REG_XMM8,
+    TCG_REG_XMM9,
+    TCG_REG_XMM10,
+    TCG_REG_XMM11,
+    TCG_REG_XMM12,
+    TCG_REG_XMM13,
+    TCG_REG_XMM14,
+    TCG_REG_XMM15,
+
     TCG_REG_RAX = TCG_REG_EAX,
     TCG_REG_RCX = TCG_REG_ECX,
     TCG_REG_RDX = TCG_REG_EDX,
@@ -126,6 +145,40 @@ typedef enum {
 #define TCG_TARGET_HAS_qemu_st8_i32  1
 #endif
 
+/* Host SIMD extensions, detected in tcg_target_init.  SSE2 enables the vector
+   ops below; AVX2 is only used by the out-of-line gvec helpers to pick a wider
+   implementation.  */
+extern bool have_sse2;
+extern bool have_avx2;
+
+#if TCG_TARGET_REG_BITS == 64
+/* Basic integer vector ops on the SSE registers, anything else is expanded
+   with i64 ops or handled by the out-of-line helpers */
+#define TCG_TARGET_HAS_v64           have_sse2
+#define TCG_TARGET_HAS_v128          have_sse2
+#define TCG_TARGET_HAS_v256          0
+
+#define TCG_TARGET_HAS_andc_vec      1
+#define TCG_TARGET_HAS_orc_vec       0
+#define TCG_TARGET_HAS_nand_vec      0
+#define TCG_TARGET_HAS_nor_vec       0
+#define TCG_TARGET_HAS_eqv_vec       0
+#define TCG_TARGET_HAS_not_vec       0
+#define TCG_TARGET_HAS_neg_vec       0
+#define TCG_TARGET_HAS_abs_vec       0
+#define TCG_TARGET_HAS_roti_vec      0
+#define TCG_TARGET_HAS_rots_vec      0
+#define TCG_TARGET_HAS_rotv_vec      0
+#define TCG_TARGET_HAS_shi_vec       1
+#define TCG_TARGET_HAS_shs_vec       0
+#define TCG_TARGET_HAS_shv_vec       0
+#define TCG_TARGET_HAS_mul_vec       1
+#define TCG_TARGET_HAS_sat_vec       0
+#define TCG_TARGET_HAS_minmax_vec    1
+#define TCG_TARGET_HAS_bitsel_vec    0
+#define TCG_TARGET_HAS_cmpsel_vec    0
+#endif
+
 // MOVBE isn't very common in non-Atom CPUs and it isn't currently supported by TCG.
 #define TCG_TARGET_HAS_MEMORY_BSWAP  0
 
@@ -267,6 +267,71 @@ static TCGArg do_constant_folding(TCGOpcode op, TCGArg x, TCGArg y)
 
 /* *INDENT-OFF* */
 
+static TCGArg op_mask(TCGOpcode op)
+{
+    return op_bits(op) == 32 ? 0xffffffff : (TCGArg) - 1;
+}
+
+enum {
+    OP_RESULT_UNKNOWN,
+    OP_RESULT_ARG1,
+    OP_RESULT_ZERO,
+    OP_RESULT_ONES,
+};
+
+/* Check whether "X op Y" reduces to X or to a constant regardless of the
+   value of X.  Y is expected to be the constant operand, if any. */
+static int op_identity_result(TCGOpcode op, TCGArg x, TCGArg y)
+{
+    TCGArg mask = op_mask(op);
+    TCGArg val;
+
+    if (x == y) {
+        switch (op) {
+        CASE_OP_32_64(and):
+        CASE_OP_32_64(or):
+            return OP_RESULT_ARG1;
+        CASE_OP_32_64(sub):
+        CASE_OP_32_64(xor):
+            return OP_RESULT_ZERO;
+        default:
+            return OP_RESULT_UNKNOWN;
+        }
+    }
+    if (temps[y].state != TCG_TEMP_CONST) {
+        return OP_RESULT_UNKNOWN;
+    }
+    val = temps[y].val & mask;
+    switch (op) {
+    CASE_OP_32_64(add):
+    CASE_OP_32_64(sub):
+    CASE_OP_32_64(shl):
+    CASE_OP_32_64(shr):
+    CASE_OP_32_64(sar):
+    CASE_OP_32_64(rotl):
+    CASE_OP_32_64(rotr):
+    CASE_OP_32_64(xor):
+        return val == 0 ? OP_RESULT_ARG1 : OP_RESULT_UNKNOWN;
+    CASE_OP_32_64(or):
+        if (val == mask) {
+            return OP_RESULT_ONES;
+        }
+        return val == 0 ? OP_RESULT_ARG1 : OP_RESULT_UNKNOWN;
+    CASE_OP_32_64(and):
+        if (val == 0) {
+            return OP_RESULT_ZERO;
+        }
+        return val == mask ? OP_RESULT_ARG1 : OP_RESULT_UNKNOWN;
+    CASE_OP_32_64(mul):
+        if (val == 0) {
+            return OP_RESULT_ZERO;
+        }
+        return val == 1 ? OP_RESULT_ARG1 : OP_RESULT_UNKNOWN;
+    default:
+        return OP_RESULT_UNKNOWN;
+    }
+}
+
 /* Propagate constants and copies, fold constant expressions. */
 static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
                                     TCGArg *args, TCGOpDef *tcg_op_defs)
@@ -331,12 +396,17 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
         CASE_OP_32_64(sar):
         CASE_OP_32_64(rotl):
         CASE_OP_32_64(rotr):
+        CASE_OP_32_64(or):
+        CASE_OP_32_64(xor):
+        CASE_OP_32_64(and):
+        CASE_OP_32_64(mul):
             if (temps[args[1]].state == TCG_TEMP_CONST) {
                 /* Proceed with possible constant folding. */
                 break;
             }
-            if (temps[args[2]].state == TCG_TEMP_CONST
-                && temps[args[2]].val == 0) {
+            tmp = op_identity_result(op, args[1], args[2]);
+            if (tmp == OP_RESULT_ARG1) {
+                s->optimizer_counters[TCG_OPT_ALGEBRAIC_SIMPLIFICATIONS]++;
                 if ((temps[args[0]].state == TCG_TEMP_COPY
                     && temps[args[0]].val == args[1])
                     || args[0] == args[1]) {
@@ -351,33 +421,16 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
                 }
                 continue;
             }
-            break;
-        CASE_OP_32_64(mul):
-            if ((temps[args[2]].state == TCG_TEMP_CONST
-                && temps[args[2]].val == 0)) {
+            if (tmp != OP_RESULT_UNKNOWN) {
+                s->optimizer_counters[TCG_OPT_ALGEBRAIC_SIMPLIFICATIONS]++;
                 tcg->gen_opc_buf[op_index] = op_to_movi(op);
-                tcg_opt_gen_movi(gen_args, args[0], 0, nb_temps, nb_globals);
+                tcg_opt_gen_movi(gen_args, args[0], tmp == OP_RESULT_ZERO ? 0 : op_mask(op),
+                                 nb_temps, nb_globals);
                 args += 3;
                 gen_args += 2;
                 continue;
             }
             break;
-        CASE_OP_32_64(or):
-        CASE_OP_32_64(and):
-            if (args[1] == args[2]) {
-                if (args[1] == args[0]) {
-                    args += 3;
-                    tcg->gen_opc_buf[op_index] = INDEX_op_nop;
-                } else {
-                    tcg->gen_opc_buf[op_index] = op_to_mov(op);
-                    tcg_opt_gen_mov(s, gen_args, args[0], args[1], nb_temps,
-                                    nb_globals);
-                    gen_args += 2;
-                    args += 3;
-                }
-                continue;
-            }
-            break;
         default:
             break;
         }
@@ -421,6 +474,7 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
         case INDEX_op_ext32s_i64:
         case INDEX_op_ext32u_i64:
             if (temps[args[1]].state == TCG_TEMP_CONST) {
+                s->optimizer_counters[TCG_OPT_CONSTANTS_FOLDED]++;
                 tcg->gen_opc_buf[op_index] = op_to_movi(op);
                 tmp = do_constant_folding(op, temps[args[1]].val, 0);
                 tcg_opt_gen_movi(gen_args, args[0], tmp, nb_temps, nb_globals);
@@ -453,6 +507,7 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
         CASE_OP_32_64(nor):
             if (temps[args[1]].state == TCG_TEMP_CONST
                 && temps[args[2]].state == TCG_TEMP_CONST) {
+                s->optimizer_counters[TCG_OPT_CONSTANTS_FOLDED]++;
                 tcg->gen_opc_buf[op_index] = op_to_movi(op);
                 tmp = do_constant_folding(op, temps[args[1]].val,
                                           temps[args[2]].val);
@@ -516,11 +571,446 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
     return gen_args;
 }
 
+/* An env field whose current value is known to be held in a temp.  OP is the
+   load opcode which would produce VALUE when reading OFFSET. */
+struct tcg_env_value {
+    TCGOpcode op;
+    tcg_target_long offset;
+    int size;
+    TCGArg value;
+    bool from_store;
+};
+
+/* A store to an env field which no op has read yet.  ARGS point to its
+   arguments in the output buffer, so it can be turned into a nop later. */
+struct tcg_env_store {
+    tcg_target_long offset;
+    int size;
+    uint16_t *opc;
+    TCGArg *args;
+};
+
+/* The most recent write to a global that has not been read yet */
+struct tcg_global_write {
+    uint16_t *opc;
+    TCGArg *args;
+    int nb_args;
+};
+
+#define MAX_ENV_VALUES 32
+#define MAX_ENV_STORES 16
+
+static struct tcg_env_value env_values[MAX_ENV_VALUES];
+static int nb_env_values;
+static struct tcg_env_store env_stores[MAX_ENV_STORES];
+static int nb_env_stores;
+static struct tcg_global_write global_writes[TCG_MAX_TEMPS];
+
+/* Number of low bits a temp is known to be zero- or sign-extended from, 0 if unknown */
+static uint8_t temp_zext_bits[TCG_MAX_TEMPS];
+static uint8_t temp_sext_bits[TCG_MAX_TEMPS];
+
+static void tcg_opt_gen_nopn(uint16_t *opc, TCGArg *args, int nb_args)
+{
+    if (nb_args == 0) {
+        *opc = INDEX_op_nop;
+    } else {
+        *opc = INDEX_op_nopn;
+        args[0] = nb_args;
+        args[nb_args - 1] = nb_args;
+    }
+}
+
+/* Record what an op producing TEMP guarantees about its upper bits */
+static void set_temp_extension(TCGOpcode op, TCGArg temp)
+{
+    temp_zext_bits[temp] = 0;
+    temp_sext_bits[temp] = 0;
+    switch (op) {
+    case INDEX_op_ld8u_i32:
+    case INDEX_op_ld8u_i64:
+    CASE_OP_32_64(ext8u):
+    case INDEX_op_qemu_ld8u:
+        temp_zext_bits[temp] = 8;
+        break;
+    case INDEX_op_ld16u_i32:
+    case INDEX_op_ld16u_i64:
+    CASE_OP_32_64(ext16u):
+    case INDEX_op_qemu_ld16u:
+        temp_zext_bits[temp] = 16;
+        break;
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ext32u_i64:
+#if TCG_TARGET_REG_BITS == 64
+    case INDEX_op_qemu_ld32u:
+#endif
+        temp_zext_bits[temp] = 32;
+        break;
+    case INDEX_op_ld8s_i32:
+    case INDEX_op_ld8s_i64:
+    CASE_OP_32_64(ext8s):
+    case INDEX_op_qemu_ld8s:
+        temp_sext_bits[temp] = 8;
+        break;
+    case INDEX_op_ld16s_i32:
+    case INDEX_op_ld16s_i64:
+    CASE_OP_32_64(ext16s):
+    case INDEX_op_qemu_ld16s:
+        temp_sext_bits[temp] = 16;
+        break;
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_ext32s_i64:
+#if TCG_TARGET_REG_BITS == 64
+    case INDEX_op_qemu_ld32s:
+#endif
+        temp_sext_bits[temp] = 32;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Check whether the extension OP applied to SRC would not change its value */
+static bool extension_is_redundant(TCGOpcode op, TCGArg src)
+{
+    int bits, zext = temp_zext_bits[src], sext = temp_sext_bits[src];
+
+    switch (op) {
+    CASE_OP_32_64(ext8u):
+        return zext != 0 && zext <= 8;
+    CASE_OP_32_64(ext16u):
+        return zext != 0 && zext <= 16;
+    case INDEX_op_ext32u_i64:
+        return zext != 0 && zext <= 32;
+    CASE_OP_32_64(ext8s):
+        bits = 8;
+        break;
+    CASE_OP_32_64(ext16s):
+        bits = 16;
+        break;
+    case INDEX_op_ext32s_i64:
+        bits = 32;
+        break;
+    default:
+        return false;
+    }
+    return (sext != 0 && sext <= bits) || (zext != 0 && zext < bits);
+}
+
+static bool env_ranges_overlap(tcg_target_long off1, int size1, tcg_target_long off2, int size2)
+{
+    return off1 < off2 + size2 && off2 < off1 + size1;
+}
+
+/* Env fields backing globals are accessed behind the register allocator's
+   back, so they are never tracked */
+static bool is_tracked_env_access(TCGContext *s, TCGArg base, tcg_target_long offset, int size)
+{
+    int i;
+    TCGTemp *ts = &s->temps[base];
+
+    if (!ts->fixed_reg || ts->reg != TCG_AREG0) {
+        return false;
+    }
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (!ts->fixed_reg && ts->mem_reg == TCG_AREG0
+            && env_ranges_overlap(offset, size, ts->mem_offset, ts->type == TCG_TYPE_I64 ? 8 : 4)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* TEMP gets a new value: forget everything derived from the old one */
+static void env_values_forget_temp(TCGArg temp)
+{
+    int i;
+    for (i = 0; i < nb_env_values; i++) {
+        if (env_values[i].value == temp) {
+            env_values[i--] = env_values[--nb_env_values];
+        }
+    }
+    temp_zext_bits[temp] = 0;
+    temp_sext_bits[temp] = 0;
+}
+
+static void env_values_forget_range(tcg_target_long offset, int size)
+{
+    int i;
+    for (i = 0; i < nb_env_values; i++) {
+        if (env_ranges_overlap(env_values[i].offset, env_values[i].size, offset, size)) {
+            env_values[i--] = env_values[--nb_env_values];
+        }
+    }
+}
+
+/* Non-local temps do not survive the end of a basic block */
+static void env_values_forget_bb(TCGContext *s)
+{
+    int i;
+    for (i = 0; i < nb_env_values; i++) {
+        if (env_values[i].value >= s->nb_globals && !tcg_arg_is_local(s, env_values[i].value)) {
+            env_values[i--] = env_values[--nb_env_values];
+        }
+    }
+    for (i = s->nb_globals; i < s->nb_temps; i++) {
+        if (!tcg_arg_is_local(s, i)) {
+            temp_zext_bits[i] = 0;
+            temp_sext_bits[i] = 0;
+        }
+    }
+}
+
+static void forget_global_extensions(TCGContext *s)
+{
+    memset(temp_zext_bits, 0, s->nb_globals);
+    memset(temp_sext_bits, 0, s->nb_globals);
+}
+
+static void env_values_add(TCGOpcode op, tcg_target_long offset, int size, TCGArg value, bool from_store)
+{
+    if (nb_env_values == MAX_ENV_VALUES) {
+        /* Drop the oldest entry */
+        memmove(env_values, env_values + 1, (MAX_ENV_VALUES - 1) * sizeof(env_values[0]));
+        nb_env_values--;
+    }
+    env_values[nb_env_values++] = (struct tcg_env_value) {
+        .op = op, .offset = offset, .size = size, .value = value, .from_store = from_store
+    };
+}
+
+/* Stores overlapping the range are read, so they are not dead */
+static void env_stores_forget_range(tcg_target_long offset, int size)
+{
+    int i;
+    for (i = 0; i < nb_env_stores; i++) {
+        if (env_ranges_overlap(env_stores[i].offset, env_stores[i].size, offset, size)) {
+            env_stores[i--] = env_stores[--nb_env_stores];
+        }
+    }
+}
+
+static void env_stores_add(TCGContext *s, tcg_target_long offset, int size, uint16_t *opc, TCGArg *args)
+{
+    int i;
+    for (i = 0; i < nb_env_stores; i++) {
+        if (offset <= env_stores[i].offset && env_stores[i].offset + env_stores[i].size <= offset + size) {
+            tcg_opt_gen_nopn(env_stores[i].opc, env_stores[i].args, tcg_op_defs[*env_stores[i].opc].nb_args);
+            s->optimizer_counters[TCG_OPT_DEAD_STORES]++;
+            env_stores[i--] = env_stores[--nb_env_stores];
+        }
+    }
+    /* Overlapping stores are kept: they may still be partially visible */
+    if (nb_env_stores == MAX_ENV_STORES) {
+        memmove(env_stores, env_stores + 1, (MAX_ENV_STORES - 1) * sizeof(env_stores[0]));
+        nb_env_stores--;
+    }
+    env_stores[nb_env_stores++] = (struct tcg_env_store) {
+        .offset = offset, .size = size, .opc = opc, .args = args
+    };
+}
+
+/* Redundant env load elimination, store forwarding, dead env store and global
+   write elimination and removal of redundant extensions.  Works on extended basic
+   blocks: facts survive conditional branches (for globals and local temps) but
+   not labels.  Removed ops become nops, loads replaced by copies shrink to movs. */
+static TCGArg *tcg_eliminate_redundancy(TCGContext *s, uint16_t *tcg_opc_ptr, TCGArg *args)
+{
+    int i, nb_ops, op_index, nb_args, nb_oargs, nb_iargs, size;
+    TCGOpcode op;
+    const TCGOpDef *def;
+    TCGArg *gen_args, *io_args;
+    TCGArg arg;
+    bool removable;
+    int call_flags;
+
+    nb_env_values = 0;
+    nb_env_stores = 0;
+    memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+    memset(temp_zext_bits, 0, s->nb_temps);
+    memset(temp_sext_bits, 0, s->nb_temps);
+
+    nb_ops = tcg_opc_ptr - tcg->gen_opc_buf;
+    gen_args = args;
+    for (op_index = 0; op_index < nb_ops; op_index++) {
+        op = tcg->gen_opc_buf[op_index];
+        def = &tcg_op_defs[op];
+
+        switch (op) {
+        case INDEX_op_nop:
+            continue;
+        case INDEX_op_nopn:
+            nb_args = args[0];
+            memmove(gen_args, args, nb_args * sizeof(TCGArg));
+            args += nb_args;
+            gen_args += nb_args;
+            continue;
+        case INDEX_op_call:
+            nb_oargs = args[0] >> 16;
+            nb_iargs = args[0] & 0xffff;
+            nb_args = nb_oargs + nb_iargs + 3;
+            call_flags = args[nb_oargs + nb_iargs + 1];
+            break;
+        default:
+            nb_oargs = def->nb_oargs;
+            nb_iargs = def->nb_iargs;
+            nb_args = def->nb_args;
+            call_flags = 0;
+            break;
+        }
+
+        size = tcg_env_access_size(op);
+        if (size != 0 && def->nb_oargs == 1) {
+            /* env load */
+            if (is_tracked_env_access(s, args[1], args[2], size)) {
+                for (i = 0; i < nb_env_values; i++) {
+                    if (env_values[i].op == op && env_values[i].offset == (tcg_target_long)args[2]) {
+                        break;
+                    }
+                }
+                if (i < nb_env_values) {
+                    arg = env_values[i].value;
+                    s->optimizer_counters[env_values[i].from_store ? TCG_OPT_STORES_FORWARDED : TCG_OPT_LOADS_ELIMINATED]++;
+                    if (arg == args[0]) {
+                        tcg->gen_opc_buf[op_index] = INDEX_op_nop;
+                        args += nb_args;
+                        continue;
+                    }
+                    /* Rewrite as a copy and let the generic code below handle it */
+                    op = op_to_mov(op);
+                    tcg->gen_opc_buf[op_index] = op;
+                    args[2] = arg;
+                    args[1] = args[0];
+                    args++;
+                    def = &tcg_op_defs[op];
+                    nb_args = def->nb_args;
+                    nb_iargs = def->nb_iargs;
+                    size = 0;
+                } else {
+                    env_stores_forget_range(args[2], size);
+                }
+            } else {
+                /* Loads from other memory may alias any env field */
+                nb_env_stores = 0;
+            }
+        }
+        io_args = op == INDEX_op_call ? args + 1 : args;
+
+        /* Rewrite extensions of values that are already extended */
+        if (nb_oargs == 1 && nb_iargs == 1 && extension_is_redundant(op, args[1])) {
+            s->optimizer_counters[TCG_OPT_EXTENSIONS_ELIMINATED]++;
+            op = op_to_mov(op);
+            tcg->gen_opc_buf[op_index] = op;
+            def = &tcg_op_defs[op];
+        }
+
+        /* Memory and globals barriers */
+        if (op == INDEX_op_set_label) {
+            nb_env_values = 0;
+            nb_env_stores = 0;
+            memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+            memset(temp_zext_bits, 0, s->nb_temps);
+            memset(temp_sext_bits, 0, s->nb_temps);
+        } else if (op == INDEX_op_call) {
+            if (!(call_flags & TCG_CALL_CONST)) {
+                /* The helper may read env and globals */
+                nb_env_stores = 0;
+                memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+                if (!(call_flags & TCG_CALL_PURE)) {
+                    /* ...and write them */
+                    nb_env_values = 0;
+                    forget_global_extensions(s);
+                }
+            }
+        } else if (def->flags & (TCG_OPF_BB_END | TCG_OPF_CALL_CLOBBER)) {
+            nb_env_stores = 0;
+            memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+            if (def->flags & TCG_OPF_CALL_CLOBBER) {
+                nb_env_values = 0;
+                forget_global_extensions(s);
+            }
+        } else if ((def->flags & TCG_OPF_SIDE_EFFECTS) && size != 0) {
+            /* env store */
+            if (is_tracked_env_access(s, args[1], args[2], size)) {
+                env_values_forget_range(args[2], size);
+                env_stores_add(s, args[2], size, &tcg->gen_opc_buf[op_index], gen_args);
+                if (op == INDEX_op_st_i32 || op == INDEX_op_st_i64) {
+                    env_values_add(op == INDEX_op_st_i32 ? INDEX_op_ld_i32 : INDEX_op_ld_i64,
+                                   args[2], size, args[0], true);
+                }
+            } else {
+                nb_env_values = 0;
+                nb_env_stores = 0;
+            }
+        } else if (def->flags & TCG_OPF_SIDE_EFFECTS) {
+            nb_env_values = 0;
+            nb_env_stores = 0;
+            memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+        } else if (op == INDEX_op_ld_vec || op == INDEX_op_dupm_vec) {
+            /* Vector loads aren't tracked, they may read any pending store or global */
+            nb_env_stores = 0;
+            memset(global_writes, 0, s->nb_globals * sizeof(struct tcg_global_write));
+        }
+
+        /* Reading a global makes its last write live */
+        for (i = nb_oargs; i < nb_oargs + nb_iargs; i++) {
+            arg = io_args[i];
+            if (arg != TCG_CALL_DUMMY_ARG && arg < s->nb_globals) {
+                global_writes[arg].opc = NULL;
+            }
+        }
+
+        /* Outputs get new values */
+        removable = !(def->flags & (TCG_OPF_SIDE_EFFECTS | TCG_OPF_CALL_CLOBBER)) && nb_oargs == 1
+                    && op != INDEX_op_call && op != INDEX_op_discard && op != INDEX_op_insn_start;
+        for (i = 0; i < nb_oargs; i++) {
+            arg = io_args[i];
+            env_values_forget_temp(arg);
+            if (arg < s->nb_globals && !s->temps[arg].fixed_reg) {
+                if (global_writes[arg].opc != NULL) {
+                    tcg_opt_gen_nopn(global_writes[arg].opc, global_writes[arg].args, global_writes[arg].nb_args);
+                    s->optimizer_counters[TCG_OPT_DEAD_GLOBAL_WRITES]++;
+                }
+                global_writes[arg].opc = removable ? &tcg->gen_opc_buf[op_index] : NULL;
+                global_writes[arg].args = gen_args;
+                global_writes[arg].nb_args = nb_args;
+            }
+        }
+        if (op == INDEX_op_discard) {
+            env_values_forget_temp(args[0]);
+        }
+
+        if (nb_oargs == 1 && op != INDEX_op_call) {
+            if (op == INDEX_op_mov_i32 || op == INDEX_op_mov_i64) {
+                temp_zext_bits[args[0]] = temp_zext_bits[args[1]];
+                temp_sext_bits[args[0]] = temp_sext_bits[args[1]];
+            } else {
+                set_temp_extension(op, args[0]);
+            }
+            if (size != 0 && is_tracked_env_access(s, args[1], args[2], size)) {
+                env_values_add(op, args[2], size, args[0], false);
+            }
+        }
+
+        if (def->flags & TCG_OPF_BB_END) {
+            env_values_forget_bb(s);
+        }
+
+        memmove(gen_args, args, nb_args * sizeof(TCGArg));
+        args += nb_args;
+        gen_args += nb_args;
+    }
+
+    return gen_args;
+}
+
 /* *INDENT-ON* */
 
 TCGArg *tcg_optimize(TCGContext *s, uint16_t *tcg_opc_ptr, TCGArg *args, TCGOpDef *tcg_op_defs)
 {
     TCGArg *res;
     res = tcg_constant_folding(s, tcg_opc_ptr, args, tcg_op_defs);
+    res = tcg_eliminate_redundancy(s, tcg_opc_ptr, args);
     return res;
 }
@@ -11,6 +11,7 @@ void attach_st_helpers(void *__stb, void *__stw, void *__stl, void *__stq);
 void set_temp_buf_offset(unsigned int offset);
 void set_tlb_table_n_0_rwa(int i, unsigned int read, unsigned int write, unsigned int addend);
 void set_tlb_table_n_0(int i, unsigned int offset);
+void set_tlb_mask_offset(unsigned int offset);
 void set_TARGET_PAGE_BITS(int val);
 void set_sizeof_CPUTLBEntry(unsigned int sz);
 void set_tlb_entry_addr_rwu(unsigned int read, unsigned int write, unsigned int addend);
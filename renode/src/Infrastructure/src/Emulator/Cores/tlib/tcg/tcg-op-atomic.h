@@ -30,7 +30,7 @@
 #include "tcg-op.h"
 
 // These are based on TCG's 'nonatomic' functions.
-// tlib global memory locking makes them atomic.
+// tlib memory locking makes them atomic.
 
 static inline void tcg_gen_atomic_cmpxchg_i32(TCGv_i32 retv, TCGv addr, TCGv_i32 cmpv,
                                               TCGv_i32 newv, TCGArg idx, TCGMemOp memop)
@@ -42,11 +42,11 @@ static inline void tcg_gen_atomic_cmpxchg_i32(TCGv_i32 retv, TCGv addr, TCGv_i32
 
     tcg_gen_ext_i32(t2, cmpv, memop & MO_SIZE);
 
-    gen_helper_acquire_global_memory_lock(cpu_env);
+    gen_helper_acquire_memory_lock(cpu_env, addr);
     tcg_gen_qemu_ld_i32(t1, addr, idx, memop & ~MO_SIGN);
     tcg_gen_movcond_i32(TCG_COND_EQ, t2, t1, t2, newv, t1);
     tcg_gen_qemu_st_i32(t2, addr, idx, memop);
-    gen_helper_release_global_memory_lock(cpu_env);
+    gen_helper_release_memory_lock(cpu_env);
 
     tcg_temp_free_i32(t2);
 
@@ -68,11 +68,11 @@ static inline void tcg_gen_atomic_cmpxchg_i64(TCGv_i64 retv, TCGv addr, TCGv_i64
 
     tcg_gen_ext_i64(t2, cmpv, memop & MO_SIZE);
 
-    gen_helper_acquire_global_memory_lock(cpu_env);
+    gen_helper_acquire_memory_lock(cpu_env, addr);
     tcg_gen_qemu_ld_i64(t1, addr, idx, memop & ~MO_SIGN);
     tcg_gen_movcond_i64(TCG_COND_EQ, t2, t1, t2, newv, t1);
     tcg_gen_qemu_st_i64(t2, addr, idx, memop);
-    gen_helper_release_global_memory_lock(cpu_env);
+    gen_helper_release_memory_lock(cpu_env);
 
     tcg_temp_free_i64(t2);
 
@@ -94,12 +94,12 @@ static void do_atomic_op_i32(TCGv_i32 ret, TCGv addr, TCGv_i32 val,
 
     memop = tcg_canonicalize_memop(memop, 0, 0);
 
-    gen_helper_acquire_global_memory_lock(cpu_env);
+    gen_helper_acquire_memory_lock(cpu_env, addr);
     tcg_gen_qemu_ld_i32(t1, addr, idx, memop);
     tcg_gen_ext_i32(t2, val, memop);
     gen(t2, t1, t2);
     tcg_gen_qemu_st_i32(t2, addr, idx, memop);
-    gen_helper_release_global_memory_lock(cpu_env);
+    gen_helper_release_memory_lock(cpu_env);
 
     tcg_gen_ext_i32(ret, (new_val ? t2 : t1), memop);
     tcg_temp_free_i32(t1);
@@ -116,12 +116,12 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv addr, TCGv_i64 val,
 
     memop = tcg_canonicalize_memop(memop, 1, 0);
 
-    gen_helper_acquire_global_memory_lock(cpu_env);
+    gen_helper_acquire_memory_lock(cpu_env, addr);
     tcg_gen_qemu_ld_i64(t1, addr, idx, memop);
     tcg_gen_ext_i64(t2, val, memop);
     gen(t2, t1, t2);
     tcg_gen_qemu_st_i64(t2, addr, idx, memop);
-    gen_helper_release_global_memory_lock(cpu_env);
+    gen_helper_release_memory_lock(cpu_env);
 
     tcg_gen_ext_i64(ret, (new_val ? t2 : t1), memop);
     tcg_temp_free_i64(t1);
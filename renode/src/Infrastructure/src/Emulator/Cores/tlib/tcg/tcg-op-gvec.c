@@ -36,7 +36,10 @@
 #define ALIGN_DOWN(a, b) ((a) - ((a) % (b)))
 #define TCGv_NULL -1
 
-#define MAX_UNROLL  4
+/* The alternative to an inline expansion is a helper call per operation, so
+   allow up to 8 host vector or i64 operations (e.g. RISC-V vector register
+   groups with LMUL=8) to be unrolled.  */
+#define MAX_UNROLL  8
 
 #ifdef CONFIG_DEBUG_TCG
 static const TCGOpcode vecop_list_empty[1] = { 0 };
@@ -646,8 +649,8 @@ static void do_dup(unsigned vece, uint32_t dofs, uint32_t oprsz,
 
         if (in_32 != TCGv_NULL) {
             t_val = in_32;
-            t_val = tcg_temp_new_i32();
         } else if (in_64 != TCGv_NULL) {
+            t_val = tcg_temp_new_i32();
             tcg_gen_extrl_i64_i32(t_val, in_64);
         } else {
             t_val = tcg_constant_i32(in_c);
@@ -680,8 +683,8 @@ static void do_dup(unsigned vece, uint32_t dofs, uint32_t oprsz,
 
         if (in_32 != TCGv_NULL) {
             fns[vece](t_ptr, t_desc, in_32);
-            t_32 = tcg_temp_new_i32();
         } else if (in_64 != TCGv_NULL) {
+            t_32 = tcg_temp_new_i32();
             tcg_gen_extrl_i64_i32(t_32, in_64);
             fns[vece](t_ptr, t_desc, t_32);
             tcg_temp_free_i32(t_32);
@@ -151,11 +151,10 @@ void vec_gen_2(TCGOpcode opc, TCGType type, unsigned vece, TCGArg r, TCGArg a)
     #if !TCG_TARGET_MAYBE_vec
     vec_unsupported();
     #else
-    TCGOp *op = tcg_emit_op(opc, 2);
-    TCGOP_VECL(op) = type - TCG_TYPE_V64;
-    TCGOP_VECE(op) = vece;
-    op->args[0] = r;
-    op->args[1] = a;
+    *gen_opc_ptr++ = opc;
+    *gen_opparam_ptr++ = r;
+    *gen_opparam_ptr++ = a;
+    *gen_opparam_ptr++ = TCG_VEC_ARG(type, vece);
     #endif
 }
 
@@ -165,12 +164,11 @@ void vec_gen_3(TCGOpcode opc, TCGType type, unsigned vece,
     #if !TCG_TARGET_MAYBE_vec
     vec_unsupported();
     #else
-    TCGOp *op = tcg_emit_op(opc, 3);
-    TCGOP_VECL(op) = type - TCG_TYPE_V64;
-    TCGOP_VECE(op) = vece;
-    op->args[0] = r;
-    op->args[1] = a;
-    op->args[2] = b;
+    *gen_opc_ptr++ = opc;
+    *gen_opparam_ptr++ = r;
+    *gen_opparam_ptr++ = a;
+    *gen_opparam_ptr++ = b;
+    *gen_opparam_ptr++ = TCG_VEC_ARG(type, vece);
     #endif
 }
 
@@ -180,13 +178,12 @@ void vec_gen_4(TCGOpcode opc, TCGType type, unsigned vece,
     #if !TCG_TARGET_MAYBE_vec
     vec_unsupported();
     #else
-    TCGOp *op = tcg_emit_op(opc, 4);
-    TCGOP_VECL(op) = type - TCG_TYPE_V64;
-    TCGOP_VECE(op) = vece;
-    op->args[0] = r;
-    op->args[1] = a;
-    op->args[2] = b;
-    op->args[3] = c;
+    *gen_opc_ptr++ = opc;
+    *gen_opparam_ptr++ = r;
+    *gen_opparam_ptr++ = a;
+    *gen_opparam_ptr++ = b;
+    *gen_opparam_ptr++ = c;
+    *gen_opparam_ptr++ = TCG_VEC_ARG(type, vece);
     #endif
 }
 
@@ -196,15 +193,14 @@ static void vec_gen_6(TCGOpcode opc, TCGType type, unsigned vece, TCGArg r,
     #if !TCG_TARGET_MAYBE_vec
     vec_unsupported();
     #else
-    TCGOp *op = tcg_emit_op(opc, 6);
-    TCGOP_VECL(op) = type - TCG_TYPE_V64;
-    TCGOP_VECE(op) = vece;
-    op->args[0] = r;
-    op->args[1] = a;
-    op->args[2] = b;
-    op->args[3] = c;
-    op->args[4] = d;
-    op->args[5] = e;
+    *gen_opc_ptr++ = opc;
+    *gen_opparam_ptr++ = r;
+    *gen_opparam_ptr++ = a;
+    *gen_opparam_ptr++ = b;
+    *gen_opparam_ptr++ = c;
+    *gen_opparam_ptr++ = d;
+    *gen_opparam_ptr++ = e;
+    *gen_opparam_ptr++ = TCG_VEC_ARG(type, vece);
     #endif
 }
 
@@ -242,10 +238,25 @@ void tcg_gen_mov_vec(TCGv_vec r, TCGv_vec a)
 
 void tcg_gen_dupi_vec(unsigned vece, TCGv_vec r, uint64_t a)
 {
-    TCGTemp *rt = tcgv_vec_temp(r);
-    tcg_gen_mov_vec(r, tcg_constant_vec(rt->base_type, vece, a));
+    TCGv_i64 t = tcg_const_i64(dup_const(vece, a));
+    tcg_gen_dup_i64_vec(MO_64, r, t);
+    tcg_temp_free_i64(t);
+}
+
+#if TCG_TARGET_MAYBE_vec
+TCGv_vec tcg_constant_vec(TCGType type, unsigned vece, uint64_t a)
+{
+    TCGv_vec r = tcg_temp_new_vec(type);
+    tcg_gen_dupi_vec(vece, r, a);
+    return r;
 }
 
+TCGv_vec tcg_constant_vec_matching(TCGv_vec match, unsigned vece, int64_t val)
+{
+    return tcg_constant_vec(tcgv_vec_temp(match)->base_type, vece, val);
+}
+#endif
+
 void tcg_gen_dup_i64_vec(unsigned vece, TCGv_vec r, TCGv_i64 a)
 {
     TCGArg ri = tcgv_vec_arg(r);
@@ -283,7 +294,28 @@ void tcg_gen_dup_mem_vec(unsigned vece, TCGv_vec r, TCGv_ptr b,
     TCGTemp *rt = arg_temp(ri);
     TCGType type = rt->base_type;
 
-    vec_gen_3(INDEX_op_dupm_vec, type, vece, ri, bi, ofs);
+    if (tcg_can_emit_vec_op(INDEX_op_dupm_vec, type, vece) > 0) {
+        vec_gen_3(INDEX_op_dupm_vec, type, vece, ri, bi, ofs);
+    } else {
+        /* The host can't load a single element of this size into a vector register */
+        TCGv_i64 t = tcg_temp_new_i64();
+        switch (vece) {
+        case MO_8:
+            tcg_gen_ld8u_i64(t, b, ofs);
+            break;
+        case MO_16:
+            tcg_gen_ld16u_i64(t, b, ofs);
+            break;
+        case MO_32:
+            tcg_gen_ld32u_i64(t, b, ofs);
+            break;
+        default:
+            tcg_gen_ld_i64(t, b, ofs);
+            break;
+        }
+        tcg_gen_dup_i64_vec(vece, r, t);
+        tcg_temp_free_i64(t);
+    }
 }
 
 static void vec_gen_ldst(TCGOpcode opc, TCGv_vec r, TCGv_ptr b, TCGArg o)
@@ -2745,7 +2745,10 @@ static inline void tcg_gen_qemu_st64(TCGv_i64 arg, TCGv addr, int mem_index)
 }
 
 #define tcg_gen_ld_ptr(R, A, O) tcg_gen_ld_i32(TCGV_PTR_TO_NAT(R), (A), (O))
+#define tcg_gen_st_ptr(R, A, O) tcg_gen_st_i32(TCGV_PTR_TO_NAT(R), (A), (O))
 #define tcg_gen_discard_ptr(A)  tcg_gen_discard_i32(TCGV_PTR_TO_NAT(A))
+#define tcg_gen_brcondi_ptr(C, A, B, L) tcg_gen_brcondi_i32((C), TCGV_PTR_TO_NAT(A), (B), (L))
+#define tcg_gen_brcond_ptr(C, A, B, L) tcg_gen_brcond_i32((C), TCGV_PTR_TO_NAT(A), TCGV_PTR_TO_NAT(B), (L))
 
 #else /* TCG_TARGET_REG_BITS == 32 */
 
@@ -2813,7 +2816,10 @@ static inline void tcg_gen_qemu_st64(TCGv_i64 arg, TCGv addr, int mem_index)
 }
 
 #define tcg_gen_ld_ptr(R, A, O) tcg_gen_ld_i64(TCGV_PTR_TO_NAT(R), (A), (O))
+#define tcg_gen_st_ptr(R, A, O) tcg_gen_st_i64(TCGV_PTR_TO_NAT(R), (A), (O))
 #define tcg_gen_discard_ptr(A)  tcg_gen_discard_i64(TCGV_PTR_TO_NAT(A))
+#define tcg_gen_brcondi_ptr(C, A, B, L) tcg_gen_brcondi_i64((C), TCGV_PTR_TO_NAT(A), (B), (L))
+#define tcg_gen_brcond_ptr(C, A, B, L) tcg_gen_brcond_i64((C), TCGV_PTR_TO_NAT(A), TCGV_PTR_TO_NAT(B), (L))
 
 #endif /* TCG_TARGET_REG_BITS != 32 */
 
@@ -21,6 +21,7 @@
 
 #include "../include/bit_helper.h"
 #include "host-utils.h"
+#include "tcg.h"
 #include "tcg-gvec-desc.h"
 #include "tcg-runtime.h"
 
@@ -36,48 +37,40 @@ static inline void clear_high(void *d, intptr_t oprsz, uint32_t desc)
     }
 }
 
-void HELPER(gvec_add8)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_add8_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
         *(uint8_t *)(d + i) = *(uint8_t *)(a + i) + *(uint8_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_add16)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_add16_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
         *(uint16_t *)(d + i) = *(uint16_t *)(a + i) + *(uint16_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_add32)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_add32_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
         *(uint32_t *)(d + i) = *(uint32_t *)(a + i) + *(uint32_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_add64)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_add64_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) + *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_adds8)(void *d, void *a, uint64_t b, uint32_t desc)
@@ -124,48 +117,40 @@ void HELPER(gvec_adds64)(void *d, void *a, uint64_t b, uint32_t desc)
     clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_sub8)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_sub8_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
         *(uint8_t *)(d + i) = *(uint8_t *)(a + i) - *(uint8_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_sub16)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_sub16_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
         *(uint16_t *)(d + i) = *(uint16_t *)(a + i) - *(uint16_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_sub32)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_sub32_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
         *(uint32_t *)(d + i) = *(uint32_t *)(a + i) - *(uint32_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_sub64)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_sub64_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) - *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_subs8)(void *d, void *a, uint64_t b, uint32_t desc)
@@ -451,48 +436,154 @@ void HELPER(gvec_not)(void *d, void *a, uint32_t desc)
     clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_and)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_and_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) & *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_or)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_or_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) | *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_xor)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_xor_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) ^ *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
 }
 
-void HELPER(gvec_andc)(void *d, void *a, void *b, uint32_t desc)
+static void gvec_andc_scalar(void *d, void *a, void *b, intptr_t oprsz)
 {
-    intptr_t oprsz = simd_oprsz(desc);
     intptr_t i;
 
     for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
         *(uint64_t *)(d + i) = *(uint64_t *)(a + i) &~ *(uint64_t *)(b + i);
     }
-    clear_high(d, oprsz, desc);
+}
+
+/*
+ * The most common three-operand helpers are dispatched through function
+ * pointers chosen once in tcg_gvec_runtime_init, based on the SIMD
+ * extensions detected on the host.  The scalar loops above are the fallback.
+ */
+typedef void GVecFn3(void *d, void *a, void *b, intptr_t oprsz);
+
+#if defined(TCG_TARGET_I386)
+#include <immintrin.h>
+
+#define andnot_si128(x, y)  _mm_andnot_si128(y, x)
+#define andnot_si256(x, y)  _mm256_andnot_si256(y, x)
+
+/* oprsz is a multiple of 8, so at most an 8-byte tail is left after the 16-byte chunks */
+#define GVEC_3_X86(NAME, OP128, OP256)                                                    \
+static void __attribute__((target("sse2"))) NAME##_sse2(void *d, void *a, void *b, intptr_t oprsz) \
+{                                                                                         \
+    intptr_t i;                                                                           \
+                                                                                          \
+    for (i = 0; i + 16 <= oprsz; i += 16) {                                               \
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));                            \
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));                            \
+        _mm_storeu_si128((__m128i *)(d + i), OP128(x, y));                                \
+    }                                                                                     \
+    if (i < oprsz) {                                                                      \
+        __m128i x = _mm_loadl_epi64((const __m128i *)(a + i));                            \
+        __m128i y = _mm_loadl_epi64((const __m128i *)(b + i));                            \
+        _mm_storel_epi64((__m128i *)(d + i), OP128(x, y));                                \
+    }                                                                                     \
+}                                                                                         \
+                                                                                          \
+static void __attribute__((target("avx2"))) NAME##_avx2(void *d, void *a, void *b, intptr_t oprsz) \
+{                                                                                         \
+    intptr_t i;                                                                           \
+                                                                                          \
+    for (i = 0; i + 32 <= oprsz; i += 32) {                                               \
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));                         \
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));                         \
+        _mm256_storeu_si256((__m256i *)(d + i), OP256(x, y));                             \
+    }                                                                                     \
+    if (i < oprsz) {                                                                      \
+        NAME##_sse2(d + i, a + i, b + i, oprsz - i);                                      \
+    }                                                                                     \
+}
+
+GVEC_3_X86(gvec_add8, _mm_add_epi8, _mm256_add_epi8)
+GVEC_3_X86(gvec_add16, _mm_add_epi16, _mm256_add_epi16)
+GVEC_3_X86(gvec_add32, _mm_add_epi32, _mm256_add_epi32)
+GVEC_3_X86(gvec_add64, _mm_add_epi64, _mm256_add_epi64)
+GVEC_3_X86(gvec_sub8, _mm_sub_epi8, _mm256_sub_epi8)
+GVEC_3_X86(gvec_sub16, _mm_sub_epi16, _mm256_sub_epi16)
+GVEC_3_X86(gvec_sub32, _mm_sub_epi32, _mm256_sub_epi32)
+GVEC_3_X86(gvec_sub64, _mm_sub_epi64, _mm256_sub_epi64)
+GVEC_3_X86(gvec_and, _mm_and_si128, _mm256_and_si256)
+GVEC_3_X86(gvec_or, _mm_or_si128, _mm256_or_si256)
+GVEC_3_X86(gvec_xor, _mm_xor_si128, _mm256_xor_si256)
+GVEC_3_X86(gvec_andc, andnot_si128, andnot_si256)
+#endif
+
+#define GVEC_3_DISPATCH(NAME)                                                             \
+static GVecFn3 *NAME##_impl = NAME##_scalar;                                              \
+                                                                                          \
+void HELPER(NAME)(void *d, void *a, void *b, uint32_t desc)                               \
+{                                                                                         \
+    intptr_t oprsz = simd_oprsz(desc);                                                    \
+                                                                                          \
+    NAME##_impl(d, a, b, oprsz);                                                          \
+    clear_high(d, oprsz, desc);                                                           \
+}
+
+GVEC_3_DISPATCH(gvec_add8)
+GVEC_3_DISPATCH(gvec_add16)
+GVEC_3_DISPATCH(gvec_add32)
+GVEC_3_DISPATCH(gvec_add64)
+GVEC_3_DISPATCH(gvec_sub8)
+GVEC_3_DISPATCH(gvec_sub16)
+GVEC_3_DISPATCH(gvec_sub32)
+GVEC_3_DISPATCH(gvec_sub64)
+GVEC_3_DISPATCH(gvec_and)
+GVEC_3_DISPATCH(gvec_or)
+GVEC_3_DISPATCH(gvec_xor)
+GVEC_3_DISPATCH(gvec_andc)
+
+#if defined(TCG_TARGET_I386)
+#define GVEC_3_SELECT(NAME, SUFFIX) NAME##_impl = NAME##_##SUFFIX
+
+#define GVEC_3_SELECT_ALL(SUFFIX)          \
+    do {                                   \
+        GVEC_3_SELECT(gvec_add8, SUFFIX);  \
+        GVEC_3_SELECT(gvec_add16, SUFFIX); \
+        GVEC_3_SELECT(gvec_add32, SUFFIX); \
+        GVEC_3_SELECT(gvec_add64, SUFFIX); \
+        GVEC_3_SELECT(gvec_sub8, SUFFIX);  \
+        GVEC_3_SELECT(gvec_sub16, SUFFIX); \
+        GVEC_3_SELECT(gvec_sub32, SUFFIX); \
+        GVEC_3_SELECT(gvec_sub64, SUFFIX); \
+        GVEC_3_SELECT(gvec_and, SUFFIX);   \
+        GVEC_3_SELECT(gvec_or, SUFFIX);    \
+        GVEC_3_SELECT(gvec_xor, SUFFIX);   \
+        GVEC_3_SELECT(gvec_andc, SUFFIX);  \
+    } while (0)
+#endif
+
+void tcg_gvec_runtime_init(void)
+{
+#if defined(TCG_TARGET_I386)
+    if (have_avx2) {
+        GVEC_3_SELECT_ALL(avx2);
+    } else if (have_sse2) {
+        GVEC_3_SELECT_ALL(sse2);
+    }
+#endif
 }
 
 void HELPER(gvec_orc)(void *d, void *a, void *b, uint32_t desc)
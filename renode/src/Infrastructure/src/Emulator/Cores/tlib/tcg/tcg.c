@@ -24,7 +24,7 @@
 
 /* define it to use liveness analysis (better code) */
 // #define USE_LIVENESS_ANALYSIS
-// #define USE_TCG_OPTIMIZATIONS
+/* USE_TCG_OPTIMIZATIONS is set by the TCG_OPTIMIZATIONS CMake option */
 
 #include "additional.h"
 #include <stdarg.h>
@@ -69,7 +69,7 @@ TCGOpDef tcg_op_defs[] = {
 };
 const size_t tcg_op_defs_max = ARRAY_SIZE(tcg_op_defs);
 
-static TCGRegSet tcg_target_available_regs[2];
+static TCGRegSet tcg_target_available_regs[TCG_TYPE_COUNT];
 static TCGRegSet tcg_target_call_clobber_regs;
 
 /* XXX: move that inside the context */
@@ -273,6 +273,7 @@ void tcg_context_init()
         args_ct += n;
     }
     tcg_target_init(s);
+    tcg_gvec_runtime_init();
 }
 
 void tcg_context_use_tlb(int value)
@@ -542,6 +543,23 @@ void tcg_temp_free_i64(TCGv_i64 arg)
     tcg_temp_free_internal(GET_TCGV_I64(arg));
 }
 
+#if TCG_TARGET_MAYBE_vec
+TCGv_vec tcg_temp_new_vec(TCGType type)
+{
+    return tcg_temp_new_internal(type, 0);
+}
+
+TCGv_vec tcg_temp_new_vec_matching(TCGv_vec match)
+{
+    return tcg_temp_new_internal(tcgv_vec_temp(match)->base_type, 0);
+}
+
+void tcg_temp_free_vec(TCGv_vec arg)
+{
+    tcg_temp_free_internal(arg);
+}
+#endif
+
 TCGv_i32 tcg_const_i32(int32_t val)
 {
     TCGv_i32 t0;
@@ -1188,18 +1206,21 @@ static void tcg_liveness_analysis(TCGContext *s)
 static void temp_allocate_frame(TCGContext *s, int temp)
 {
     TCGTemp *ts;
+    tcg_target_long size;
     ts = &s->temps[temp];
+    /* vectors get a slot of their full size, the stores to it don't need any alignment */
+    size = ts->type >= TCG_TYPE_V64 ? 8 << (ts->type - TCG_TYPE_V64) : (tcg_target_long)sizeof(tcg_target_long);
 #ifndef __sparc_v9__ /* Sparc64 stack is accessed with offset of 2047 */
     s->current_frame_offset = (s->current_frame_offset + (tcg_target_long)sizeof(tcg_target_long) - 1) &
                               ~(sizeof(tcg_target_long) - 1);
 #endif
-    if (s->current_frame_offset + (tcg_target_long)sizeof(tcg_target_long) > s->frame_end) {
+    if (s->current_frame_offset + size > s->frame_end) {
         tcg_abort();
     }
     ts->mem_offset = s->current_frame_offset;
     ts->mem_reg = s->frame_reg;
     ts->mem_allocated = 1;
-    s->current_frame_offset += (tcg_target_long)sizeof(tcg_target_long);
+    s->current_frame_offset += size;
 }
 
 /* free register 'reg' by spilling the corresponding temporary if necessary */
@@ -1223,6 +1244,85 @@ static void tcg_reg_free(TCGContext *s, int reg)
     }
 }
 
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+/* number of following ops looked at when choosing a register to spill */
+#define TCG_SPILL_LOOKAHEAD 32
+
+/* Number of argument words of the op at ARGS */
+static int tcg_op_args_size(TCGOpcode opc, const TCGArg *args)
+{
+    switch (opc) {
+    case INDEX_op_call:
+        return (args[0] >> 16) + (args[0] & 0xffff) + tcg_op_defs[INDEX_op_call].nb_cargs + 1;
+    case INDEX_op_nopn:
+        return args[0];
+    default:
+        return tcg_op_defs[opc].nb_args;
+    }
+}
+
+/* Choose the register of REG_CT whose temporary is needed again the latest.  The following ops
+   are scanned up to the end of the basic block; temporaries not read in the scanned ops are
+   the best candidates, and a value that does not have to be stored wins a tie. */
+static int tcg_reg_alloc_spill_choice(TCGContext *s, TCGRegSet reg_ct)
+{
+    int next_use[TCG_TARGET_NB_REGS];
+    int i, n, reg, best_reg, op_index;
+    TCGOpcode opc;
+    const TCGOpDef *def;
+    const TCGArg *args;
+    TCGTemp *ts;
+
+    for (reg = 0; reg < TCG_TARGET_NB_REGS; reg++) {
+        next_use[reg] = TCG_SPILL_LOOKAHEAD + 1;
+    }
+
+    op_index = s->alloc_op_index;
+    args = s->alloc_args + tcg_op_args_size(tcg->gen_opc_buf[op_index], s->alloc_args);
+    for (n = 1; n <= TCG_SPILL_LOOKAHEAD; n++) {
+        opc = tcg->gen_opc_buf[++op_index];
+        def = &tcg_op_defs[opc];
+        if (opc == INDEX_op_end || opc == INDEX_op_set_label || opc == INDEX_op_call) {
+            break;
+        }
+        if (opc != INDEX_op_nopn && opc != INDEX_op_insn_start && opc != INDEX_op_discard) {
+            for (i = def->nb_oargs; i < def->nb_oargs + def->nb_iargs; i++) {
+                ts = &s->temps[args[i]];
+                if (ts->val_type == TEMP_VAL_REG && !ts->fixed_reg && next_use[ts->reg] > n) {
+                    next_use[ts->reg] = n;
+                }
+            }
+            /* a value overwritten before it is read is not needed anymore */
+            for (i = 0; i < def->nb_oargs; i++) {
+                ts = &s->temps[args[i]];
+                if (ts->val_type == TEMP_VAL_REG && !ts->fixed_reg && next_use[ts->reg] == TCG_SPILL_LOOKAHEAD + 1) {
+                    next_use[ts->reg] = TCG_SPILL_LOOKAHEAD + 2;
+                }
+            }
+            if (def->flags & TCG_OPF_BB_END) {
+                break;
+            }
+        }
+        args += tcg_op_args_size(opc, args);
+    }
+
+    best_reg = -1;
+    for (i = 0; i < ARRAY_SIZE(tcg_target_reg_alloc_order); i++) {
+        reg = tcg_target_reg_alloc_order[i];
+        if (!tcg_regset_test_reg(reg_ct, reg)) {
+            continue;
+        }
+        if (best_reg == -1 || next_use[reg] > next_use[best_reg] ||
+            (next_use[reg] == next_use[best_reg] && s->reg_to_temp[best_reg] != -1 &&
+             !s->temps[s->reg_to_temp[best_reg]].mem_coherent && s->reg_to_temp[reg] != -1 &&
+             s->temps[s->reg_to_temp[reg]].mem_coherent)) {
+            best_reg = reg;
+        }
+    }
+    return best_reg;
+}
+#endif
+
 /* Allocate a register belonging to reg1 & ~reg2 */
 static int tcg_reg_alloc(TCGContext *s, TCGRegSet reg1, TCGRegSet reg2)
 {
@@ -1239,7 +1339,13 @@ static int tcg_reg_alloc(TCGContext *s, TCGRegSet reg1, TCGRegSet reg2)
         }
     }
 
-    /* XXX: do better spill choice */
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+    reg = tcg_reg_alloc_spill_choice(s, reg_ct);
+    if (reg != -1) {
+        tcg_reg_free(s, reg);
+        return reg;
+    }
+#else
     for (i = 0; i < ARRAY_SIZE(tcg_target_reg_alloc_order); i++) {
         reg = tcg_target_reg_alloc_order[i];
         if (tcg_regset_test_reg(reg_ct, reg)) {
@@ -1247,6 +1353,7 @@ static int tcg_reg_alloc(TCGContext *s, TCGRegSet reg1, TCGRegSet reg2)
             return reg;
         }
     }
+#endif
 
     tcg_abort();
     /* Never reached */
@@ -1320,6 +1427,103 @@ static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
     save_globals(s, allocated_regs);
 }
 
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+/* store a temporary held in a register to memory if needed, but keep it in the register */
+static void temp_sync(TCGContext *s, int temp, TCGRegSet allocated_regs)
+{
+    TCGTemp *ts;
+
+    ts = &s->temps[temp];
+    if (ts->fixed_reg) {
+        return;
+    }
+    if (ts->val_type == TEMP_VAL_REG) {
+        if (!ts->mem_coherent) {
+            if (!ts->mem_allocated) {
+                temp_allocate_frame(s, temp);
+            }
+            tcg_out_st(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+            ts->mem_coherent = 1;
+        }
+    } else {
+        temp_save(s, temp, allocated_regs);
+    }
+}
+
+/* store globals to their canonical location, the copies kept in registers stay valid
+   as long as the following code does not modify globals behind the allocator's back */
+static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
+{
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        temp_sync(s, i, allocated_regs);
+    }
+}
+
+/* a conditional branch ends the basic block only for its target: temporaries are dead and
+   everything else is in memory there, but the fall-through path can reuse the registers */
+static void tcg_reg_alloc_cond_branch(TCGContext *s, TCGRegSet allocated_regs)
+{
+    TCGTemp *ts;
+    int i;
+
+    for (i = s->nb_globals; i < s->nb_temps; i++) {
+        ts = &s->temps[i];
+        if (ts->temp_local) {
+            temp_sync(s, i, allocated_regs);
+        } else {
+            if (ts->val_type == TEMP_VAL_REG) {
+                s->reg_to_temp[ts->reg] = -1;
+            }
+            ts->val_type = TEMP_VAL_DEAD;
+        }
+    }
+
+    sync_globals(s, allocated_regs);
+}
+
+/* Direct env accesses to the canonical location of a global (ARGS are those of an ld/st op)
+   bypass the allocator: the global is stored before and, for stores, reloaded after the access */
+static void tcg_reg_alloc_env_access(TCGContext *s, TCGOpcode opc, const TCGArg *args, bool after)
+{
+    int i, size;
+    TCGTemp *ts;
+    tcg_target_long offset;
+
+    size = tcg_env_access_size(opc);
+    switch (opc) {
+    case INDEX_op_ld_vec:
+    case INDEX_op_st_vec:
+        size = 8 << (TCG_VEC_ARG_TYPE(args[3]) - TCG_TYPE_V64);
+        break;
+    case INDEX_op_dupm_vec:
+        size = 1 << TCG_VEC_ARG_VECE(args[3]);
+        break;
+    default:
+        break;
+    }
+    ts = &s->temps[args[1]];
+    if (size == 0 || !ts->fixed_reg || ts->reg != TCG_AREG0) {
+        return;
+    }
+    offset = args[2];
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->fixed_reg || ts->mem_reg != TCG_AREG0 || offset >= ts->mem_offset + (ts->type == TCG_TYPE_I64 ? 8 : 4) ||
+            ts->mem_offset >= offset + size) {
+            continue;
+        }
+        if (!after) {
+            temp_sync(s, i, s->reserved_regs);
+        } else if (tcg_op_defs[opc].nb_oargs == 0 && ts->val_type == TEMP_VAL_REG) {
+            s->reg_to_temp[ts->reg] = -1;
+            ts->val_type = TEMP_VAL_MEM;
+        }
+    }
+}
+#endif
+
 #define IS_DEAD_ARG(n) ((dead_args >> (n)) & 1)
 
 static void tcg_reg_alloc_movi(TCGContext *s, const TCGArg *args)
@@ -1416,6 +1620,10 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOpDef *def, TCGOpcode opc,
     nb_oargs = def->nb_oargs;
     nb_iargs = def->nb_iargs;
 
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+    tcg_reg_alloc_env_access(s, opc, args, false);
+#endif
+
     /* copy constants */
     memcpy(new_args + nb_oargs + nb_iargs, args + nb_oargs + nb_iargs, sizeof(TCGArg) * def->nb_cargs);
 
@@ -1483,7 +1691,15 @@ iarg_end:;
     }
 
     if (def->flags & TCG_OPF_BB_END) {
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+        if (opc == INDEX_op_brcond_i32 || opc == INDEX_op_brcond2_i32 || opc == INDEX_op_brcond_i64) {
+            tcg_reg_alloc_cond_branch(s, allocated_regs);
+        } else {
+            tcg_reg_alloc_bb_end(s, allocated_regs);
+        }
+#else
         tcg_reg_alloc_bb_end(s, allocated_regs);
+#endif
     } else {
         /* mark dead temporaries and free the associated registers */
         for (i = nb_oargs; i < nb_oargs + nb_iargs; i++) {
@@ -1555,6 +1771,9 @@ oarg_end:
 
     /* emit instruction */
     tcg_out_op(s, opc, new_args, const_args);
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+    tcg_reg_alloc_env_access(s, opc, args, true);
+#endif
 
     /* move the outputs in the correct register if needed */
     for (i = 0; i < nb_oargs; i++) {
@@ -1714,9 +1933,20 @@ static int tcg_reg_alloc_call(TCGContext *s, const TCGOpDef *def, TCGOpcode opc,
 
     /* store globals and free associated registers (we assume the call
        can modify any global. */
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+    if (flags & TCG_CALL_CONST) {
+        /* nothing to do */
+    } else if (flags & TCG_CALL_PURE) {
+        /* pure functions may read globals, but never modify them */
+        sync_globals(s, allocated_regs);
+    } else {
+        save_globals(s, allocated_regs);
+    }
+#else
     if (!(flags & TCG_CALL_CONST)) {
         save_globals(s, allocated_regs);
     }
+#endif
 
     tcg_out_op(s, opc, &func_arg, &const_func_arg);
 
@@ -1757,8 +1987,10 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf)
     const TCGArg *args;
 
 #ifdef USE_TCG_OPTIMIZATIONS
-    gen_opparam_ptr =
-        tcg_optimize(s, gen_opc_ptr, tcg->gen_opparam_buf, tcg_op_defs);
+    if (s->optimize) {
+        gen_opparam_ptr =
+            tcg_optimize(s, gen_opc_ptr, tcg->gen_opparam_buf, tcg_op_defs);
+    }
 #endif
 
     tcg_liveness_analysis(s);
@@ -1774,11 +2006,16 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf)
     for (;;) {
         opc = tcg->gen_opc_buf[op_index];
         def = &tcg_op_defs[opc];
+#ifdef USE_TCG_LOOKAHEAD_REG_ALLOC
+        s->alloc_op_index = op_index;
+        s->alloc_args = args;
+#endif
         switch (opc) {
         case INDEX_op_mov_i32:
 #if TCG_TARGET_REG_BITS == 64
         case INDEX_op_mov_i64:
 #endif
+        case INDEX_op_mov_vec:
             dead_args = s->op_dead_args[op_index];
             tcg_reg_alloc_mov(s, def, args, dead_args);
             break;
@@ -473,6 +473,20 @@ typedef struct TCGHelperInfo {
     const char *name;
 } TCGHelperInfo;
 
+/* Optimizer statistics, accumulated over all translated blocks */
+typedef enum TCGOptimizerCounter {
+    /* constant propagation and folding pass */
+    TCG_OPT_CONSTANTS_FOLDED,
+    TCG_OPT_ALGEBRAIC_SIMPLIFICATIONS,
+    /* redundancy elimination pass */
+    TCG_OPT_LOADS_ELIMINATED,
+    TCG_OPT_STORES_FORWARDED,
+    TCG_OPT_DEAD_STORES,
+    TCG_OPT_DEAD_GLOBAL_WRITES,
+    TCG_OPT_EXTENSIONS_ELIMINATED,
+    TCG_OPT_COUNTERS_COUNT
+} TCGOptimizerCounter;
+
 typedef struct TCGContext TCGContext;
 
 struct TCGContext {
@@ -495,6 +509,9 @@ struct TCGContext {
     /* liveness analysis */
     uint16_t *op_dead_args; /* for each operation, each bit tells if the
                                corresponding argument is dead */
+    /* op being allocated and its args, the following ops are looked at to choose what to spill */
+    int alloc_op_index;
+    const TCGArg *alloc_args;
 
     /* tells in which temporary a given register is. It does not take
        into account fixed registers */
@@ -514,6 +531,11 @@ struct TCGContext {
     int helpers_sorted;
     /* sets whether we should use the tlb in accesses */
     uint8_t use_tlb;
+
+    /* number of ops removed or simplified by the optimizer, see TCGOptimizerCounter */
+    uint64_t optimizer_counters[TCG_OPT_COUNTERS_COUNT];
+    /* run the optimizer passes on the ops of the block being generated */
+    bool optimize;
 };
 
 extern uint16_t *gen_opc_ptr;
@@ -582,6 +604,7 @@ void tcg_context_init();
 void tcg_context_use_tlb(int value);
 void tcg_dispose();
 void tcg_prologue_init();
+void tcg_gvec_runtime_init(void);
 void tcg_func_start(TCGContext *s);
 
 int tcg_gen_code(TCGContext *s, uint8_t *gen_code_buf);
@@ -621,6 +644,38 @@ static inline bool tcg_arg_is_local(TCGContext *s, TCGArg arg)
     return s->temps[arg].temp_local;
 }
 
+/* Size of the memory access done by an env load or store, 0 for other ops */
+static inline int tcg_env_access_size(TCGOpcode op)
+{
+    switch (op) {
+    case INDEX_op_ld8u_i32:
+    case INDEX_op_ld8s_i32:
+    case INDEX_op_st8_i32:
+    case INDEX_op_ld8u_i64:
+    case INDEX_op_ld8s_i64:
+    case INDEX_op_st8_i64:
+        return 1;
+    case INDEX_op_ld16u_i32:
+    case INDEX_op_ld16s_i32:
+    case INDEX_op_st16_i32:
+    case INDEX_op_ld16u_i64:
+    case INDEX_op_ld16s_i64:
+    case INDEX_op_st16_i64:
+        return 2;
+    case INDEX_op_ld_i32:
+    case INDEX_op_st_i32:
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_st32_i64:
+        return 4;
+    case INDEX_op_ld_i64:
+    case INDEX_op_st_i64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
 #define tcg_clear_temp_count() do { } while (0)
 #define tcg_check_temp_count() 0
 
@@ -784,8 +839,61 @@ static inline const TCGOpcode *tcg_swap_vecop_list(const TCGOpcode *n)
 #endif
 }
 
-// The functions below are only used for emitting host vector instructions which is currently unsupported.
-#if !TCG_TARGET_MAYBE_vec
+/* The last constant argument of a vector op holds its vector type and element size */
+#define TCG_VEC_ARG(type, vece)  (((type) - TCG_TYPE_V64) | ((vece) << 2))
+#define TCG_VEC_ARG_TYPE(arg)    ((TCGType)(TCG_TYPE_V64 + ((arg) & 3)))
+#define TCG_VEC_ARG_VECE(arg)    ((unsigned)(arg) >> 2)
+
+#if TCG_TARGET_MAYBE_vec
+TCGv_vec tcg_temp_new_vec(TCGType type);
+TCGv_vec tcg_temp_new_vec_matching(TCGv_vec match);
+void tcg_temp_free_vec(TCGv_vec arg);
+/* These return a new temporary holding the constant, callers don't free it */
+TCGv_vec tcg_constant_vec(TCGType type, unsigned vece, uint64_t a);
+TCGv_vec tcg_constant_vec_matching(TCGv_vec match, unsigned vece, int64_t val);
+
+static inline TCGTemp *arg_temp(TCGArg a)
+{
+    return &tcg->ctx->temps[a];
+}
+static inline TCGArg temp_arg(TCGTemp *ts)
+{
+    return ts - tcg->ctx->temps;
+}
+static inline TCGTemp *tcgv_i32_temp(TCGv_i32 v)
+{
+    return arg_temp(GET_TCGV_I32(v));
+}
+static inline TCGTemp *tcgv_i64_temp(TCGv_i64 v)
+{
+    return arg_temp(GET_TCGV_I64(v));
+}
+static inline TCGTemp *tcgv_ptr_temp(TCGv_ptr v)
+{
+    return arg_temp(GET_TCGV_PTR(v));
+}
+static inline TCGTemp *tcgv_vec_temp(TCGv_vec v)
+{
+    return arg_temp(v);
+}
+static inline TCGArg tcgv_i32_arg(TCGv_i32 v)
+{
+    return GET_TCGV_I32(v);
+}
+static inline TCGArg tcgv_i64_arg(TCGv_i64 v)
+{
+    return GET_TCGV_I64(v);
+}
+static inline TCGArg tcgv_ptr_arg(TCGv_ptr v)
+{
+    return GET_TCGV_PTR(v);
+}
+static inline TCGArg tcgv_vec_arg(TCGv_vec v)
+{
+    return v;
+}
+#else
+// Without a host vector backend the gvec expanders never reach these.
     #define vec_unsupported() tlib_abortf("%s: Emitting host vector instructions isn't currently supported.", __func__); __builtin_unreachable()
 
     static inline TCGv_vec tcg_constant_vec(TCGType type, unsigned vece, uint64_t a) { vec_unsupported(); }
@@ -88,14 +88,28 @@ extern __thread struct unwind_state {
         return ret;                                                                            \
     }
 
+#define EXC_VALUE_4(RET, NAME, PLACEHOLDER, PARAMT1, PARAM1, PARAMT2, PARAM2, PARAMT3, PARAM3, PARAMT4, PARAM4) \
+    RET NAME##_ex(PARAMT1 PARAM1, PARAMT2 PARAM2, PARAMT3 PARAM3, PARAMT4 PARAM4)                             \
+    {                                                                                                         \
+        RET ret = PLACEHOLDER;                                                                                \
+        if (PUSH_ENV() == 0) {                                                                                \
+            ret = NAME(PARAM1, PARAM2, PARAM3, PARAM4);                                                       \
+        }                                                                                                     \
+        POP_ENV();                                                                                            \
+        return ret;                                                                                           \
+    }
+
 /* pointer macros */
 #define EXC_POINTER_0(RET, NAME) EXC_VALUE_0(RET, NAME, NULL)
+#define EXC_POINTER_1(RET, NAME, PARAMT1, PARAM1) EXC_VALUE_1(RET, NAME, NULL, PARAMT1, PARAM1)
 
 /* int macros */
 #define EXC_INT_0(RET, NAME) EXC_VALUE_0(RET, NAME, 0)
 #define EXC_INT_1(RET, NAME, PARAMT1, PARAM1) EXC_VALUE_1(RET, NAME, 0, PARAMT1, PARAM1)
 #define EXC_INT_2(RET, NAME, PARAMT1, PARAM1, PARAMT2, PARAM2) EXC_VALUE_2(RET, NAME, 0, PARAMT1, PARAM1, PARAMT2, PARAM2)
 #define EXC_INT_3(RET, NAME, PARAMT1, PARAM1, PARAMT2, PARAM2, PARAMT3, PARAM3) EXC_VALUE_3(RET, NAME, 0, PARAMT1, PARAM1, PARAMT2, PARAM2, PARAMT3, PARAM3)
+#define EXC_INT_4(RET, NAME, PARAMT1, PARAM1, PARAMT2, PARAM2, PARAMT3, PARAM3, PARAMT4, PARAM4) \
+    EXC_VALUE_4(RET, NAME, 0, PARAMT1, PARAM1, PARAMT2, PARAM2, PARAMT3, PARAM3, PARAMT4, PARAM4)
 
 /* void macros */
 #define EXC_VOID_0(NAME)       \
@@ -19,6 +19,11 @@ public static void SetAdvanceImmediately(this Machine @this, bool val)
             @this.LocalTimeSource.AdvanceImmediately = val;
         }
 
+        public static void SetSkipIdleTime(this Machine @this, bool val)
+        {
+            @this.LocalTimeSource.SkipIdleTime = val;
+        }
+
         public static void SetQuantum(this Machine @this, TimeInterval interval)
         {
             @this.LocalTimeSource.Quantum = interval;
@@ -49,6 +54,11 @@ public static void SetGlobalAdvanceImmediately(this Emulation @this, bool val)
             SetAdvanceImmediatelyRecursively(@this.MasterTimeSource, val);
         }
 
+        public static void SetGlobalSkipIdleTime(this Emulation @this, bool val)
+        {
+            SetSkipIdleTimeRecursively(@this.MasterTimeSource, val);
+        }
+
         public static string GetTimeSourceInfo(this Emulation @this)
         {
             return @this.MasterTimeSource.ToString();
@@ -84,6 +94,15 @@ private static void SetAdvanceImmediatelyRecursively(TimeSourceBase source, bool
             }
         }
 
+        private static void SetSkipIdleTimeRecursively(TimeSourceBase source, bool val)
+        {
+            source.SkipIdleTime = val;
+            foreach(var sink in source.Sinks.OfType<TimeSourceBase>())
+            {
+                SetSkipIdleTimeRecursively(sink, val);
+            }
+        }
+
         private static void SetQuantumRecursively(TimeSourceBase source, TimeInterval quantum)
         {
             source.Quantum = quantum;
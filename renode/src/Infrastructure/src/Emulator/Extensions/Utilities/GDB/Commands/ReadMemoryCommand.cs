@@ -7,6 +7,7 @@
 using System;
 using System.Text;
 using Antmicro.Renode.Exceptions;
+using Antmicro.Renode.Peripherals.CPU;
 
 namespace Antmicro.Renode.Utilities.GDB.Commands
 {
@@ -39,7 +40,15 @@ public ReadMemoryCommand(CommandsManager manager) : base(manager)
                 byte[] data;
                 try
                 {
-                    data = manager.Machine.SystemBus.ReadBytes(access.Address, (int)access.Length, context: manager.Cpu);
+                    if(manager.Cpu is ICPUWithMappedMemory cpuWithMappedMemory)
+                    {
+                        data = new byte[access.Length];
+                        cpuWithMappedMemory.ReadPhysicalMemory(access.Address, data.Length, data, 0);
+                    }
+                    else
+                    {
+                        data = manager.Machine.SystemBus.ReadBytes(access.Address, (int)access.Length, context: manager.Cpu);
+                    }
                 }
                 catch(RecoverableException)
                 {
@@ -7,6 +7,7 @@
 using System;
 using System.Linq;
 using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.CPU;
 
 namespace Antmicro.Renode.Utilities.GDB.Commands
 {
@@ -56,7 +57,14 @@ private PacketData WriteData(ulong address, byte[] data)
             int startingIndex = 0;
             foreach(var access in accesses)
             {
-                manager.Machine.SystemBus.WriteBytes(data, access.Address, startingIndex, (long)access.Length, context: manager.Cpu);
+                if(manager.Cpu is ICPUWithMappedMemory cpuWithMappedMemory)
+                {
+                    cpuWithMappedMemory.WritePhysicalMemory(data, access.Address, startingIndex, (long)access.Length);
+                }
+                else
+                {
+                    manager.Machine.SystemBus.WriteBytes(data, access.Address, startingIndex, (long)access.Length, context: manager.Cpu);
+                }
                 startingIndex += (int)access.Length;
             }
 
@@ -76,8 +76,8 @@ private void SerializeAtomicMemoryState()
             atomicMemoryState = new byte[AtomicMemoryStateSize];
             Marshal.Copy(atomicMemoryStatePointer, atomicMemoryState, 0, atomicMemoryState.Length);
             // the first byte of an atomic memory state contains value 0 or 1
-            // indicating if the mutex has already been initialized;
-            // the mutex must be restored after each deserialization, so here we force this value to 0
+            // indicating if the memory locks have already been initialized;
+            // the locks must be restored after each deserialization, so here we force this value to 0
             atomicMemoryState[0] = 0;
         }
 
@@ -87,7 +87,7 @@ public void InitAtomicMemoryState()
             atomicMemoryStatePointer = Marshal.AllocHGlobal(AtomicMemoryStateSize);
 
             // the beginning of an atomic memory state contains two 8-bit flags:
-            // byte 0: information if the mutex has already been initialized
+            // byte 0: information if the memory locks have already been initialized
             // byte 1: information if the reservations array has already been initialized
             //
             // the first byte must be set to 0 at start and after each deserialization
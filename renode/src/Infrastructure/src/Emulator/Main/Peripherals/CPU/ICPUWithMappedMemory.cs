@@ -23,6 +23,8 @@ public interface ICPUWithMappedMemory: ICPU
         void SetPageAccessViaIo(ulong address);
         void ClearPageAccessViaIo(ulong address);
         void SetBroadcastDirty(bool enable);
+        void ReadPhysicalMemory(ulong address, int count, byte[] destination, int startIndex);
+        void WritePhysicalMemory(byte[] bytes, ulong address, int startingIndex, long count);
     }
 }
 
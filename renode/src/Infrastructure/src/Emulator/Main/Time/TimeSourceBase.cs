@@ -273,6 +273,7 @@ public override string ToString()
                 $"Cumulative load: {CumulativeLoad}",
                 $"State: {State}",
                 $"Advance immediately: {AdvanceImmediately}",
+                $"Skip idle time: {SkipIdleTime}",
                 $"Quantum: {Quantum}");
         }
 
@@ -288,6 +289,15 @@ public override string ToString()
         /// </remarks>
         public bool AdvanceImmediately { get; set; }
 
+        /// <summary>
+        /// Gets or sets flag indicating if the time flow should stop reflecting real time while all CPUs wait for an interrupt.
+        /// </summary>
+        /// <remarks>
+        /// The idle CPUs then jump straight to the nearest timer deadline, so that the host time is spent only on the actual execution.
+        /// This has no effect if <see cref="AdvanceImmediately"> is set.
+        /// </remarks>
+        public bool SkipIdleTime { get; set; }
+
         /// <summary>
         /// Gets current state of this time source.
         /// </summary>
@@ -377,6 +377,7 @@ protected virtual void RequestPause()
             lock(pauseLock)
             {
                 isPaused = true;
+                isWaitingForInterrupt = false;
                 this.Trace("Requesting pause");
                 sleeper.Interrupt();
             }
@@ -578,7 +579,10 @@ protected CpuResult CpuThreadBodyInner(bool singleStep)
                 {
                     this.Trace($"Asking CPU to execute {toExecute} instructions");
 
+                    // a request to skip the idle time only applies to the wait that follows
+                    idleTimeSkipRequested = false;
                     result = ExecuteInstructions(toExecute, out var executed);
+                    isWaitingForInterrupt = result == ExecutionResult.WaitingForInterrupt;
                     this.Trace($"CPU executed {executed} instructions and returned {result}");
                     machine.Profiler?.Log(new InstructionEntry((byte)Id, ExecutedInstructions));
                     ReportProgress(executed);
@@ -595,12 +599,13 @@ protected CpuResult CpuThreadBodyInner(bool singleStep)
                         this.Trace();
                         var instructionsToSkip = Math.Min(InstructionsToNearestLimit(), instructionsLeftThisRound);
 
-                        if(!machine.LocalTimeSource.AdvanceImmediately)
+                        if(!machine.LocalTimeSource.AdvanceImmediately && !ShouldSkipIdleTime() && !idleTimeSkipRequested)
                         {
                             var intervalToSleep = TimeInterval.FromCPUCycles(instructionsToSkip, PerformanceInMips, out var unused).ToTimeSpan();
                             var interrupted = sleeper.Sleep(intervalToSleep, out var intervalSlept);
 
-                            if(interrupted)
+                            // when woken up to skip the idle time, the whole interval is skipped
+                            if(interrupted && !idleTimeSkipRequested)
                             {
                                 instructionsToSkip = TimeInterval.FromTimeSpan(intervalSlept).ToCPUCycles(PerformanceInMips, out var _);
                             }
@@ -629,6 +634,10 @@ protected CpuResult CpuThreadBodyInner(bool singleStep)
             }
 
             this.Trace("CPU thread body finished");
+            if(isPaused || currentHaltedState)
+            {
+                isWaitingForInterrupt = false;
+            }
 
             if(isAborted)
             {
@@ -677,6 +686,27 @@ protected CpuResult CpuThreadBodyInner(bool singleStep)
             return CpuResult.ExecutedInstructions;
         }
 
+        // Idle time is skipped only when no CPU of the machine has anything to execute; the ones already sleeping
+        // are woken up, so that they skip the rest of their interval as well
+        private bool ShouldSkipIdleTime()
+        {
+            if(!machine.LocalTimeSource.SkipIdleTime)
+            {
+                return false;
+            }
+            var cpus = machine.SystemBus.GetCPUs().OfType<BaseCPU>();
+            if(!cpus.All(cpu => cpu.isWaitingForInterrupt || cpu.IsHalted))
+            {
+                return false;
+            }
+            foreach(var cpu in cpus.Where(cpu => cpu != this))
+            {
+                cpu.idleTimeSkipRequested = true;
+                cpu.sleeper.Interrupt();
+            }
+            return true;
+        }
+
         protected void StartCPUThread()
         {
             this.Trace();
@@ -763,6 +793,8 @@ protected virtual ulong SkipInstructions
         protected bool dispatcherRestartRequested;
         protected bool isHaltedRequested;
         protected bool currentHaltedState;
+        protected volatile bool isWaitingForInterrupt;
+        protected volatile bool idleTimeSkipRequested;
 
         [Transient]
         protected ExecutionMode executionMode;
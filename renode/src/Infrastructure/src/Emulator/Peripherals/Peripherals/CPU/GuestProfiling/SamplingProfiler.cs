@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2010-2024 Antmicro
+//
+// This file is licensed under the MIT License.
+// Full license text is available in 'licenses/MIT.txt'.
+//
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Runtime.InteropServices;
+using Antmicro.Migrant;
+using Antmicro.Renode.Exceptions;
+
+namespace Antmicro.Renode.Peripherals.CPU.GuestProfiling
+{
+    // Aggregates the stacks sampled by tlib; every stack is weighted with the instructions executed since the previous sample,
+    // so the output can be compared with the one of `CollapsedStackProfiler`
+    [Transient]
+    public class SamplingProfiler : IDisposable
+    {
+        public SamplingProfiler(TranslationCPU cpu, string filename)
+        {
+            this.cpu = cpu;
+            this.filename = filename;
+            stacks = new Dictionary<string, ulong>();
+            symbols = new Dictionary<ulong, string>();
+            lastInstructionsCount = cpu.ExecutedInstructions;
+
+            try
+            {
+                File.WriteAllText(filename, string.Empty);
+            }
+            catch(Exception e)
+            {
+                throw new RecoverableException($"There was an error when preparing the profiler output file {filename}: {e.Message}");
+            }
+        }
+
+        public void Dispose()
+        {
+            FlushBuffer();
+        }
+
+        public void AddSamples(IntPtr samples, uint count)
+        {
+            var words = new long[count * RecordWords];
+            Marshal.Copy(samples, words, 0, words.Length);
+            for(var i = 0; i < count; i++)
+            {
+                var record = i * RecordWords;
+                var instructionsCount = (ulong)words[record];
+                var depth = (int)(uint)words[record + 1];
+
+                // frames are stored from the innermost one, the collapsed stack starts with the outermost
+                var frames = new string[depth];
+                for(var frame = 0; frame < depth; frame++)
+                {
+                    frames[depth - frame - 1] = GetSymbolName((ulong)words[record + FramesOffset + frame]);
+                }
+                var stack = string.Join(";", frames);
+
+                var weight = instructionsCount - lastInstructionsCount;
+                lastInstructionsCount = instructionsCount;
+                stacks.TryGetValue(stack, out var total);
+                stacks[stack] = total + weight;
+            }
+        }
+
+        // The stacks are aggregated for the whole run, so the file is written anew every time
+        public void FlushBuffer()
+        {
+            File.WriteAllLines(filename, stacks.Select(stack => $"{stack.Key} {stack.Value}"));
+        }
+
+        private string GetSymbolName(ulong address)
+        {
+            if(!symbols.TryGetValue(address, out var name))
+            {
+                if(!cpu.Bus.TryFindSymbolAt(address, out name, out var _))
+                {
+                    name = $"0x{address:X}";
+                }
+                symbols[address] = name;
+            }
+            return name;
+        }
+
+        private ulong lastInstructionsCount;
+
+        private readonly TranslationCPU cpu;
+        private readonly string filename;
+        private readonly Dictionary<string, ulong> stacks;
+        private readonly Dictionary<ulong, string> symbols;
+
+        // these must match `profiler_sample_t` in tlib's sampling_profiler.h
+        private const int MaxDepth = 32;
+        private const int FramesOffset = 2;
+        private const int RecordWords = FramesOffset + MaxDepth;
+    }
+}
@@ -133,6 +133,108 @@ public int MaximumBlockSize
             }
         }
 
+        // Number of executions after which a block is retranslated together with its hot successors; 0 disables superblocks
+        public uint SuperblockThreshold
+        {
+            get
+            {
+                return TlibGetSuperblockThreshold();
+            }
+            set
+            {
+                TlibSetSuperblockThreshold(value);
+            }
+        }
+
+        // Number of executions after which a block is translated again with the TCG optimizer; 0 optimizes every block right away
+        public uint TieredTranslationThreshold
+        {
+            get
+            {
+                return TlibGetTieredTranslationThreshold();
+            }
+            set
+            {
+                TlibSetTieredTranslationThreshold(value);
+            }
+        }
+
+        // log2 of the number of main TLB entries per MMU mode; a new value is applied before the next block is executed
+        public uint TlbSizeBits
+        {
+            get
+            {
+                return TlibGetTlbSizeBits();
+            }
+            set
+            {
+                TlibSetTlbSizeBits(value);
+            }
+        }
+
+        public bool TlbDynamicResizeEnabled
+        {
+            get
+            {
+                return TlibGetTlbDynamicResize() != 0;
+            }
+            set
+            {
+                TlibSetTlbDynamicResize(value ? 1u : 0u);
+            }
+        }
+
+        public ulong TlbMissCount => TlibGetTlbMissCount();
+
+        public ulong TlbVictimHitCount => TlibGetTlbVictimHitCount();
+
+        public void ResetTlbCounters()
+        {
+            TlibResetTlbCounters();
+        }
+
+        // The optimizer passes are only compiled in with the TCG_OPTIMIZATIONS build option; without them the counters stay at 0
+        public bool HasTcgOptimizer
+        {
+            get
+            {
+                return TlibHasTcgOptimizer() != 0;
+            }
+        }
+
+        public ulong GetTcgOptimizerCounter(TcgOptimizerCounter counter)
+        {
+            return GetTcgOptimizerCountersSnapshot()[(int)counter];
+        }
+
+        public string[,] GetTcgOptimizerCounters()
+        {
+            var counters = GetTcgOptimizerCountersSnapshot();
+            var table = new Table().AddRow("Counter", "Value");
+            foreach(TcgOptimizerCounter counter in Enum.GetValues(typeof(TcgOptimizerCounter)))
+            {
+                table.AddRow(counter.ToString(), counters[(int)counter].ToString());
+            }
+            return table.ToArray();
+        }
+
+        public void ResetTcgOptimizerCounters()
+        {
+            TlibResetTcgOptimizerCounters();
+        }
+
+        // The order follows TCGOptimizerCounter in tcg.h
+        public enum TcgOptimizerCounter
+        {
+            ConstantsFolded,
+            AlgebraicSimplifications,
+            LoadsEliminated,
+            StoresForwarded,
+            DeadStores,
+            DeadGlobalWrites,
+            ExtensionsEliminated
+        }
+
         public int CyclesPerInstruction
         {
             get
@@ -231,6 +333,21 @@ private void UpdateTranslationCacheSize(ulong sizeAtThatTime)
             }
         }
 
+        private ulong[] GetTcgOptimizerCountersSnapshot()
+        {
+            var counters = new ulong[Enum.GetValues(typeof(TcgOptimizerCounter)).Length];
+            var handle = GCHandle.Alloc(counters, GCHandleType.Pinned);
+            try
+            {
+                TlibGetTcgOptimizerCounters(handle.AddrOfPinnedObject(), (uint)counters.Length);
+            }
+            finally
+            {
+                handle.Free();
+            }
+            return counters;
+        }
+
         [PreSerialization]
         private void PrepareState()
         {
@@ -257,6 +374,11 @@ private void RestoreState()
                 // Repeat memory hook enable to make sure that the tcg context is set not to use the tlb
                 TlibOnMemoryAccessEventEnabled(1);
             }
+            if(blockBeginBatchHook != null)
+            {
+                // the buffer isn't a part of the serialized state
+                TlibEnableBlockBeginBatching(blockBeginBatchCapacity);
+            }
         }
 
         public override ExecutionMode ExecutionMode
@@ -434,6 +556,57 @@ public void ClearPageAccessViaIo(ulong address)
             TlibClearPageIoAccessed(address);
         }
 
+        public void ReadPhysicalMemory(ulong address, int count, byte[] destination, int startIndex)
+        {
+            // RAM mapped on this core is copied straight from the host memory, only the rest goes through the bus
+            var spans = new HostMemorySpan[MaxHostMemorySpansPerQuery];
+            var handle = GCHandle.Alloc(spans, GCHandleType.Pinned);
+            try
+            {
+                while(count > 0)
+                {
+                    var spansCount = TlibGetHostMemorySpans(address, (ulong)count, handle.AddrOfPinnedObject(), (uint)spans.Length);
+                    for(var i = 0; i < spansCount; i++)
+                    {
+                        var size = (int)spans[i].Size;
+                        if(spans[i].HostPointer == IntPtr.Zero)
+                        {
+                            machine.SystemBus.ReadBytes(spans[i].Address, size, destination, startIndex, context: this);
+                        }
+                        else
+                        {
+                            Marshal.Copy(spans[i].HostPointer, destination, startIndex, size);
+                        }
+                        address += (ulong)size;
+                        startIndex += size;
+                        count -= size;
+                    }
+                }
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+
+        public void WritePhysicalMemory(byte[] bytes, ulong address, int startingIndex, long count)
+        {
+            var bytesHandle = GCHandle.Alloc(bytes, GCHandleType.Pinned);
+            var vectors = new [] { new PhysicalMemoryVector { Address = address, Size = (ulong)count, Buffer = bytesHandle.AddrOfPinnedObject() + startingIndex } };
+            var vectorsHandle = GCHandle.Alloc(vectors, GCHandleType.Pinned);
+            try
+            {
+                TlibPhysicalMemoryRwVectored(vectorsHandle.AddrOfPinnedObject(), (uint)vectors.Length, 1);
+            }
+            finally
+            {
+                vectorsHandle.Free();
+                bytesHandle.Free();
+            }
+            // tlib tells the other cores to drop their code only for pages this core has translated code from
+            InvalidateTbInOtherCpus(new IntPtr((long)address), new IntPtr((long)(address + (ulong)count)));
+        }
+
         public bool DisableInterruptsWhileStepping { get; set; }
 
         // this is just for easier usage in Monitor
@@ -505,6 +678,27 @@ public void SetHookAtBlockBegin(Action<ulong, uint> hook)
             }
         }
 
+        // The generated code records executed blocks in a buffer, which is passed to `hook` when `capacity` blocks
+        // are collected and at the end of every quantum. Unlike the hook set with `SetHookAtBlockBegin`,
+        // it can't pause the execution, but it doesn't leave the generated code on every block.
+        public void SetBatchedHookAtBlockBegin(Action<ExecutedBlock[]> hook, uint capacity = DefaultBlockBatchCapacity)
+        {
+            using(machine?.ObtainPausedState())
+            {
+                // blocks pending in the previous buffer still go to the previous hook
+                if(hook == null)
+                {
+                    TlibDisableBlockBeginBatching();
+                }
+                else if(TlibEnableBlockBeginBatching(capacity) == 0)
+                {
+                    throw new RecoverableException("Block batch capacity has to be greater than zero");
+                }
+                blockBeginBatchHook = hook;
+                blockBeginBatchCapacity = capacity;
+            }
+        }
+
         public void SetHookAtBlockEnd(Action<ulong, uint> hook)
         {
             using(machine?.ObtainPausedState())
@@ -877,6 +1071,21 @@ private uint OnBlockBegin(ulong address, uint size)
             return (currentHaltedState || isPaused) ? 0 : 1u;
         }
 
+        [Export]
+        private void OnBlockBeginBatch(IntPtr records, uint count)
+        {
+            // each record is the 64-bit pc followed by the 32-bit instructions count and 32 bits of padding
+            var words = new long[count * 2];
+            Marshal.Copy(records, words, 0, words.Length);
+            var blocks = new ExecutedBlock[count];
+            for(var i = 0; i < count; i++)
+            {
+                blocks[i].PC = (ulong)words[2 * i];
+                blocks[i].InstructionsCount = (uint)words[2 * i + 1];
+            }
+            blockBeginBatchHook?.Invoke(blocks);
+        }
+
         [Export]
         private void OnBlockFinished(ulong pc, uint executedInstructions)
         {
@@ -1062,6 +1271,8 @@ protected override void DisposeInner(bool silent = false)
             base.DisposeInner(silent);
             TimeHandle.Dispose();
             RemoveAllHooks();
+            StopMemoryAccessTrace();
+            StopSamplingProfiler();
             TlibDispose();
             RenodeFreeHostBlocks();
             binder.Dispose();
@@ -1284,6 +1495,8 @@ private void Free(IntPtr pointer)
         private Action<ulong, uint> blockBeginInternalHook;
         private Action<ulong, uint> blockBeginUserHook;
         private Action<ulong, uint> blockFinishedHook;
+        private Action<ExecutedBlock[]> blockBeginBatchHook;
+        private uint blockBeginBatchCapacity;
         private Action<ulong> interruptBeginHook;
         private Action<ulong> interruptEndHook;
         private Action<ulong, AccessType, int> mmuFaultHook;
@@ -1534,6 +1747,23 @@ private struct HostMemoryBlock
             public IntPtr HostPointer;
         }
 
+        // The layouts of these two follow HostMemorySpan and PhysicalMemoryVector in tlib's cpu-common.h
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        private struct HostMemorySpan
+        {
+            public ulong Address;
+            public ulong Size;
+            public IntPtr HostPointer;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        private struct PhysicalMemoryVector
+        {
+            public ulong Address;
+            public ulong Size;
+            public IntPtr Buffer;
+        }
+
         #region IDisassemblable implementation
 
         private bool logTranslatedBlocks;
@@ -1659,6 +1889,12 @@ private void UpdateBlockBeginHookPresent()
         [Import]
         private ActionIntPtrIntPtr TlibInvalidateTranslationBlocks;
 
+        [Import]
+        private FuncUInt32UInt64UInt64IntPtrUInt32 TlibGetHostMemorySpans;
+
+        [Import]
+        private ActionIntPtrUInt32UInt32 TlibPhysicalMemoryRwVectored;
+
         [Import]
         protected FuncUInt64UInt64UInt32 TlibTranslateToPhysicalAddress;
 
@@ -1701,6 +1937,48 @@ private void UpdateBlockBeginHookPresent()
         [Import]
         private FuncUInt32 TlibGetMaximumBlockSize;
 
+        [Import]
+        private ActionUInt32 TlibSetSuperblockThreshold;
+
+        [Import]
+        private FuncUInt32 TlibGetSuperblockThreshold;
+
+        [Import]
+        private ActionUInt32 TlibSetTieredTranslationThreshold;
+
+        [Import]
+        private FuncUInt32 TlibGetTieredTranslationThreshold;
+
+        [Import]
+        private FuncUInt32 TlibHasTcgOptimizer;
+
+        [Import]
+        private ActionUInt32 TlibSetTlbSizeBits;
+
+        [Import]
+        private FuncUInt32 TlibGetTlbSizeBits;
+
+        [Import]
+        private ActionUInt32 TlibSetTlbDynamicResize;
+
+        [Import]
+        private FuncUInt32 TlibGetTlbDynamicResize;
+
+        [Import]
+        private FuncUInt64 TlibGetTlbMissCount;
+
+        [Import]
+        private FuncUInt64 TlibGetTlbVictimHitCount;
+
+        [Import]
+        private Action TlibResetTlbCounters;
+
+        [Import]
+        private FuncUInt32IntPtrUInt32 TlibGetTcgOptimizerCounters;
+
+        [Import]
+        private Action TlibResetTcgOptimizerCounters;
+
         [Import]
         private ActionUInt32 TlibSetCyclesPerInstruction;
 
@@ -1740,6 +2018,12 @@ private void UpdateBlockBeginHookPresent()
         [Import]
         private ActionInt32 TlibOnMemoryAccessEventEnabled;
 
+        [Import]
+        private FuncUInt32UInt32 TlibEnableBlockBeginBatching;
+
+        [Import]
+        private Action TlibDisableBlockBeginBatching;
+
         [Import]
         private Action TlibCleanWfiProcState;
 
@@ -1891,6 +2175,8 @@ public string DisassembleBlock(ulong addr = ulong.MaxValue, uint blockSize = 40,
         protected static readonly Exception InvalidInterruptNumberException = new InvalidOperationException("Invalid interrupt number.");
 
         private const int DefaultMaximumBlockSize = 0x7FF;
+        private const uint DefaultBlockBatchCapacity = 4096;
+        private const int MaxHostMemorySpansPerQuery = 16;
         private bool externalMmuEnabled;
         private readonly uint externalMmuWindowsCount;
 
@@ -2190,5 +2476,16 @@ public void Deactivate()
             private readonly HashSet<Action<ICpuSupportingGdb, ulong>> callbacks;
         }
     }
+
+    public struct ExecutedBlock
+    {
+        public ulong PC;
+        public uint InstructionsCount;
+
+        public override string ToString()
+        {
+            return $"[Block: starting at 0x{PC:X} with {InstructionsCount} instructions]";
+        }
+    }
 }
 
@@ -0,0 +1,221 @@
+//
+// Copyright (c) 2010-2024 Antmicro
+//
+// This file is licensed under the MIT License.
+// Full license text is available in 'licenses/MIT.txt'.
+//
+using System;
+using System.IO;
+using System.IO.Compression;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading;
+using Antmicro.Migrant;
+using Antmicro.Renode.Exceptions;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Logging.Profiling;
+using Antmicro.Renode.Utilities.Binding;
+
+namespace Antmicro.Renode.Peripherals.CPU
+{
+    public abstract partial class TranslationCPU
+    {
+        // Records every memory access to a file. Records are collected by tlib in a ring and written in batches:
+        // when the ring gets half full and at the end of every quantum.
+        public void EnableMemoryAccessTrace(string path, bool compress = true, uint capacityBits = DefaultMemoryAccessTraceCapacityBits)
+        {
+            Stream stream;
+            try
+            {
+                stream = File.Open(path, FileMode.CreateNew);
+                if(compress)
+                {
+                    stream = new GZipStream(stream, CompressionLevel.Fastest);
+                }
+            }
+            catch(Exception e)
+            {
+                throw new RecoverableException($"There was an error when preparing the memory access trace output file {path}: {e.Message}");
+            }
+
+            var writer = new BinaryWriter(stream);
+            writer.Write(Encoding.ASCII.GetBytes(MemoryAccessTraceMagic));
+            writer.Write(MemoryAccessTraceVersion);
+            writer.Write(MemoryAccessTraceRecordSize);
+            StartMemoryAccessTrace(null, writer, capacityBits);
+        }
+
+        // Like above, but the batches are passed to `consumer`
+        public void EnableMemoryAccessTrace(Action<MemoryAccessTraceEntry[]> consumer, uint capacityBits = DefaultMemoryAccessTraceCapacityBits)
+        {
+            StartMemoryAccessTrace(consumer, null, capacityBits);
+        }
+
+        public void DisableMemoryAccessTrace()
+        {
+            using(machine?.ObtainPausedState())
+            {
+                StopMemoryAccessTrace();
+                TlibDisableMemoryTrace();
+            }
+        }
+
+        // Number of accesses lost because the ring filled up before it was drained
+        public ulong MemoryAccessTraceDroppedCount => memoryTraceRing == IntPtr.Zero ? 0 : (ulong)Marshal.ReadInt64(memoryTraceRing, RingDroppedOffset);
+
+        private void StartMemoryAccessTrace(Action<MemoryAccessTraceEntry[]> consumer, BinaryWriter writer, uint capacityBits)
+        {
+            using(machine?.ObtainPausedState())
+            {
+                StopMemoryAccessTrace();
+                var ring = TlibEnableMemoryTrace(capacityBits);
+                if(ring == IntPtr.Zero)
+                {
+                    writer?.Dispose();
+                    throw new RecoverableException($"Unsupported memory access trace capacity: 2^{capacityBits} records");
+                }
+                memoryTraceRing = ring;
+                memoryTraceCapacity = (uint)Marshal.ReadInt32(ring, RingCapacityOffset);
+                memoryTraceConsumer = consumer;
+                memoryTraceWriter = writer;
+            }
+        }
+
+        // Drains what is left in the ring and closes the file; the ring itself is freed by tlib
+        private void StopMemoryAccessTrace()
+        {
+            if(memoryTraceRing == IntPtr.Zero)
+            {
+                return;
+            }
+            DrainMemoryAccessTrace();
+            var dropped = MemoryAccessTraceDroppedCount;
+            if(dropped != 0)
+            {
+                this.Log(LogLevel.Warning, "{0} memory accesses were not traced because the trace buffer was full", dropped);
+            }
+            memoryTraceWriter?.Dispose();
+            memoryTraceWriter = null;
+            memoryTraceConsumer = null;
+            memoryTraceRing = IntPtr.Zero;
+        }
+
+        [Export]
+        private void OnMemoryTraceReady()
+        {
+            DrainMemoryAccessTrace();
+        }
+
+        private void DrainMemoryAccessTrace()
+        {
+            var head = (ulong)Marshal.ReadInt64(memoryTraceRing, RingHeadOffset);
+            // records up to `head` must be read after `head` itself
+            Thread.MemoryBarrier();
+            var tail = (ulong)Marshal.ReadInt64(memoryTraceRing, RingTailOffset);
+            var count = (int)(head - tail);
+            if(count == 0)
+            {
+                return;
+            }
+
+            if(memoryTraceBuffer == null || memoryTraceBuffer.Length < count * RecordWords)
+            {
+                memoryTraceBuffer = new long[memoryTraceCapacity * RecordWords];
+            }
+            var first = (int)(tail & (memoryTraceCapacity - 1));
+            var firstPart = Math.Min(count, (int)memoryTraceCapacity - first);
+            Marshal.Copy(memoryTraceRing + RingRecordsOffset + first * MemoryAccessTraceRecordSize, memoryTraceBuffer, 0, firstPart * RecordWords);
+            if(firstPart < count)
+            {
+                Marshal.Copy(memoryTraceRing + RingRecordsOffset, memoryTraceBuffer, firstPart * RecordWords, (count - firstPart) * RecordWords);
+            }
+            // the slots can be reused only after they were copied
+            Thread.MemoryBarrier();
+            Marshal.WriteInt64(memoryTraceRing, RingTailOffset, (long)head);
+
+            if(memoryTraceWriter != null)
+            {
+                var bytes = count * MemoryAccessTraceRecordSize;
+                if(memoryTraceBytes == null || memoryTraceBytes.Length < bytes)
+                {
+                    memoryTraceBytes = new byte[memoryTraceCapacity * MemoryAccessTraceRecordSize];
+                }
+                Buffer.BlockCopy(memoryTraceBuffer, 0, memoryTraceBytes, 0, bytes);
+                memoryTraceWriter.Write(memoryTraceBytes, 0, bytes);
+            }
+
+            if(memoryTraceConsumer != null)
+            {
+                var entries = new MemoryAccessTraceEntry[count];
+                for(var i = 0; i < count; i++)
+                {
+                    var word = i * RecordWords;
+                    var typeAndWidth = (ulong)memoryTraceBuffer[word + 4];
+                    entries[i] = new MemoryAccessTraceEntry
+                    {
+                        PC = (ulong)memoryTraceBuffer[word],
+                        VirtualAddress = (ulong)memoryTraceBuffer[word + 1],
+                        PhysicalAddress = (ulong)memoryTraceBuffer[word + 2],
+                        Value = (ulong)memoryTraceBuffer[word + 3],
+                        Operation = (MemoryOperation)(uint)typeAndWidth,
+                        Width = (uint)(typeAndWidth >> 32),
+                    };
+                }
+                memoryTraceConsumer(entries);
+            }
+        }
+
+        [Transient]
+        private IntPtr memoryTraceRing;
+        [Transient]
+        private uint memoryTraceCapacity;
+        [Transient]
+        private Action<MemoryAccessTraceEntry[]> memoryTraceConsumer;
+        [Transient]
+        private BinaryWriter memoryTraceWriter;
+        [Transient]
+        private long[] memoryTraceBuffer;
+        [Transient]
+        private byte[] memoryTraceBytes;
+
+        private const uint DefaultMemoryAccessTraceCapacityBits = 16;
+        private const string MemoryAccessTraceMagic = "TLIBMTRC";
+        private const uint MemoryAccessTraceVersion = 1;
+
+        // these must match `memory_trace_ring_t` and `memory_trace_record_t` in tlib's memory_trace.h
+        private const int RingHeadOffset = 0;
+        private const int RingTailOffset = 8;
+        private const int RingDroppedOffset = 16;
+        private const int RingCapacityOffset = 24;
+        private const int RingRecordsOffset = 32;
+        private const int MemoryAccessTraceRecordSize = 40;
+        private const int RecordWords = MemoryAccessTraceRecordSize / sizeof(long);
+
+        #pragma warning disable 649
+
+        [Import]
+        private FuncIntPtrUInt32 TlibEnableMemoryTrace;
+
+        [Import]
+        private Action TlibDisableMemoryTrace;
+
+        #pragma warning restore 649
+    }
+
+    public struct MemoryAccessTraceEntry
+    {
+        public ulong PC;
+        public ulong VirtualAddress;
+        // ulong.MaxValue if unknown, which happens for accesses crossing a page boundary
+        public ulong PhysicalAddress;
+        public ulong Value;
+        public MemoryOperation Operation;
+        // in bytes
+        public uint Width;
+
+        public override string ToString()
+        {
+            return $"[0x{PC:X}] {Operation} of {Width} bytes at 0x{VirtualAddress:X} (physical 0x{PhysicalAddress:X}): 0x{Value:X}";
+        }
+    }
+}
@@ -8,6 +8,7 @@
 using System.Collections.Generic;
 using System.Text;
 using System.IO;
+using System.Runtime.InteropServices;
 using Antmicro.Renode.Exceptions;
 using Antmicro.Renode.Logging;
 using Antmicro.Renode.Utilities;
@@ -67,20 +68,22 @@ public ulong GetOpcodeCounter(string name)
 
         public string[,] GetAllOpcodesCounters()
         {
+            var counters = GetOpcodeCountersSnapshot();
             return new Table()
                 .AddRow("Opcode", "Count")
                 .AddRows(opcodesMap,
                            x => x.Key,
-                           x => TlibGetOpcodeCounter(x.Value).ToString()).ToArray();
+                           x => counters[x.Value - 1].ToString()).ToArray();
         }
         
         public void SaveAllOpcodesCounters(string path)
         {
+            var counters = GetOpcodeCountersSnapshot();
             using(var outputFile = new StreamWriter(path))
             {
                 foreach(var x in opcodesMap)
                 {
-                    outputFile.WriteLine(string.Format("{0};{1}", x.Key, TlibGetOpcodeCounter(x.Value)));
+                    outputFile.WriteLine(string.Format("{0};{1}", x.Key, counters[x.Value - 1]));
                 }
             }
         }
@@ -90,6 +93,22 @@ public void ResetOpcodesCounters()
             TlibResetOpcodeCounters();
         }
 
+        private ulong[] GetOpcodeCountersSnapshot()
+        {
+            // counter ids are assigned sequentially starting from 1
+            var counters = new ulong[opcodesMap.Count];
+            var handle = GCHandle.Alloc(counters, GCHandleType.Pinned);
+            try
+            {
+                TlibGetOpcodeCounters(handle.AddrOfPinnedObject(), (uint)counters.Length);
+            }
+            finally
+            {
+                handle.Free();
+            }
+            return counters;
+        }
+
         private readonly Dictionary<string, uint> opcodesMap = new Dictionary<string, uint>();
         
         #pragma warning disable 649
@@ -100,6 +119,9 @@ public void ResetOpcodesCounters()
         [Import]
         private FuncUInt64UInt32 TlibGetOpcodeCounter;
         
+        [Import]
+        private FuncUInt32IntPtrUInt32 TlibGetOpcodeCounters;
+        
         [Import]
         private FuncUInt32UInt64UInt64 TlibInstallOpcodeCounter;
         
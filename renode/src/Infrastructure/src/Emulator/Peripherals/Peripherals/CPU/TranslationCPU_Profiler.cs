@@ -88,6 +88,50 @@ public void FlushProfiler()
             profiler.FlushBuffer();
         }
 
+        // Samples the guest call stack every `samplePeriod` instructions and writes the stacks in the collapsed stack format.
+        // Unlike the profilers above it doesn't instrument the translated code, but it only finds the callers
+        // in code built with frame pointers.
+        public void EnableSamplingProfiler(string filename, ulong samplePeriod = DefaultSamplePeriod)
+        {
+            using(machine?.ObtainPausedState())
+            {
+                if(samplingProfiler != null)
+                {
+                    StopSamplingProfiler();
+                }
+
+                samplingProfiler = new SamplingProfiler(this, filename);
+                if(TlibEnableSamplingProfiler(samplePeriod, SampleBatchCapacity) == 0)
+                {
+                    samplingProfiler = null;
+                    throw new RecoverableException("The sample period has to be greater than zero");
+                }
+            }
+        }
+
+        public void DisableSamplingProfiler()
+        {
+            if(samplingProfiler == null)
+            {
+                throw new RecoverableException("The sampling profiler is not enabled on this core");
+            }
+
+            using(machine?.ObtainPausedState())
+            {
+                StopSamplingProfiler();
+            }
+        }
+
+        public void FlushSamplingProfiler()
+        {
+            if(samplingProfiler == null)
+            {
+                throw new RecoverableException("The sampling profiler is not enabled on this core");
+            }
+
+            samplingProfiler.FlushBuffer();
+        }
+
         public enum ProfilerType
         {
             CollapsedStack,
@@ -107,6 +151,12 @@ protected void OnStackChange(ulong currentAddress, ulong returnAddress, ulong in
             }
         }
 
+        [Export]
+        protected void OnProfilerSamples(IntPtr samples, uint count)
+        {
+            samplingProfiler?.AddSamples(samples, count);
+        }
+
         [Export]
         protected void OnContextChange(ulong threadId)
         {
@@ -127,11 +177,33 @@ private void ConfigureProfilerInterruptHooks(bool enabled)
             }
         }
 
+        // the samples still pending in tlib are delivered before it returns
+        private void StopSamplingProfiler()
+        {
+            if(samplingProfiler == null)
+            {
+                return;
+            }
+            TlibDisableSamplingProfiler();
+            samplingProfiler.Dispose();
+            samplingProfiler = null;
+        }
+
         private BaseProfiler profiler;
+        private SamplingProfiler samplingProfiler;
+
+        private const ulong DefaultSamplePeriod = 100000;
+        private const uint SampleBatchCapacity = 1024;
 
 #pragma warning disable 649
         [Import]
         private ActionInt32 TlibEnableGuestProfiler;
+
+        [Import]
+        private FuncUInt32UInt64UInt32 TlibEnableSamplingProfiler;
+
+        [Import]
+        private Action TlibDisableSamplingProfiler;
 #pragma warning restore 649
     }
 }
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2010-2024 Antmicro
+//
+// This file is licensed under the MIT License.
+// Full license text is available in 'licenses/MIT.txt'.
+//
+using System;
+using System.IO;
+using System.Runtime.InteropServices;
+using Antmicro.Renode.Exceptions;
+using Antmicro.Renode.Utilities.Binding;
+
+namespace Antmicro.Renode.Peripherals.CPU
+{
+    public abstract partial class TranslationCPU
+    {
+        // Makes tlib collect statistics of up to `capacity` translated blocks (execution count, translation time, code sizes,
+        // chaining and the reason of invalidation) together with the translation cache counters.
+        // The translation cache is flushed, so the statistics start anew.
+        public void EnableTranslationStatistics(uint capacity = DefaultTranslationStatisticsCapacity)
+        {
+            using(machine?.ObtainPausedState())
+            {
+                if(TlibEnableTbStats(capacity) == 0)
+                {
+                    throw new RecoverableException($"Unsupported translation statistics capacity: {capacity} blocks");
+                }
+            }
+        }
+
+        public void DisableTranslationStatistics()
+        {
+            using(machine?.ObtainPausedState())
+            {
+                TlibDisableTbStats();
+            }
+        }
+
+        // Returns the binary snapshot laid out as `tb_stats_t` in tlib's tb_stats.h
+        public byte[] GetTranslationStatistics()
+        {
+            using(machine?.ObtainPausedState())
+            {
+                var size = TlibGetTbStats(IntPtr.Zero, 0);
+                if(size == 0)
+                {
+                    throw new RecoverableException("Translation statistics are not enabled");
+                }
+                var buffer = Marshal.AllocHGlobal((int)size);
+                try
+                {
+                    TlibGetTbStats(buffer, size);
+                    var snapshot = new byte[size];
+                    Marshal.Copy(buffer, snapshot, 0, snapshot.Length);
+                    return snapshot;
+                }
+                finally
+                {
+                    Marshal.FreeHGlobal(buffer);
+                }
+            }
+        }
+
+        public void SaveTranslationStatistics(string path)
+        {
+            var snapshot = GetTranslationStatistics();
+            try
+            {
+                File.WriteAllBytes(path, snapshot);
+            }
+            catch(Exception e)
+            {
+                throw new RecoverableException($"There was an error when writing the translation statistics to {path}: {e.Message}");
+            }
+        }
+
+        private const uint DefaultTranslationStatisticsCapacity = 65536;
+
+        #pragma warning disable 649
+
+        [Import]
+        private FuncUInt32UInt32 TlibEnableTbStats;
+
+        [Import]
+        private Action TlibDisableTbStats;
+
+        [Import]
+        private FuncUInt64IntPtrUInt64 TlibGetTbStats;
+
+        #pragma warning restore 649
+    }
+}
@@ -0,0 +1,29 @@
+import re
+import socket
+
+connection = None
+
+def connect_to_gdb_server(port):
+    global connection
+    connection = socket.create_connection(('localhost', int(port)), timeout=10)
+
+def disconnect_from_gdb_server():
+    global connection
+    connection.close()
+    connection = None
+
+def send_gdb_packet(payload):
+    # the stub acknowledges every packet with '+' before replying to it; the reply to 'c' comes only after the core stops
+    checksum = sum(payload.encode()) % 256
+    connection.sendall('${}#{:02x}'.format(payload, checksum).encode())
+    data = b''
+    while True:
+        reply = re.search(rb'\$([^#]*)#[0-9a-fA-F]{2}', data)
+        if reply:
+            break
+        chunk = connection.recv(4096)
+        if not chunk:
+            raise Exception('GDB server closed the connection')
+        data += chunk
+    connection.sendall(b'+')
+    return reply.group(1).decode()